@@ -0,0 +1,60 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "zzub/consts.h"
+
+namespace zzub {
+
+// the largest block the mixer can be set to process in one go, see player::set_block_size().
+// plugins get at most buffer_size samples per call unless they set plugin_flag_large_blocks.
+const int max_block_size = 4096;
+
+// stereo audio buffers of a block and some margin per channel, 64 byte aligned. slots are
+// only added, by reserve() on the user thread, and stay at the same address until the block
+// size changes, which the player only does while it holds swap_lock. so the audio thread
+// can hold on to the pointers it was given.
+struct buffer_arena {
+    enum {
+        alignment = 64,
+    };
+
+    std::vector<float*> blocks;					// aligned allocations, freed by the destructor
+    std::vector<float*> slots;					// left channel of each slot, the right channel follows
+    int channel_size;
+
+    buffer_arena();
+    ~buffer_arena();
+
+    // makes sure there are count slots. new slots are silent.
+    void reserve(int count);
+    // reallocates all slots for blocks of block_size samples, the contents are lost
+    void set_block_size(int block_size);
+
+    int get_slot_count() const { return (int)slots.size(); }
+    float* get_channel(int slot, int channel) const { return slots[slot] + channel * channel_size; }
+    size_t get_size() const { return slots.size() * get_slot_size(); }
+    size_t get_slot_size() const { return 2 * channel_size * sizeof(float); }
+
+private:
+    buffer_arena(const buffer_arena&);
+    buffer_arena& operator=(const buffer_arena&);
+};
+
+}
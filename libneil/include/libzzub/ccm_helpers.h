@@ -3,7 +3,9 @@
 #include "mz_compat.h"
 #include "mz.h"
 
+#include <functional>
 #include <string>
+#include <vector>
 #include "zzub/consts.h"
 #include "libzzub/wave_info.h"
 #include "libzzub/streams.h"
@@ -28,9 +30,34 @@ std::string paramtype_to_string(int paramtype);
 std::string connectiontype_to_string(int connectiontype);
 
 
+// a wave level decoded from flac, staged until it is copied into the song
+struct decoded_wave {
+    std::vector<char> samples;
+    int sample_count;
+    int channels;
+    int bits_per_sample;
+
+    decoded_wave() : sample_count(0), channels(0), bits_per_sample(0) {}
+};
+
 bool encodeFLAC(zzub::outstream* writer, zzub::wave_info_ex& info, int level);
 void decodeFLAC(zzub::instream* reader, zzub::player& player, int wave, int level);
 
+// decodeFLAC in two steps: decoding touches no song state and can run on any thread,
+// storing allocates the level in the backbuffer and must run on the user thread.
+void decodeFLAC(zzub::instream* reader, decoded_wave& result);
+void storeDecodedWave(const decoded_wave& data, zzub::player& player, int wave, int level);
+
+// runs job(0) to job(count - 1) on a pool of one thread per core and returns when all are
+// done. progress is invoked on the calling thread with the number of finished jobs.
+void run_parallel(int count, const std::function<void(int)>& job, const std::function<void(int, int)>& progress);
+
+bool encodePeaks(zzub::outstream* writer, const zzub::wave_peaks& peaks);
+bool decodePeaks(zzub::instream* reader, zzub::wave_info_ex& info, zzub::wave_level_ex& level);
+
+bool encodePattern(zzub::outstream* writer, zzub::song& song, int plugin, const zzub::pattern& p, int tpb);
+bool decodePattern(zzub::instream* reader, zzub::pattern& p, int tpb);
+
 
 
 class ArchiveWriter : public zzub::outstream {
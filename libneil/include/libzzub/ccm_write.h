@@ -1,6 +1,10 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <vector>
+
 #include "pugixml.hpp"
 #include "libzzub/archive.h"
 #include "libzzub/ccm_helpers.h"
@@ -13,7 +17,19 @@ using namespace pugi;
 
 class CcmWriter {
     ArchiveWriter arch;
-    
+
+    // a file of the archive, kept in memory until the song has been walked. wave levels hold
+    // a copy of their wave_info_ex and are flac encoded by write().
+    struct archive_entry {
+        std::string name;
+        std::vector<char> data;
+        std::shared_ptr<zzub::wave_info_ex> wave;
+        int level;
+    };
+    std::vector<archive_entry> entries;
+    pugi::xml_document xml;
+
+    void addEntry(const std::string& name, const void* data, int size);
     xml_node saveParameter(xml_node &parent, const zzub::parameter &p);
     xml_node saveClasses(xml_node &parent, zzub::song &player);
     xml_node saveClass(xml_node &parent, const zzub::info &pl);
@@ -43,7 +59,19 @@ class CcmWriter {
     xml_node saveEnvelope(xml_node &parent, zzub::envelope_entry& env);
     xml_node saveEnvelopes(xml_node &parent, zzub::wave_info_ex &info);
 public:
+    bool binary_patterns;	// store pattern values in binary archive entries instead of <e> elements
+
+    CcmWriter() : binary_patterns(true) {}
+
     bool save(std::string fileName, zzub::player* player);
+
+    // save() in two steps. snapshot() walks the front song on the user thread and keeps
+    // everything the archive needs except sample data. write() only reads the snapshot and
+    // the samples of its wave levels, so it can run on any thread as long as those are kept
+    // alive, see undo_manager::retain_samples(). a writer is used for one save.
+    bool snapshot(zzub::player* player);
+    bool write(std::string fileName, const std::function<void(int, int)>& progress);
+
     bool saveSelected(std::string filename, zzub::player* player, const int* plugins, unsigned int size);
 };
 
@@ -46,14 +46,19 @@
 #include "synchronization.h"
 #include "zzub/plugin.h"
 #include "pluginloader.h"
+#include "plugin_cache.h"
 #include "timer.h"
+#include "rtcheck.h"
+#include "buffer_arena.h"
 #include "driver.h"
 #include "midi_driver.h"
 #include "wavetable.h"
+#include "wave_peaks.h"
 #include "input.h"
 #include "output.h"
 #include "master.h"
 #include "recorder.h"
+#include "rtcheck_allocator.h"
 #include "graph.h"
 #include "song.h"
 #include "undo.h"
@@ -38,6 +38,9 @@ struct connection
     virtual void process_events(zzub::song& player, const connection_descriptor& conn) = 0;
     virtual bool work(zzub::song& player, const connection_descriptor& conn, uint sample_count, uint work_position) = 0;
 
+    // false when work() would not pass anything to the target plugin, used to put silent
+    // effects to sleep
+    virtual bool has_signals(zzub::song& player, const connection_descriptor& conn) { return true; }
 
     connection_type get_type() const { return type; }
 
@@ -86,6 +89,9 @@ struct audio_connection : connection
     audio_connection();
     virtual void process_events(zzub::song& player, const zzub::connection_descriptor& conn);
     virtual bool work(zzub::song& player, const connection_descriptor& conn, uint sample_count, uint work_position);
+    virtual bool has_signals(zzub::song& player, const connection_descriptor& conn);
+    // work() on sample_count samples from offset into the chunk
+    bool work_range(zzub::song& player, const connection_descriptor& conn, uint offset, uint sample_count, uint work_position);
 };
 
 
@@ -118,6 +124,7 @@ struct event_connection : connection
 
     virtual void process_events(zzub::song& player, const zzub::connection_descriptor& conn);
     virtual bool work(zzub::song& player, const connection_descriptor& conn, uint sample_count, uint work_position);
+    virtual bool has_signals(zzub::song& player, const connection_descriptor& conn) { return false; }
 
     int get_binding_count() const { return bindings.size(); }
 
@@ -257,6 +264,7 @@ struct midi_connection : connection
     int get_midi_device(zzub::song& player, int plugin, std::string name);
     virtual void process_events(zzub::song& player, const zzub::connection_descriptor& conn);
     virtual bool work(zzub::song& player, const connection_descriptor& conn, uint sample_count, uint work_position);
+    virtual bool has_signals(zzub::song& player, const connection_descriptor& conn);
 };
 
 
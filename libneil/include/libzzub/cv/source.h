@@ -71,7 +71,7 @@ struct cv_source_mono_audio : public cv_source {
     );
 
 private:
-    float* src;
+    zzub::host* src;
 };
 
 
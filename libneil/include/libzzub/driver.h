@@ -116,6 +116,7 @@ struct audioworker {
     virtual void audio_enabled() {}
     virtual void audio_disabled() {}
     virtual void samplerate_changed() {}
+    virtual void buffersize_changed() {}
 
 };
 }
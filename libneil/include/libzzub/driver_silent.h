@@ -52,6 +52,7 @@ struct audiodriver_silent : audiodriver {
         worker->work_master_channel = master_channel;
         worker->work_latency = 0;
         worker->samplerate_changed();
+        worker->buffersize_changed();
         for (int i = 0; i < audiodriver::MAX_CHANNELS; i++) {
             worker->work_out_buffer[i] = new float[audiodriver::MAX_FRAMESIZE];
             worker->work_in_buffer[i] = new float[audiodriver::MAX_FRAMESIZE];
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+#include "zzub/plugin.h"
+
+namespace zzub {
+
+struct event_message {
+    int plugin_id;
+    event_handler* event;
+    zzub_event_data data;
+};
+
+
+// queue of events from the player to handlers on the user thread, drained by
+// player::process_user_event_queue(). the flat api queues the events for
+// zzub_player_get_next_event() here as well.
+//
+// bounded lock-free ring with a single consumer. any number of threads may push: a slot is
+// claimed with a compare-and-swap on the write index and handed to the consumer with a release
+// store of its sequence number. push() never blocks, when the ring is full the item is dropped
+// and counted.
+//
+// parameter changes are coalesced, so a column that is automated every tick only occupies one
+// slot until the user thread gets to it, and pending events can be detached from a deleted
+// plugin or handler. coalescing keeps a table on the producer side and must only be used from
+// the thread that ticks plugins; plain push() is safe from any thread, e.g parallel workers.
+struct event_queue {
+    enum {
+        default_capacity = 4096,
+        coalesce_table_size = 1024,
+    };
+
+    event_queue(size_t capacity = default_capacity);
+    event_queue(const event_queue&) = delete;
+    event_queue& operator=(const event_queue&) = delete;
+
+    bool push(const event_message& message);
+    bool push_parameter_change(const event_message& message);
+    bool pop(event_message& message);
+    int pop_batch(event_message* messages, int max_count);
+
+    void clear_plugin(int plugin_id);
+    void clear_handler(event_handler* handler);
+
+    size_t get_capacity() const { return capacity; }
+    size_t get_dropped_count() const { return dropped.load(std::memory_order_relaxed); }
+    size_t get_coalesced_count() const { return coalesced.load(std::memory_order_relaxed); }
+
+private:
+    // sequence is pos while the slot is free, pos + 1 when it holds the event at pos and
+    // pos + 2 while the consumer is reading a coalesced value out of it
+    struct slot {
+        std::atomic<size_t> sequence;
+        std::atomic<event_handler*> handler;
+        std::atomic<int> value;			// latest value of a parameter change
+        event_message message;
+    };
+
+    struct coalesce_entry {
+        int plugin_id;
+        event_handler* handler;
+        int group, track, column;
+        size_t ticket;					// position of the queued event
+        bool used;
+    };
+
+    std::unique_ptr<slot[]> slots;
+    size_t capacity;
+    size_t mask;
+    std::atomic<size_t> write_index;
+    std::atomic<size_t> read_index;
+    std::atomic<size_t> dropped;
+    std::atomic<size_t> coalesced;
+    std::vector<coalesce_entry> coalesce_table;
+
+    void init(size_t requested);
+    bool claim(size_t& pos);
+    template <typename F> void clear_if(F match);
+};
+
+}
@@ -19,6 +19,7 @@ inline bool is_plugin_event(zzub::event_type type)  {
         case zzub::event_type_new_plugin:
         case zzub::event_type_delete_plugin:
         case zzub::event_type_edit_pattern:
+        case zzub::event_type_edit_pattern_block:
         case zzub::event_type_connect:
         case zzub::event_type_disconnect:
         case zzub::event_type_plugin_changed:
@@ -3,6 +3,7 @@
 #include <vector>
 #include "zzub/consts.h"
 #include "zzub/zzub_typedefs.h"
+#include "libzzub/buffer_arena.h"
 
 
 namespace zzub {
@@ -115,7 +116,26 @@ struct host {
     host(zzub::player *, zzub_plugin_t *);
     virtual ~host();
     std::vector<std::vector<float> > aux_buffer;
+
+    // output history read by feedback and cv connections, feedback_delay samples behind the
+    // newest sample. the delay is the block size of the mixer, a reader gets a whole block
+    // before the plugin has worked. new output is appended at feedback_position, the history
+    // is moved back to the front of the buffer when the end is reached. only allocated for
+    // plugins that keep a history, and kept from then on since the audio thread may still
+    // read it.
     std::vector<std::vector<float> > feedback_buffer;
+    int feedback_position;
+    int feedback_delay;
+    static float no_feedback[zzub::max_block_size];
+
+    // allocates the history for the block size of the mixer, unless it has one that fits.
+    // user thread, under swap_lock when the plugin is in the running song.
+    void enable_feedback_history();
+    void write_feedback(float** samples, int numsamples);	// samples = 0 writes silence
+    float* get_feedback(int channel) {
+        if (feedback_buffer.empty()) return no_feedback;	// never kept a history
+        return &feedback_buffer[channel][feedback_position - feedback_delay];
+    }
 };
 
 }
\ No newline at end of file
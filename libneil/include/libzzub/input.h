@@ -27,7 +27,8 @@ namespace zzub {
 struct input_plugin_info : zzub::info {
 
     input_plugin_info() {
-        this->flags = zzub::plugin_flag_has_audio_output;
+        // reads the driver buffer from the start of the chunk, so it takes whole chunks
+        this->flags = zzub::plugin_flag_has_audio_output | zzub::plugin_flag_large_blocks;
         this->name = "Audio Input";
         this->short_name = "Input";
         this->author = "n/a";
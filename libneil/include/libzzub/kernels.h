@@ -0,0 +1,32 @@
+#pragma once
+
+namespace zzub {
+
+enum kernel_set {
+    kernel_set_scalar,
+    kernel_set_sse2,
+    kernel_set_avx2,
+    kernel_set_count
+};
+
+// the mixing primitives behind the buffer tools in tools.h. every kernel set computes the
+// same operations in the same order, so the results are bit identical and the scalar set
+// can be used as a reference. stereo_* buffers are interleaved.
+struct mixing_kernels {
+    const char* name;
+    void (*add_pan)(float* out_l, float* out_r, const float* in_l, const float* in_r, int sample_count, float amp_l, float amp_r);
+    void (*add)(float* out, const float* in, int sample_count, float amp);
+    void (*amp)(float* buffer, int sample_count, float amp);
+    void (*copy_mono_to_stereo)(float* out, const float* in, int sample_count, float amp);
+    void (*copy_stereo_to_mono)(float* out, const float* in, int sample_count, float amp);
+    float (*peak)(const float* buffer, int sample_count);
+    bool (*has_signals)(const float* buffer, int sample_count);
+};
+
+// returns 0 if the set is not compiled in or not supported by the cpu
+const mixing_kernels* get_mixing_kernels(kernel_set set);
+
+// the best set for this cpu, selected on first use. ZZUB_KERNELS=scalar|sse2|avx2 overrides it
+const mixing_kernels& kernels();
+
+}
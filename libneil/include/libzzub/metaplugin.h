@@ -20,6 +20,49 @@ enum sequencer_event_type {
     sequencer_event_type_pattern = 0x10,
 };
 
+// copies one state column into the live parameter values of a plugin
+struct parameter_transfer {
+    int source;			// column index in the state row
+    int dest;			// byte offset in the target value block
+    int size;			// 1 or 2 bytes
+    int value_none;
+    int group, track, column;
+};
+
+// precompiled layout of the connection, global and track columns of a plugin, which are the
+// leading columns of its state patterns. rebuilt by song::make_parameter_transfer_plan() when
+// tracks, connections or the plugin change, so ticks don't look up parameter infos.
+struct parameter_transfer_plan {
+    std::vector<parameter_transfer> transfers;	// one per column, in row order
+    std::vector<int> connection_end;			// end of the transfers of each input connection
+    int global_end;								// end of the global transfers, track transfers follow
+    std::vector<int> none_row;					// value_none per column
+    int column_count;							// column count of state_write when the plan was built
+    int track_count;							// track count of state_write when the plan was built
+
+    parameter_transfer_plan() {
+        global_end = 0;
+        column_count = -1;
+        track_count = -1;
+    }
+
+    // true if p has the connection, global and track layout the plan was built for. patterns
+    // that were laid out before a track or connection change take the per-parameter path.
+    bool matches(const pattern& p) const {
+        if (p.column_count != column_count || p.get_group_count() < 3)
+            return false;
+        if (p.get_track_count(0) != (int)connection_end.size() || p.get_track_count(2) != track_count)
+            return false;
+        int begin = 0;
+        for (int i = 0; i < (int)connection_end.size(); i++) {
+            if (p.get_column_count(0, i) != connection_end[i] - begin)
+                return false;
+            begin = connection_end[i];
+        }
+        return true;
+    }
+};
+
 struct metaplugin {
     zzub::plugin* plugin;
     plugin_descriptor descriptor;
@@ -27,7 +70,7 @@ struct metaplugin {
     int flags;
     host* callbacks;
     bool initialized;
-    std::vector<std::vector<float>> work_buffer;
+    float* work_buffer[2];						// slot in mixer::work_buffers, set when the work order is swapped in
     std::string name;
     int tracks;
     sequencer_event_type sequencer_state;
@@ -36,10 +79,12 @@ struct metaplugin {
     pattern state_write;
     pattern state_last;
     pattern state_automation;
+    parameter_transfer_plan transfer_plan;
 
     std::string stream_source;
 
     int work_order_index;
+    bool keeps_feedback_history;				// output is read by feedback or cv connections
     int last_work_buffersize, last_work_frame;
     float last_work_max_left, last_work_max_right;
     bool last_work_audio_result;
@@ -48,7 +93,10 @@ struct metaplugin {
     double cpu_load_time;
     int cpu_load_buffersize;
     double cpu_load;
+    double total_work_time;						// never reset, read by zzub-bench
     int writemode_errors;
+    int silent_samples;							// samples since the input (and output for tail_length_auto) went silent
+    bool is_sleeping;							// skipped in the last chunk
 
     int midi_input_channel;
     std::vector<midi_message> midi_messages;
@@ -273,6 +273,22 @@ struct op_pattern_edit : operation {
     virtual void finish(zzub::song& song, bool send_events);
 };
 
+// sets many cells of a pattern at once, with one event for the whole block
+struct op_pattern_edit_block : operation {
+    struct cell {
+        int group, track, column, row, value;
+    };
+
+    int id;
+    int index;
+    std::vector<cell> cells;
+
+    op_pattern_edit_block(int _id, int _index, const std::vector<cell>& _cells);
+    virtual bool prepare(zzub::song& song);
+    virtual bool operate(zzub::song& song);
+    virtual void finish(zzub::song& song, bool send_events);
+};
+
 struct op_pattern_insert : operation {
     int id;
     int index;
@@ -23,7 +23,8 @@ namespace zzub {
 
 struct output_plugin_info : zzub::info {
     output_plugin_info() {
-        this->flags = zzub::plugin_flag_has_audio_input;
+        // writes to the driver buffer at the start of the chunk, so it takes whole chunks
+        this->flags = zzub::plugin_flag_has_audio_input | zzub::plugin_flag_large_blocks;
         this->name = "Audio Output";
         this->short_name = "Output";
         this->author = "n/a";
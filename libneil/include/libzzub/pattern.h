@@ -2,21 +2,193 @@
 
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 
 namespace zzub {
 
+// pattern values are stored in one contiguous, row-major array. a row holds the columns of
+// all tracks in all groups, the first column of each track is found via track_offsets.
+// ticking reads a whole track row as a single slice, and duplicating a pattern for the
+// backbuffer is one allocation.
 struct pattern {
-    typedef std::vector<int> column;
-    typedef std::vector<column> track;
-    typedef std::vector<track> group;
+    std::vector<std::vector<int> > track_offsets;	// [group][track] -> first column of the track in a row
+    std::vector<std::vector<int> > track_columns;	// [group][track] -> number of columns in the track
+    int column_count;								// total number of columns in a row
+    std::vector<int> values;						// rows * column_count values
 
-    std::vector<group> groups;
     std::string name;
     int rows;
 
     pattern() {
+        column_count = 0;
         rows = 0;
     }
+
+    // layout
+
+    int get_group_count() const {
+        return (int)track_offsets.size();
+    }
+
+    int get_track_count(int group) const {
+        assert(group >= 0 && group < (int)track_offsets.size());
+        return (int)track_offsets[group].size();
+    }
+
+    int get_column_count(int group, int track) const {
+        assert(track >= 0 && track < get_track_count(group));
+        return track_columns[group][track];
+    }
+
+    int get_column_index(int group, int track, int column) const {
+        assert(column >= 0 && column < get_column_count(group, track));
+        return track_offsets[group][track] + column;
+    }
+
+    // values
+
+    int& value(int group, int track, int column, int row) {
+        assert(row >= 0 && row < rows);
+        return values[row * column_count + get_column_index(group, track, column)];
+    }
+
+    int value(int group, int track, int column, int row) const {
+        assert(row >= 0 && row < rows);
+        return values[row * column_count + get_column_index(group, track, column)];
+    }
+
+    int* get_row(int row) {
+        return values.data() + row * column_count;
+    }
+
+    const int* get_row(int row) const {
+        return values.data() + row * column_count;
+    }
+
+    // returns the columns of one track in one row
+    int* get_track_row(int group, int track, int row) {
+        return values.data() + row * column_count + track_offsets[group][track];
+    }
+
+    const int* get_track_row(int group, int track, int row) const {
+        return values.data() + row * column_count + track_offsets[group][track];
+    }
+
+    // structure. these rebuild the value array and are only used from the user thread
+
+    void set_group_count(int groups) {
+        while ((int)track_offsets.size() > groups) {
+            while (get_track_count(get_group_count() - 1) > 0)
+                remove_track(get_group_count() - 1, get_track_count(get_group_count() - 1) - 1);
+            track_offsets.pop_back();
+            track_columns.pop_back();
+        }
+        track_offsets.resize(groups);
+        track_columns.resize(groups);
+    }
+
+    // inserts a track before 'track'. fill holds one value per column that is written to all rows
+    void insert_track(int group, int track, int columns, const int* fill) {
+        assert(track >= 0 && track <= get_track_count(group));
+
+        int insert_column = (track < get_track_count(group))
+            ? track_offsets[group][track]
+            : end_column(group);
+
+        track_offsets[group].insert(track_offsets[group].begin() + track, insert_column);
+        track_columns[group].insert(track_columns[group].begin() + track, columns);
+        shift_offsets(group, track, columns);
+
+        std::vector<int> new_values(rows * (column_count + columns));
+        for (int i = 0; i < rows; i++) {
+            const int* src = &values[i * column_count];
+            int* dest = &new_values[i * (column_count + columns)];
+            std::copy(src, src + insert_column, dest);
+            if (fill) std::copy(fill, fill + columns, dest + insert_column);
+            std::copy(src + insert_column, src + column_count, dest + insert_column + columns);
+        }
+        values.swap(new_values);
+        column_count += columns;
+    }
+
+    void add_track(int group, int columns, const int* fill) {
+        insert_track(group, get_track_count(group), columns, fill);
+    }
+
+    void remove_track(int group, int track) {
+        assert(track >= 0 && track < get_track_count(group));
+
+        int remove_column = track_offsets[group][track];
+        int columns = track_columns[group][track];
+
+        track_offsets[group].erase(track_offsets[group].begin() + track);
+        track_columns[group].erase(track_columns[group].begin() + track);
+        shift_offsets(group, track - 1, -columns);
+
+        std::vector<int> new_values(rows * (column_count - columns));
+        for (int i = 0; i < rows; i++) {
+            const int* src = &values[i * column_count];
+            int* dest = &new_values[i * (column_count - columns)];
+            std::copy(src, src + remove_column, dest);
+            std::copy(src + remove_column + columns, src + column_count, dest + remove_column);
+        }
+        values.swap(new_values);
+        column_count -= columns;
+    }
+
+    // changes the number of rows. fill holds one value per column (column_count values)
+    // that is written to new rows, or zero to clear them
+    void set_rows(int new_rows, const int* fill) {
+        values.resize(new_rows * column_count);
+        for (int i = rows; i < new_rows; i++) {
+            if (fill)
+                std::copy(fill, fill + column_count, &values[i * column_count]);
+            else
+                std::fill(values.begin() + i * column_count, values.begin() + (i + 1) * column_count, 0);
+        }
+        rows = new_rows;
+    }
+
+    // shifts the rows of a single column down by count rows starting at row, rows pushed past
+    // the end of the pattern are lost
+    void insert_column_rows(int group, int track, int column, int row, int count, int fill) {
+        int index = get_column_index(group, track, column);
+        for (int i = rows - 1; i >= row + count; i--)
+            values[i * column_count + index] = values[(i - count) * column_count + index];
+        for (int i = row; i < row + count && i < rows; i++)
+            values[i * column_count + index] = fill;
+    }
+
+    // shifts the rows of a single column up by count rows starting at row
+    void remove_column_rows(int group, int track, int column, int row, int count, int fill) {
+        int index = get_column_index(group, track, column);
+        for (int i = row; i < rows - count; i++)
+            values[i * column_count + index] = values[(i + count) * column_count + index];
+        for (int i = std::max(row, rows - count); i < rows; i++)
+            values[i * column_count + index] = fill;
+    }
+
+private:
+    // first column after the last track in the group
+    int end_column(int group) const {
+        for (int g = group; g >= 0; g--) {
+            int tracks = (int)track_offsets[g].size();
+            if (tracks > 0)
+                return track_offsets[g][tracks - 1] + track_columns[g][tracks - 1];
+        }
+        return 0;
+    }
+
+    // moves the tracks after (group, track) by delta columns
+    void shift_offsets(int group, int track, int delta) {
+        for (int t = track + 1; t < (int)track_offsets[group].size(); t++)
+            track_offsets[group][t] += delta;
+        for (int g = group + 1; g < (int)track_offsets.size(); g++)
+            for (size_t t = 0; t < track_offsets[g].size(); t++)
+                track_offsets[g][t] += delta;
+    }
 };
 
-}
\ No newline at end of file
+}
@@ -19,12 +19,16 @@
 #pragma once
 
 
+#include <atomic>
+#include <functional>
 #include <utility>
 #include <string>
 #include <vector>
 #include <stack>
+#include <thread>
 
 #include "undo.h"
+#include "plugin_cache.h"
 #include "midi_driver.h"
 #include "input.h"
 #include "output.h"
@@ -45,7 +49,7 @@ struct zzub_master_event_filter;
 
 namespace zzub {
 
-
+class CcmWriter;
 
 
   
@@ -54,11 +58,38 @@ struct player : undo_manager, audioworker, midiworker {
     input_plugincollection inputPluginCollection;
     output_plugincollection outputPluginCollection;
     recorder_plugincollection recorderPluginCollection;
+#if defined(ZZUB_RTCHECK)
+    rtcheck_plugincollection rtcheckPluginCollection;
+#endif
     vector<pluginlib*> plugin_libraries;
     vector<string> plugin_folders;
     vector<const zzub::info*> plugin_infos;
+    plugin_cache plugins_cache;
+    bool scanning_plugins;					// libraries register their infos in scan order afterwards
+    std::thread plugin_refresh_thread;		// loads the libraries restored from the plugin cache
+    std::atomic<bool> plugin_refresh_done;	// the lazy libraries are ready to be published
+    std::atomic<bool> plugin_refresh_cancel;
     host_info hostinfo;
     thread_id_t user_thread_id;
+    size_t user_events_dropped;		// overflow count last reported by process_user_event_queue()
+    std::atomic<bool> is_rendering_offline;	// the audio thread outputs silence while set
+    std::atomic<bool> is_render_cancelled;
+    std::function<void(int, int)> ccm_progress;	// wave levels done and total while loading or saving a ccm
+
+    // a save_ccm_async() in progress
+    struct async_save {
+        int id;
+        std::string path;
+        CcmWriter* writer;
+        std::thread thread;
+        std::atomic<bool> done;
+        bool result;
+    };
+    vector<async_save*> async_saves;
+    int last_async_save_id;
+
+    int block_size_setting;			// set_block_size(), 0 follows the buffer size of the driver
+
     player();
     virtual ~player(void);
 
@@ -67,12 +98,15 @@ struct player : undo_manager, audioworker, midiworker {
     void initialize_plugin_libraries();
     void initialize_plugin_directory(string folder);
     void load_plugin_library(const string &fullpath);
+    void load_plugin_libraries(const vector<string>& paths);
+    void finish_plugin_refresh(bool cancel);
 
     // audioworker
     virtual void work_stereo(int sample_count);
     virtual void audio_enabled();
     virtual void audio_disabled();
     virtual void samplerate_changed();
+    virtual void buffersize_changed();
 
     // midiworker
     void midiEvent(unsigned short status, unsigned char data1, unsigned char data2);
@@ -92,6 +126,17 @@ struct player : undo_manager, audioworker, midiworker {
     void play_plugin_note(int plugin_id, int note, int prevNote, int velocity);
     void reset_keyjazz();
     void set_play_position(int pos);
+    void set_work_mode(work_mode mode, int thread_count);
+    void set_block_size(int size);
+    int get_block_size();
+    void apply_block_size(int size);
+    int render_offline(int start, int end, const std::string& path, wave_buffer_type format, std::function<bool(int, float)> progress);
+    void cancel_render();
+    void set_tracing(bool enable);
+    int save_trace(const std::string& path);
+    int get_plugin_work_time_stats(int plugin_id, float& p50, float& p99, float& max);
+    int save_ccm_async(const std::string& path);
+    void finish_async_saves(bool wait, bool send_events);
 
     // user methods for creating compound, undoable operations
     // any of these must be enclosed by calls to begin_operation() and commit_operation().
@@ -115,6 +160,7 @@ struct player : undo_manager, audioworker, midiworker {
     void plugin_set_pattern_name(int plugin_id, int index, std::string name);
     void plugin_set_pattern_length(int plugin_id, int index, int rows);
     void plugin_set_pattern_value(int plugin_id, int index, int group, int track, int column, int row, int value);
+    void plugin_set_pattern_values(int plugin_id, int index, const int* cells, int count);
     void plugin_insert_pattern_rows(int plugin_id, int pattern, int* column_indices, int num_indices, int start, int rows);
     void plugin_remove_pattern_rows(int plugin_id, int pattern, int* column_indices, int num_indices, int start, int rows);
     bool plugin_add_input(int to_id, int from_id, connection_type type);
@@ -167,11 +213,15 @@ struct zzub_flatapi_player : zzub::player {
     zzub_callback_t callback;
     void *callbackTag;
 
-    std::vector<zzub_event_data_t> event_queue;
-    unsigned int read_event_queue;
-    unsigned int write_event_queue;
+    // events are pushed from whatever thread invokes the handler and popped on the user thread.
+    // popped events are copied to event_batch, which stays valid until the next pop.
+    zzub::event_queue event_queue;
+    std::vector<zzub::event_message> message_batch;
+    std::vector<zzub_event_data_t> event_batch;
+    size_t events_dropped;
 
     zzub_flatapi_player();
     zzub_event_data_t *pop_event();
+    int pop_events(zzub_event_data_t** events, int max_count);
     void push_event(zzub_event_data_t &data);
 };
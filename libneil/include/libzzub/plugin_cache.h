@@ -0,0 +1,88 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "zzub/plugin.h"
+
+namespace zzub {
+
+struct pluginlib;
+
+// a zzub::info read from the plugin cache. the library it came from is loaded when the first
+// plugin is created from it, and the calls are forwarded to the info the library registers
+// with the same uri.
+struct cached_info : zzub::info {
+    pluginlib* lib;
+    bool has_plugin_lib;					// the real info has a plugin_lib
+    mutable const zzub::info* loaded;
+    std::list<std::string> strings;			// backs the parameter and attribute names
+
+    cached_info(pluginlib* _lib) : lib(_lib), has_plugin_lib(false), loaded(0) { }
+
+    // loads the library if needed, returns 0 if it no longer has this plugin
+    const zzub::info* resolve() const;
+
+    // true if the library's info has the parameters and attributes that were cached
+    bool matches(const zzub::info& loaded) const;
+
+    virtual zzub::plugin* create_plugin() const;
+    virtual bool store_info(zzub::archive* arc) const;
+};
+
+// returns the info registered by the library for cached infos, and info itself for the rest
+const zzub::info* resolve_info(const zzub::info* info);
+
+// the infos of the plugin libraries found on the last start, keyed by the path, modification
+// time and size of the library. libraries that match are not loaded until they are needed.
+struct plugin_cache {
+    struct library {
+        long long mtime;
+        long long size;
+        std::vector<char> infos;			// serialized with write_infos()
+        bool used;							// found in a plugin folder this session
+    };
+
+    std::string path;						// the cache file, empty to disable
+    std::map<std::string, library> libraries;
+    bool dirty;
+    std::thread save_thread;
+
+    plugin_cache();
+    ~plugin_cache();
+
+    void load();
+
+    // returns the entry for the library if it is unchanged on disk, or 0
+    library* find(const std::string& fileName, long long mtime, long long size);
+
+    // records the infos the library registered on loading. returns true if they changed.
+    bool store(const std::string& fileName, long long mtime, long long size, const std::list<const zzub::info*>& infos);
+
+    // writes the cache file on a background thread if anything was stored since the last save
+    void save_async();
+    void wait();
+
+    static void write_infos(std::vector<char>& bytes, const std::list<const zzub::info*>& infos);
+    static bool read_infos(const std::vector<char>& bytes, pluginlib* lib, std::vector<cached_info*>& infos);
+};
+
+}
@@ -21,6 +21,8 @@
 
 #include "libzzub/tools.h"
 #include <list>
+#include <mutex>
+#include <vector>
 
 
 namespace zzub {
@@ -28,6 +30,7 @@ namespace zzub {
 struct info;
 struct mixer;
 struct pluginloader;
+struct cached_info;
 
 // a pluginlib maintains the generic dll handle
 struct pluginlib : pluginfactory {
@@ -37,10 +40,24 @@ struct pluginlib : pluginfactory {
     std::list<const zzub::info*> loaders;
     zzub::player &player;
 
+    // a lazy library registered the infos from the plugin cache instead of loading the dll.
+    // the dll is loaded in the background after startup, or by ensure_loaded() when the first
+    // plugin is created, and the infos are published on the user thread.
+    bool lazy;
+    bool resolving;								// initializing a lazy library
+    std::vector<cached_info*> cached;
+    std::mutex load_lock;						// held while the dll of a lazy library is loaded
+    bool dll_loaded;							// under load_lock
+
     pluginlib(const std::string& fileName, zzub::player &p, zzub::plugincollection *_collection = 0);
+    pluginlib(const std::string& fileName, zzub::player &p, const std::vector<char>& cache);
     virtual ~pluginlib();
     void init_dll();
     void unload();
+    bool ensure_loaded();
+    void load_lazy_dll();
+    void publish_loaded_infos();
+    void publish_infos();						// adds the infos to the player after scanning
     virtual void register_info(const zzub::info *_info);
 };
 
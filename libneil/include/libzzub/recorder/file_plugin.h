@@ -27,7 +27,15 @@ namespace record {
 }
 
 
-struct recorder_file_plugin : plugin {
+// the audio thread only writes samples. opening and closing the file allocates and starts
+// the writer thread, so the audio thread asks for it with a custom event that invoke()
+// handles on the user thread.
+struct recorder_file_plugin : plugin, event_handler {
+    enum {
+        request_open = 1,
+        request_close = 2,
+    };
+
     recorder_file_plugin();
 
     virtual void destroy();
@@ -52,6 +60,8 @@ struct recorder_file_plugin : plugin {
     virtual void configure(const char *key, const char *value);
     virtual void add_input(const char *name, zzub::connection_type type);
 
+    virtual bool invoke(zzub_event_data_t& data);
+
     
 
 private:
@@ -59,6 +69,7 @@ private:
     std::vector<float*>& collect_inputs(float **pin, int numsamples);
     void set_channel_names(std::vector<std::string> names);
     void init_channel_buffers(int channel_count);
+    void post_request(int request);
 
 
 
@@ -69,6 +80,7 @@ private:
     int ticksWritten;
     bool updateRecording;
     bool recordingMulti;
+    bool fileRequested;		// audio thread: an open was posted and no close yet
 
     wave_buffer_type format;
     std::string waveFilePath;
@@ -96,7 +108,7 @@ private:
 
     gvals g;
     gvals lg;
-    int a[2];
+    int a[4];
 };
 
 
@@ -2,7 +2,11 @@
 
 #include "zzub/plugin.h"
 #include <sndfile.h>
+#include <semaphore.h>
+#include <pthread.h>
+#include <atomic>
 #include <string>
+#include <vector>
 
 namespace zzub {
 
@@ -35,6 +39,48 @@ struct polywav_channel_data : channel_data {
 
 
 
+// when the writer thread flushes the file to disk
+enum file_recorder_sync {
+    file_recorder_sync_never,
+    file_recorder_sync_on_close,
+    file_recorder_sync_periodic		// every sync_interval seconds of audio
+};
+
+
+// one open wave file. the audio thread interleaves into the ring and a writer thread drains it
+// into the file, so disk stalls never reach the audio thread. after close() the writer finishes
+// the file on its own, the recorder joins the thread before it opens the next file.
+struct file_writer {
+    SNDFILE* wave_file;
+    channel_data* channel_data_writer;
+    uint channels;
+
+    std::vector<float> ring;			// interleaved frames
+    size_t capacity;					// in frames, power of two
+    std::atomic<size_t> write_frame;
+    std::atomic<size_t> read_frame;
+    std::atomic<bool> closing;
+
+    file_recorder_sync sync_policy;
+    size_t sync_interval;				// in frames
+    size_t frames_since_sync;
+
+    sem_t signal;
+    pthread_t thread;
+
+    file_writer(SNDFILE* wave_file, channel_data* channel_data_writer, uint channels, size_t depth);
+    ~file_writer();
+
+    size_t get_free_frames() const {
+        return capacity - (write_frame.load(std::memory_order_relaxed) - read_frame.load(std::memory_order_acquire));
+    }
+
+    void drain();
+    void run();
+    static void* thread_proc(void* p);
+};
+
+
 class file_recorder {
 public: 
 
@@ -48,12 +94,26 @@ public:
 
     std::vector<std::string> channel_names;
 
-    SNDFILE *wave_file;
+    // seconds of audio buffered for the writer thread
+    float buffer_depth = 2.0f;
+
+    file_recorder_sync sync_policy = file_recorder_sync_on_close;
+
+    float sync_interval = 1.0f;
 
-    // the sample data is received as float[num_channels][buffer_size] sndfile wans float[buffer_size][num_channels]
-    float *sf_samples = nullptr;
+    // write() waits for the writer thread instead of dropping audio when the buffer is full.
+    // used for offline rendering, never set this when writing from the audio thread
+    bool blocking = false;
 
-    channel_data* channel_data_writer = nullptr;
+    // blocks that did not fit in the buffer, and their size in frames
+    std::atomic<size_t> overrun_count{0};
+    std::atomic<size_t> overrun_frames{0};
+
+    // set by open() and cleared by close() on the user thread, write() only reads it
+    std::atomic<file_writer*> writer{nullptr};
+
+    // closed without waiting and possibly still finishing its file
+    file_writer* closed_writer = nullptr;
 
     file_recorder(
         const std::string& path, 
@@ -74,14 +134,19 @@ public:
     : channels(channels),
       path(path),
       format(format),
-      sample_rate(sample_rate),
-      wave_file(nullptr)
+      sample_rate(sample_rate)
     {
         for(uint i = 0; i < channels; ++i) {
             channel_names.push_back("Channel " + std::to_string(i + 1));
         }
     }
 
+
+    ~file_recorder()
+    {
+        close(true);
+    }
+
     
     void set_channels(std::vector<std::string> names);
 
@@ -110,23 +175,61 @@ public:
     }
 
 
+    // these take effect when the next file is opened
+    void set_buffer_depth(float seconds)
+    {
+        this->buffer_depth = seconds;
+    }
+
+
+    void set_sync_policy(file_recorder_sync policy, float interval = 1.0f)
+    {
+        this->sync_policy = policy;
+        this->sync_interval = interval;
+    }
+
+
+    void set_blocking(bool blocking)
+    {
+        this->blocking = blocking;
+    }
+
+
+    size_t get_overrun_count() const
+    {
+        return overrun_count.load(std::memory_order_relaxed);
+    }
+
+
+    size_t get_overrun_frames() const
+    {
+        return overrun_frames.load(std::memory_order_relaxed);
+    }
+
+
+    // open() and close() allocate, start threads and print, call them from the user thread
     bool open();
 
 
+    // the only call that is safe on the audio thread. blocks larger than the buffer are
+    // written in pieces
     void write(
         float** samples, 
         int numSamples
     );
 
 
-    void close();
+    // wait = true returns when the file is complete, otherwise the writer thread finishes it.
+    // open() waits for that writer, so the same path can be opened again right away
+    void close(bool wait = false);
     
 
     bool is_open() const;
 
 private:
     SF_INFO build_info();
+    void join_closed_writer();
 };
 
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,73 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+namespace zzub {
+
+// real time safety checker, built with scons RTCHECK=1. while a thread is inside an
+// rtcheck_scope, memory allocation, mutex and semaphore waits, sleeping, console output and
+// file i/o are reported on stderr with a backtrace and the plugin that was running. set
+// ZZUB_RTCHECK=abort in the environment to abort on the first violation instead.
+//
+// the checks live in libzzub_rtcheck.so, which must be preloaded (LD_PRELOAD) to see the
+// calls of libzzub and the plugins. without RTCHECK the scopes are empty and
+// rtcheck_violations() returns -1.
+
+#if defined(ZZUB_RTCHECK)
+
+// marks the calling thread as a real time thread
+struct rtcheck_scope {
+    rtcheck_scope();
+    ~rtcheck_scope();
+};
+
+// suspends the checks, for the blocking the engine does on purpose
+struct rtcheck_allow {
+    rtcheck_allow();
+    ~rtcheck_allow();
+};
+
+// names the plugin that runs on this thread in the reports
+struct rtcheck_plugin {
+    const char* prev;
+    rtcheck_plugin(const char* name);
+    ~rtcheck_plugin();
+};
+
+// the number of violations reported since the library was loaded, -2 if the checker was
+// not preloaded and sees nothing
+int rtcheck_violations();
+
+#else
+
+struct rtcheck_scope {
+    rtcheck_scope() { }
+};
+
+struct rtcheck_allow {
+    rtcheck_allow() { }
+};
+
+struct rtcheck_plugin {
+    rtcheck_plugin(const char*) { }
+};
+
+inline int rtcheck_violations() { return -1; }
+
+#endif
+
+}
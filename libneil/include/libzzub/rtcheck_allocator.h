@@ -0,0 +1,47 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#pragma once
+
+namespace zzub {
+
+// a generator that allocates in every process_stereo(), so tests can check that the real time
+// checker reports it. only registered in RTCHECK builds.
+struct rtcheck_allocator_info : zzub::info {
+    rtcheck_allocator_info() {
+        this->flags = zzub::plugin_flag_has_audio_output;
+        this->name = "RTCHECK Allocator";
+        this->short_name = "Allocator";
+        this->author = "n/a";
+        this->uri = "@zzub.org/rtcheck/allocator";
+    }
+
+    virtual zzub::plugin* create_plugin() const;
+    virtual bool store_info(zzub::archive *) const { return false; }
+};
+
+struct rtcheck_plugincollection : plugincollection {
+    rtcheck_allocator_info allocator_info;
+
+    virtual void initialize(zzub::pluginfactory *factory);
+    virtual const zzub::info *get_info(const char *uri, zzub::archive *arc) { return 0; }
+    virtual const char *get_uri() { return 0; }
+    virtual void configure(const char *key, const char *value) {}
+    virtual void destroy() {}
+};
+
+}
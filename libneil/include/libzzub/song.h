@@ -26,7 +26,11 @@
 #include "libzzub/master.h"
 #include "libzzub/driver.h"
 #include "libzzub/timer.h"
+#include "libzzub/trace.h"
+#include "libzzub/buffer_arena.h"
 #include "libzzub/metaplugin.h"
+#include "libzzub/work_scheduler.h"
+#include "libzzub/event_queue.h"
 
 using std::pair;
 using std::string;
@@ -106,12 +110,6 @@ struct midimapping {
     }
 };
 
-struct event_message {
-    int plugin_id;
-    event_handler* event;
-    zzub_event_data data;
-};
-
 struct sequence_proxy {
     player* _player;
     int track;
@@ -127,6 +125,20 @@ struct sequencer_track {
     sequence_proxy* proxy;
 };
 
+// playing position in a sequencer track: the last event at or before the song position, or -1
+struct sequencer_cursor {
+    int index;
+
+    sequencer_cursor() : index(-1) { }
+
+    // binary search for the event at position
+    void seek(const sequencer_track& t, int position);
+
+    // moves the cursor to position. ticking forward stays on the current event or steps to
+    // the next one, anything else is a jump and seeks
+    void update(const sequencer_track& t, int position);
+};
+
 // only valid in zzub::song
 #define ASSERT_PLUGIN(plugin_id) assert(plugin_id >= 0 && plugin_id < plugins.size()); assert(plugins[plugin_id] != 0);
 
@@ -136,18 +148,24 @@ struct song {
     vector<metaplugin*> plugins;
     vector<plugin_descriptor> work_order;
     vector<plugin_descriptor> cv_work_order;
+    vector<work_level> work_levels;					// work_order grouped by depth, for parallel processing
+    vector<int> work_buffer_slots;					// [plugin_id] -> buffer_arena slot of the plugins output, or -1
+    int work_buffer_slot_count;
+    vector<char> work_feedback_history;				// [plugin_id] -> the output is read by feedback or cv connections
 
-    vector<event_message> user_event_queue;
-    unsigned int user_event_queue_read, user_event_queue_write;
+    event_queue* user_event_queue;					// owned by the mixer, the back buffer has none
     int enable_event_queue;
     vector<midimapping> midi_mappings;
     vector<sequencer_track> sequencer_tracks;
+    vector<vector<int> > plugin_sequencer_tracks;	// [plugin_id] -> indices of the plugin's tracks in sequencer_tracks
+    vector<sequencer_cursor> sequencer_cursors;		// playing position in each track, used by the mixer
     wave_table wavetable;
     int song_begin, song_end, song_loop_begin, song_loop_end, song_loop_enabled;
     string song_comment;
     int seqstep;
     vector<keyjazz_note> keyjazz;
     int midi_plugin;
+    bool defer_work_order;							// make_work_order() does nothing while building a song
 
     song();
     virtual ~song() { }
@@ -158,11 +176,18 @@ struct song {
     plugin_descriptor get_plugin_descriptor(string name);
     int get_plugin_id(plugin_descriptor index);
     void process_plugin_events(int plugin_id);
+    void process_plugin_events_unplanned(int plugin_id);
     void make_work_order();
+    void make_work_levels();
+    void make_work_buffer_slots(const vector<int>& depth);
+    void update_sequencer_index();
+    const vector<int>& get_plugin_sequencer_tracks(int plugin_id) const;
     int get_plugin_parameter_track_row_bytesize(int plugin_id, int g, int t);
     void transfer_plugin_parameter_track_row(int plugin_id, int g, int t, const pattern& from_pattern, void* param_ptr, int row, bool copy_all);
     void transfer_plugin_parameter_row(int plugin_id, int g, const pattern& from_pattern, pattern& target_pattern, int from_row, int target_row, bool copy_all);
     void transfer_plugin_parameter_track_row(int plugin_id, int g, int t, const void* source, zzub::pattern& to_pattern, int row, bool copy_all);
+    void make_parameter_transfer_plan(int plugin_id);
+    void merge_plugin_parameter_row(int plugin_id, const pattern& from_pattern, pattern& target_pattern, int from_row, int target_row);
 
     // connection:
     int plugin_get_input_connection_count(int plugin_id);
@@ -185,9 +210,9 @@ struct song {
 
     // pattern utility:
 
-    void reset_plugin_parameter_group(pattern::group& group, const vector<const parameter*>& parameters);
-    void reset_plugin_parameter_track(pattern::track& track, const vector<const parameter*>& parameters);
-    void default_plugin_parameter_track(pattern::track& track, const vector<const parameter*>& parameters);
+    void reset_plugin_parameter_group(pattern& p, int group, const vector<const parameter*>& parameters);
+    void reset_plugin_parameter_track(pattern& p, int group, int track, const vector<const parameter*>& parameters);
+    void default_plugin_parameter_track(pattern& p, int group, int track, const vector<const parameter*>& parameters);
     void set_pattern_tracks(pattern& p, const vector<const parameter*>& parameters, int tracks, bool set_defaults);
     void set_pattern_length(int plugin_id, pattern& p, int rows);
     void add_pattern_connection_track(zzub::pattern& pattern, const vector<const parameter*>& parameters);
@@ -244,19 +269,24 @@ struct mixer : song {
     int song_position;								// current song position
     int work_position;								// total accumulation of samples processed
     int work_chunk_size;							// size of chunk in current buffer we're mixing
+    int block_size;									// largest chunk, plugins without plugin_flag_large_blocks get it in pieces of buffer_size
     int last_tick_work_position;					// at which workPos we last ticked
     int last_tick_position;							// at which song position we last ticked
     player_state last_tick_state;					// whether mixer state was playing or stopped last tick
     double work_tick_fracs;							// accumulated fractions of samples not processed
-    std::vector<int> sequencer_indices;				// currently playing index in each track
     zzub::master_info master_info;
     master_plugin_info master_plugininfo;
     plugin_descriptor solo_plugin;
-    vector<vector<float> > mix_buffer;
+    buffer_arena work_buffers;						// plugin outputs, slots assigned by work_buffer_slots
+    buffer_arena mix_arena;
+    float* mix_buffer[2];
+    event_queue user_events;						// drained by player::process_user_event_queue()
     float* inputBuffer[audiodriver::MAX_CHANNELS];
     float* outputBuffer[audiodriver::MAX_CHANNELS];
 
     zzub::timer timer;								// hires timer, for cpu-meter
+    work_scheduler scheduler;
+    zzub::tracer tracer;							// records of the work on the audio and worker threads
 
     string load_error;
     string load_warning;
@@ -266,6 +296,14 @@ struct mixer : song {
     // processing methods
     int generate_audio(int sample_count);
     void work_plugin(plugin_descriptor plugindesc, int sample_count);
+    void work_plugin(plugin_descriptor plugindesc, int sample_count, float** scratch_buffer);
+    bool work_plugin_audio(plugin_descriptor plugindesc, metaplugin& mp, int sample_count, float** scratch_buffer);
+    bool takes_whole_chunk(const metaplugin& mp, int sample_count);
+    bool process_stereo_pieces(plugin_descriptor plugindesc, metaplugin& mp, float** plin, float** plout, int sample_count, int flags, bool input_in_pieces);
+    void assign_work_buffers();
+    void set_block_size(int size);
+    size_t get_buffer_working_set();
+    bool plugin_is_sleeping(plugin_descriptor plugindesc, const metaplugin& mp);
     void process_sequencer_events(plugin_descriptor plugindesc);
     int determine_chunk_size(int sample_count, double& tick_fracs, int& next_tick_position);
     void process_sequencer_events();
@@ -152,14 +152,11 @@ struct mem_outstream : zzub::outstream {
     mem_outstream(std::vector<char> &b) : buffer(b), pos(0) {}
 
     virtual int write(void *buffer, int size) {
-        char *charbuf = (char*)buffer;
-        int ret = size;
+        if (size <= 0) return 0;
         if (pos + size > (int)this->buffer.size()) this->buffer.resize(pos+size);
-        while (size--) {
-            //this->buffer.push_back(*charbuf++);
-            this->buffer[pos++] = *charbuf++;
-        }
-        return ret;
+        memcpy(&this->buffer[pos], buffer, size);
+        pos += size;
+        return size;
     }
 
     virtual long position() {
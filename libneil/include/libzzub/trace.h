@@ -0,0 +1,152 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace zzub {
+
+enum trace_kind {
+    trace_kind_poll,				// poll_operations(), applies edits and swaps song data in
+    trace_kind_swap_wait,			// waiting for swap_lock
+    trace_kind_chunk,				// one generate_audio() chunk
+    trace_kind_process_events,		// a plugins parameter transfers and process_events(), id is the plugin
+    trace_kind_process_stereo,		// a plugins process_stereo(), id is the plugin
+    trace_kind_connection,			// a connections work(), id is the target and arg the source plugin
+};
+
+struct trace_record {
+    unsigned long long begin, end;	// steady clock nanoseconds
+    int kind;
+    int id, arg;
+    int thread;						// index of the ring it was written to
+};
+
+// records written by one thread and read by tracer::drain() on another. when the reader falls
+// behind the ring fills up, and new records are dropped rather than blocking the writer.
+// a ring is claimed by one thread at a time and handed to another thread after it exits.
+struct trace_ring {
+    enum { capacity = 8192 };		// power of two
+
+    std::vector<trace_record> records;
+    std::atomic<unsigned int> head;	// next slot to write, only written by the owning thread
+    std::atomic<unsigned int> tail;	// next slot to read, only written by drain()
+    std::atomic<unsigned int> dropped;
+    std::atomic<bool> claimed;		// a thread writes to the ring
+
+    trace_ring() : records(capacity), head(0), tail(0), dropped(0), claimed(false) { }
+
+    void push(const trace_record& r) {
+        unsigned int h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == capacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        records[h & (capacity - 1)] = r;
+        head.store(h + 1, std::memory_order_release);
+    }
+};
+
+// log scale histogram of durations, four buckets per octave of nanoseconds
+struct trace_histogram {
+    enum { bucket_count = 4 * 40 };
+
+    unsigned long long counts[bucket_count];
+    unsigned long long count;
+    unsigned long long max;
+
+    trace_histogram() { clear(); }
+    void clear();
+    void add(unsigned long long ns);
+
+    // the upper edge of the bucket holding fraction p of the samples, in nanoseconds
+    unsigned long long percentile(double p) const;
+};
+
+// timestamped records of the audio thread and the worker threads. each thread claims a ring
+// of its own the first time it writes while tracing is enabled, so writing never locks or
+// allocates. the claim is given back when the thread exits, so restarted audio devices and
+// worker pools reuse the rings of the threads they replaced. the rings are allocated by
+// enable() and reserve() on the user thread.
+struct tracer {
+    enum { max_rings = 256 };
+
+    std::atomic<bool> enabled;
+    unsigned int serial;						// tells the thread local ring claims of tracers apart
+    std::shared_ptr<trace_ring> rings[max_rings];	// a claim keeps its ring alive after the tracer is gone
+    std::atomic<int> ring_count;				// allocated rings
+    std::atomic<unsigned int> ringless;			// records of threads that found no free ring
+
+    std::mutex drain_lock;
+    std::vector<trace_record> records;			// drained and not yet saved
+    std::map<int, trace_histogram> plugin_histograms;	// process_stereo() times by plugin id
+    unsigned long long dropped;
+
+    tracer();
+
+    // starts tracing with rings for thread_count threads and clears the histograms
+    void enable(int thread_count);
+    void disable();
+    // adds rings for thread_count threads that have not claimed one yet, when the worker pool restarts
+    void reserve(int thread_count);
+
+    static unsigned long long now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void write(int kind, int id, int arg, unsigned long long begin, unsigned long long end);
+
+    // moves the records of all rings into records and the histograms. called on the user thread,
+    // by player::process_user_event_queue() while tracing so the rings do not fill up.
+    void drain();
+
+    // drains and writes the records as chrome trace json, then forgets them. plugin_name
+    // names the plugin events. returns the number of records written or -1.
+    int save_chrome_trace(const std::string& path, const std::function<std::string(int)>& plugin_name);
+
+private:
+    trace_ring* claim_ring();
+};
+
+// records the lifetime of the scope when tracing is enabled
+struct trace_scope {
+    tracer* t;
+    int kind, id, arg;
+    unsigned long long begin;
+
+    trace_scope(tracer& _t, int _kind, int _id = -1, int _arg = -1) {
+        t = _t.enabled.load(std::memory_order_relaxed) ? &_t : 0;
+        if (!t) return;
+        kind = _kind;
+        id = _id;
+        arg = _arg;
+        begin = tracer::now();
+    }
+
+    ~trace_scope() {
+        if (t) t->write(kind, id, arg, begin, tracer::now());
+    }
+};
+
+}
@@ -152,10 +152,20 @@ struct undo_manager {
     bool is_flushing;
     bool ignore_undo;
 
+    // song build mode, see begin_song_build()
+    int song_build_depth;
+    bool song_build_ignore_undo;
+
+    // sample buffers that clear_swap_song() takes out of the song are parked here instead of
+    // freed while a background save may still read them
+    int sample_retainers;
+    vector<short*> retired_samples;
+
     undo_manager();
     ~undo_manager();
     void reset();
     void merge_backbuffer_flags(operation_copy_flags flags);
+    void merge_wavelevel_flags(const operation_copy_flags& flags);
     bool prepare_operation_redo(operation* singleop);
     void prepare_operation_undo(operation* singleop);
     void flush_operations(zzub_event_data_t* do_event, zzub_event_data_t* redo_event, zzub_event_data_t* undo_event);
@@ -166,6 +176,10 @@ struct undo_manager {
     void write_swap_song(zzub::song& song, const operation_copy_flags& flags);
     void wait_swap_song_pointers();
     void clear_swap_song(zzub::song& song, const operation_copy_flags& flags);
+    void retain_samples();
+    void release_samples();
+    void begin_song_build();
+    void end_song_build();
 
     void commit_to_history(std::string description);
     void flush_from_history();
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 #include "zzub/consts.h"
@@ -9,6 +10,8 @@
 
 namespace zzub {
 
+struct wave_peaks;
+
 struct envelope_info {
     const char *name;
     int flags;
@@ -66,6 +69,7 @@ struct wave_level {
 
 struct wave_level_ex : wave_level {
     wavelevel_proxy* proxy;
+    std::shared_ptr<wave_peaks> peaks;  // digest summary, see wave_peaks.h
 
     wave_level_ex() {
         proxy = 0;
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace zzub {
+
+struct wave_info_ex;
+struct wave_level_ex;
+
+// min/max/power summary of the samples in a wave level, stored as a pyramid of levels with
+// growing block sizes. the first level summarizes block_size samples per entry and every next
+// level merges two entries of the one below, so a digest value is read from a few entries and
+// at most two partial blocks of raw samples, at any zoom.
+struct wave_peaks {
+    enum { block_size = 128 };
+
+    struct entry {
+        float min, max;
+        float power;							// sum of the squared samples
+    };
+
+    // the sample data the summary was built from
+    const void* samples;
+    int sample_count;
+    int format;
+    int channels;
+
+    int valid_samples;							// the samples before this are summarized
+    std::vector<std::vector<entry> > levels;	// [level][block * channels + channel]
+
+    wave_peaks();
+
+    bool matches(const wave_info_ex& w, const wave_level_ex& l) const;
+
+    // summarizes the samples from valid_samples to the end of the level
+    void update(const wave_info_ex& w, const wave_level_ex& l);
+
+    // rebuilds the upper levels from the first level, for summaries that were loaded from disk
+    void merge_levels(int first_sample);
+};
+
+// returns an up to date summary of the level, building or extending it when needed
+const wave_peaks& get_wave_peaks(wave_info_ex& w, wave_level_ex& l);
+
+// called after the level was reallocated with new samples from pos on. the summary of the
+// samples before pos is kept, the rest is summarized on the next digest.
+void invalidate_wave_peaks(wave_info_ex& w, wave_level_ex& l, const std::shared_ptr<wave_peaks>& old_peaks, int pos);
+
+// fills digestsize min/max/rms values for the samples in [start, end) of one channel
+void get_wave_digest(wave_info_ex& w, wave_level_ex& l, int channel, int start, int end, float* mindigest, float* maxdigest, float* ampdigest, int digestsize);
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "zzub/zzub.h"
+#include "libzzub/graph.h"
+#include "libzzub/buffer_arena.h"
+
+namespace zzub {
+
+struct mixer;
+
+enum work_mode {
+    work_mode_serial = zzub_work_mode_serial,
+    work_mode_parallel = zzub_work_mode_parallel
+};
+
+
+// one depth of the work order. plugins in 'parallel' only depend on plugins in earlier
+// levels and can run concurrently. plugins in 'serial' are flagged as not thread safe
+// and run alone on the audio thread after the parallel part of the level has finished.
+struct work_level {
+    std::vector<plugin_descriptor> parallel;
+    std::vector<plugin_descriptor> serial;
+};
+
+
+// runs work_plugin() over the work levels of a mixer, either serially on the audio
+// thread or spread over a pool of real time worker threads. both modes finish a level
+// before the next one starts, song::make_work_buffer_slots() relies on that.
+//
+// the audio thread runs levels with a single plugin inline and only wakes the workers
+// at the first level with more than one, then publishes one level at a time and takes
+// part in the work itself. workers claim plugins from the
+// published level with a compare-and-swap on a packed (level, index) cursor, so no locks
+// are taken on the audio path. configure() must not be called while the audio thread
+// is inside run() - the player holds swap_lock for that.
+struct work_scheduler {
+    enum {
+        max_threads = 64,
+        worker_priority = 70,	// SCHED_FIFO priority, silently ignored without rt permissions
+    };
+
+    work_scheduler();
+    ~work_scheduler();
+
+    void configure(work_mode mode, int thread_count);
+    void set_block_size(int size);
+    work_mode get_mode() const { return mode; }
+    int get_thread_count() const { return (int)workers.size(); }
+    size_t get_scratch_size() const;
+
+    void run(mixer& m, const std::vector<work_level>& levels, int sample_count);
+
+private:
+    struct worker_thread {
+        work_scheduler* owner;
+        int index;
+        pthread_t thread;
+        buffer_arena mix_arena;
+        float* mix_buffer[2];
+    };
+
+    work_mode mode;
+    int block_size;
+    std::vector<worker_thread*> workers;
+    sem_t start_signal;
+    std::atomic<bool> quit;
+
+    // state of the current cycle, written by the audio thread before the workers are woken
+    mixer* cycle_mixer;
+    const std::vector<work_level>* cycle_levels;
+    int cycle_sample_count;
+
+    std::atomic<unsigned long long> cursor;		// (level << 32) | next plugin index
+    std::atomic<int> pending;					// plugins of the current level not yet finished
+    std::atomic<bool> cycle_done;
+    std::atomic<int> running;					// workers awake and registered in the current cycle
+
+    void start_workers(int thread_count);
+    void stop_workers();
+    void work_level_plugins(int level, float** mix_buffer);
+    void worker(worker_thread& w);
+    static void* thread_proc(void* param);
+};
+
+}
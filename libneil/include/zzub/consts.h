@@ -6,7 +6,7 @@
 
 namespace zzub {
 
-inline const std::string ccm_version = "0.1";
+inline const std::string ccm_version = "0.2";	// 0.2: binary pattern entries
 
 enum {
     // Current version of the zzub interface. Pass this to the
@@ -23,6 +23,12 @@ enum {
     buffer_size = zzub_buffer_size
 };
 
+// special values for zzub::info::tail_length
+enum {
+    tail_length_infinite = -1,	// never goes silent, always processed
+    tail_length_auto = -2		// sleeps when input and output have been silent for a second
+};
+
 // Possible event types sent by the host. A plugin can register to
 // receive these events in zzub::plugin::init() using the
 // zzub::host::set_event_handler() method.
@@ -49,6 +55,7 @@ enum event_type {
     event_type_pre_delete_pattern = zzub_event_type_pre_delete_pattern,
     event_type_delete_pattern = zzub_event_type_delete_pattern,
     event_type_edit_pattern = zzub_event_type_edit_pattern,
+    event_type_edit_pattern_block = zzub_event_type_edit_pattern_block,
     event_type_pattern_changed = zzub_event_type_pattern_changed,
     event_type_pre_disconnect = zzub_event_type_pre_disconnect,
     event_type_pre_connect = zzub_event_type_pre_connect,
@@ -68,6 +75,7 @@ enum event_type {
 
     event_type_player_state_changed = zzub_event_type_player_state_changed,
     event_type_osc_message = zzub_event_type_osc_message,
+    event_type_save_complete = zzub_event_type_save_complete,
 
     event_type_envelope_changed = zzub_event_type_envelope_changed,
     event_type_slices_changed = zzub_event_type_slices_changed,
@@ -172,7 +180,9 @@ enum plugin_flag {
     plugin_flag_has_cv_input = zzub_plugin_flag_has_cv_input,
     plugin_flag_has_cv_output = zzub_plugin_flag_has_cv_output,
     plugin_flag_is_cv_generator = zzub_plugin_flag_is_cv_generator,
-    plugin_flag_has_ports = zzub_plugin_flag_has_ports
+    plugin_flag_has_ports = zzub_plugin_flag_has_ports,
+    plugin_flag_not_thread_safe = zzub_plugin_flag_not_thread_safe,
+    plugin_flag_large_blocks = zzub_plugin_flag_large_blocks
 
 };
 
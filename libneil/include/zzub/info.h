@@ -23,6 +23,11 @@ struct info {
     lib *plugin_lib;
     std::string uri;
 
+    // milliseconds an effect keeps producing sound after its input went silent, or one of
+    // tail_length_infinite and tail_length_auto. the player stops calling process_stereo()
+    // when the input has been silent for longer than the tail.
+    int tail_length;
+
     std::vector<const zzub::parameter *> global_parameters;
 
     std::vector<const zzub::parameter *> track_parameters;
@@ -75,6 +80,7 @@ struct info {
         commands = "";
         plugin_lib = 0;
         uri = "";
+        tail_length = zzub::tail_length_infinite;
     }
 
     virtual ~info() {
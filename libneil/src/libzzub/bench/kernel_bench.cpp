@@ -0,0 +1,149 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// zzub-kernel-bench: checks that every mixing kernel set gives the same results as the
+// scalar set and times them on zzub_buffer_size blocks.
+//
+//   zzub-kernel-bench [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "zzub/zzub.h"
+#include "libzzub/kernels.h"
+
+using namespace zzub;
+
+namespace {
+
+const int block_size = zzub_buffer_size;
+
+struct buffers {
+    std::vector<float> in_l, in_r, in_stereo;
+    std::vector<float> out_l, out_r, out_stereo, out_mono;
+
+    buffers() : in_l(block_size), in_r(block_size), in_stereo(block_size * 2),
+        out_l(block_size), out_r(block_size), out_stereo(block_size * 2), out_mono(block_size) { }
+
+    void fill(unsigned int seed) {
+        srand(seed);
+        for (int i = 0; i < block_size; i++) {
+            in_l[i] = (float)rand() / RAND_MAX * 2 - 1;
+            in_r[i] = (float)rand() / RAND_MAX * 2 - 1;
+            out_l[i] = (float)rand() / RAND_MAX * 2 - 1;
+            out_r[i] = (float)rand() / RAND_MAX * 2 - 1;
+        }
+        for (int i = 0; i < block_size * 2; i++)
+            in_stereo[i] = (float)rand() / RAND_MAX * 2 - 1;
+    }
+};
+
+bool same(const std::vector<float>& a, const std::vector<float>& b) {
+    return memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+// runs every kernel on every length up to block_size, so the vector tails are covered too
+bool verify(const mixing_kernels& k, const mixing_kernels& reference) {
+    bool ok = true;
+    for (int n = 0; n <= block_size; n++) {
+        buffers a, b;
+        a.fill(n);
+        b.fill(n);
+
+        k.add_pan(&a.out_l[0], &a.out_r[0], &a.in_l[0], &a.in_r[0], n, 0.7f, 0.3f);
+        reference.add_pan(&b.out_l[0], &b.out_r[0], &b.in_l[0], &b.in_r[0], n, 0.7f, 0.3f);
+        k.add(&a.out_l[0], &a.in_r[0], n, 0.25f);
+        reference.add(&b.out_l[0], &b.in_r[0], n, 0.25f);
+        k.amp(&a.out_r[0], n, 1.5f);
+        reference.amp(&b.out_r[0], n, 1.5f);
+        k.copy_mono_to_stereo(&a.out_stereo[0], &a.in_l[0], n, 0.9f);
+        reference.copy_mono_to_stereo(&b.out_stereo[0], &b.in_l[0], n, 0.9f);
+        k.copy_stereo_to_mono(&a.out_mono[0], &a.in_stereo[0], n, 0.5f);
+        reference.copy_stereo_to_mono(&b.out_mono[0], &b.in_stereo[0], n, 0.5f);
+
+        if (!same(a.out_l, b.out_l) || !same(a.out_r, b.out_r) || !same(a.out_stereo, b.out_stereo) || !same(a.out_mono, b.out_mono)) {
+            printf("%s: buffers differ from %s at length %d\n", k.name, reference.name, n);
+            ok = false;
+        }
+        if (k.peak(&a.in_l[0], n) != reference.peak(&a.in_l[0], n)) {
+            printf("%s: peak differs from %s at length %d\n", k.name, reference.name, n);
+            ok = false;
+        }
+
+        std::vector<float> quiet(n, 0.00001f);
+        if (n > 0) quiet[n - 1] = -0.5f;
+        if (k.has_signals(quiet.data(), n) != reference.has_signals(quiet.data(), n) || k.has_signals(quiet.data(), n / 2) != reference.has_signals(quiet.data(), n / 2)) {
+            printf("%s: has_signals differs from %s at length %d\n", k.name, reference.name, n);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+template <typename F>
+double time_ns(int iterations, F f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+void bench(const mixing_kernels& k, int iterations) {
+    buffers b;
+    b.fill(1);
+    // keep the values from growing towards inf or denormals while looping
+    float amp_up = 1.0001f, amp_down = 1 / 1.0001f;
+    volatile float sink = 0;
+    volatile bool sink_signals = false;
+
+    double add_pan = time_ns(iterations, [&] { k.add_pan(&b.out_l[0], &b.out_r[0], &b.in_l[0], &b.in_r[0], block_size, 1e-6f, -1e-6f); });
+    double add = time_ns(iterations, [&] { k.add(&b.out_l[0], &b.in_l[0], block_size, 1e-6f); });
+    double amp = time_ns(iterations, [&] { k.amp(&b.out_r[0], block_size, (iterations & 1) ? amp_up : amp_down); });
+    double m2s = time_ns(iterations, [&] { k.copy_mono_to_stereo(&b.out_stereo[0], &b.in_l[0], block_size, 0.5f); });
+    double s2m = time_ns(iterations, [&] { k.copy_stereo_to_mono(&b.out_mono[0], &b.in_stereo[0], block_size, 0.5f); });
+    double peak = time_ns(iterations, [&] { sink = sink + k.peak(&b.in_l[0], block_size); });
+    std::vector<float> silence(block_size, 0.0f);
+    double signals = time_ns(iterations, [&] { sink_signals = k.has_signals(silence.data(), block_size); });
+
+    printf("%-8s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", k.name, add_pan, add, amp, m2s, s2m, peak, signals);
+}
+
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+    if (iterations < 1) iterations = 1;
+
+    const mixing_kernels& reference = *get_mixing_kernels(kernel_set_scalar);
+    bool ok = true;
+    for (int i = 0; i < kernel_set_count; i++) {
+        const mixing_kernels* k = get_mixing_kernels((kernel_set)i);
+        if (k && k != &reference) ok = verify(*k, reference) && ok;
+    }
+
+    printf("ns per %d sample block, %d iterations. selected set: %s\n", block_size, iterations, kernels().name);
+    printf("%-8s %10s %10s %10s %10s %10s %10s %10s\n", "set", "add_pan", "add", "amp", "m2s", "s2m", "peak", "signals");
+    for (int i = 0; i < kernel_set_count; i++) {
+        const mixing_kernels* k = get_mixing_kernels((kernel_set)i);
+        if (k) bench(*k, iterations);
+        else printf("%-8s not available\n", i == kernel_set_sse2 ? "sse2" : "avx2");
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,327 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// zzub-bench: renders songs through the silent driver as fast as possible and prints the
+// realtime factor, the time spent per chunk and per plugin as json.
+//
+//   zzub-bench [options] song.ccm ...
+//   zzub-bench [options] --graph chain:16 --graph fanin:16 --graph fanout:16
+//
+//   --plugins DIR       plugin folder, may be repeated
+//   --seconds N         seconds of audio to render per run (10)
+//   --rate N            sample rate (44100)
+//   --buffer N          samples per work_stereo() call (256)
+//   --threads N         render with the parallel scheduler on N threads (serial)
+//   --block N           largest chunk the mixer processes at once, 0 follows --buffer (256)
+//   --graph SHAPE:N     render a generated graph instead of a song, SHAPE is one of
+//                       chain (a generator into N effects in series), fanin (N generators
+//                       into one effect) or fanout (a generator into N parallel effects)
+//   --generator URI     generator used by --graph (@libneil/mda/generator/dx10)
+//   --effect URI        effect used by --graph (@libneil/arguru/effect/distortion)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "libzzub/common.h"
+#include "zzub/zzub.h"
+
+using namespace zzub;
+
+namespace {
+
+struct options {
+    std::vector<std::string> plugin_paths;
+    std::vector<std::string> songs;
+    std::vector<std::string> graphs;
+    double seconds;
+    int rate;
+    int buffer;
+    int threads;
+    int block;
+    std::string generator;
+    std::string effect;
+
+    options() : seconds(10), rate(44100), buffer(256), threads(0), block(256),
+        generator("@libneil/mda/generator/dx10"), effect("@libneil/arguru/effect/distortion") { }
+};
+
+// runs of the same settings are compared against each other, so every run gets a fresh player
+struct bench_player {
+    zzub_player_t* player;
+    zzub_audiodriver_t* driver;
+
+    bench_player(const options& opts) {
+        player = zzub_player_create();
+        for (size_t i = 0; i < opts.plugin_paths.size(); i++)
+            zzub_player_add_plugin_path(player, opts.plugin_paths[i].c_str());
+        driver = 0;
+        if (zzub_player_initialize(player, opts.rate) != 0) return;
+        zzub_player_set_block_size(player, opts.block);
+
+        int rates[] = { opts.rate };
+        driver = zzub_audiodriver_create_silent(player, "bench", 2, 0, rates, 1);
+        zzub_audiodriver_set_samplerate(driver, opts.rate);
+        zzub_audiodriver_set_buffersize(driver, opts.buffer);
+        zzub_audiodriver_create_device(driver, -1, 0);
+        zzub_audiodriver_enable(driver, 1);
+        if (opts.threads > 0)
+            zzub_player_set_work_mode(player, zzub_work_mode_parallel, opts.threads);
+    }
+
+    ~bench_player() {
+        if (driver) {
+            zzub_audiodriver_enable(driver, 0);
+            zzub_audiodriver_destroy(driver);
+        }
+        if (player)
+            zzub_player_destroy(player);
+    }
+};
+
+// generators in a generated graph only make sound when they are given notes
+struct note_source {
+    int id;
+    int group, column;
+};
+
+bool create_graph(zzub_player_t* player, const options& opts, const std::string& graph, std::vector<note_source>& notes) {
+    size_t colon = graph.find(':');
+    std::string shape = graph.substr(0, colon);
+    int count = colon != std::string::npos ? atoi(graph.c_str() + colon + 1) : 0;
+    if (count <= 0 || (shape != "chain" && shape != "fanin" && shape != "fanout")) {
+        fprintf(stderr, "zzub-bench: bad graph %s\n", graph.c_str());
+        return false;
+    }
+
+    zzub_pluginloader_t* generator = zzub_player_get_pluginloader_by_name(player, opts.generator.c_str());
+    zzub_pluginloader_t* effect = zzub_player_get_pluginloader_by_name(player, opts.effect.c_str());
+    if (!generator || !effect) {
+        fprintf(stderr, "zzub-bench: %s not found\n", !generator ? opts.generator.c_str() : opts.effect.c_str());
+        return false;
+    }
+
+    zzub_player_begin_song_build(player);
+    zzub_plugin_t* master = zzub_player_get_plugin_by_id(player, 0);
+    std::vector<zzub_plugin_t*> generators;
+    int generator_count = shape == "fanin" ? count : 1;
+    for (int i = 0; i < generator_count; i++) {
+        std::string name = "gen" + std::to_string(i);
+        generators.push_back(zzub_player_create_plugin(player, 0, 0, name.c_str(), generator, 0));
+    }
+
+    if (shape == "chain") {
+        zzub_plugin_t* from = generators[0];
+        for (int i = 0; i < count; i++) {
+            std::string name = "fx" + std::to_string(i);
+            zzub_plugin_t* fx = zzub_player_create_plugin(player, 0, 0, name.c_str(), effect, 0);
+            zzub_plugin_add_input(fx, from, zzub_connection_type_audio);
+            from = fx;
+        }
+        zzub_plugin_add_input(master, from, zzub_connection_type_audio);
+    } else if (shape == "fanin") {
+        zzub_plugin_t* fx = zzub_player_create_plugin(player, 0, 0, "fx0", effect, 0);
+        for (int i = 0; i < count; i++)
+            zzub_plugin_add_input(fx, generators[i], zzub_connection_type_audio);
+        zzub_plugin_add_input(master, fx, zzub_connection_type_audio);
+    } else {
+        for (int i = 0; i < count; i++) {
+            std::string name = "fx" + std::to_string(i);
+            zzub_plugin_t* fx = zzub_player_create_plugin(player, 0, 0, name.c_str(), effect, 0);
+            zzub_plugin_add_input(fx, generators[0], zzub_connection_type_audio);
+            zzub_plugin_add_input(master, fx, zzub_connection_type_audio);
+        }
+    }
+    zzub_player_end_song_build(player);
+
+    for (size_t i = 0; i < generators.size(); i++) {
+        metaplugin& m = *player->front.plugins[zzub_plugin_get_id(generators[i])];
+        if (m.note_column == -1) continue;
+        note_source n = { zzub_plugin_get_id(generators[i]), m.note_group, m.note_column };
+        notes.push_back(n);
+    }
+    return true;
+}
+
+void trigger_notes(zzub_player_t* player, const std::vector<note_source>& notes) {
+    for (size_t i = 0; i < notes.size(); i++) {
+        zzub_plugin_t* plugin = player->front.plugins[notes[i].id]->proxy;
+        zzub_plugin_set_parameter_value_direct(plugin, notes[i].group, 0, notes[i].column, zzub_note_value_c4, 0);
+    }
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+    return sorted[index];
+}
+
+std::string json_string(const std::string& s) {
+    std::string result = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            result += escaped;
+        } else
+            result += c;
+    }
+    return result + "\"";
+}
+
+// renders one song or graph and prints its result object. returns false if it could not be set up.
+bool run(const options& opts, const std::string& song, const std::string& graph, bool first) {
+    bench_player b(opts);
+    if (!b.driver) {
+        fprintf(stderr, "zzub-bench: could not initialize the player\n");
+        return false;
+    }
+    zzub_player_t* player = b.player;
+
+    std::vector<note_source> notes;
+    if (!graph.empty()) {
+        if (!create_graph(player, opts, graph, notes)) return false;
+    } else if (zzub_player_load_ccm(player, song.c_str()) != 0) {
+        fprintf(stderr, "zzub-bench: could not load %s\n", song.c_str());
+        return false;
+    }
+
+    // loop the song so every run renders the same amount of audio
+    zzub_player_set_loop_enabled(player, 1);
+    zzub_player_set_state(player, zzub_player_state_playing);
+
+    // the first buffers pay for allocations and plugin initialization, they are not counted
+    int warmup_chunks = opts.rate / 2 / opts.buffer + 1;
+    trigger_notes(player, notes);
+    for (int i = 0; i < warmup_chunks; i++) {
+        int samples = opts.buffer;
+        zzub_player_work_stereo(player, &samples);
+    }
+    for (size_t i = 0; i < player->front.plugins.size(); i++)
+        if (player->front.plugins[i]) player->front.plugins[i]->total_work_time = 0;
+
+    typedef std::chrono::steady_clock clock;
+    long long total_samples = (long long)(opts.seconds * opts.rate);
+    int chunk_count = (int)((total_samples + opts.buffer - 1) / opts.buffer);
+    int notes_interval = std::max(1, opts.rate / opts.buffer);
+    std::vector<double> chunk_times(chunk_count);
+
+    clock::time_point start = clock::now();
+    for (int i = 0; i < chunk_count; i++) {
+        if (i % notes_interval == 0) trigger_notes(player, notes);
+        int samples = opts.buffer;
+        clock::time_point chunk_start = clock::now();
+        zzub_player_work_stereo(player, &samples);
+        chunk_times[i] = std::chrono::duration<double>(clock::now() - chunk_start).count();
+    }
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+    std::vector<double> sorted = chunk_times;
+    std::sort(sorted.begin(), sorted.end());
+    double rendered = double(chunk_count) * opts.buffer / opts.rate;
+    double deadline = double(opts.buffer) / opts.rate;
+    int overruns = (int)(sorted.end() - std::upper_bound(sorted.begin(), sorted.end(), deadline));
+
+    printf("%s\n  {\n", first ? "" : ",");
+    printf("    \"name\": %s,\n", json_string(graph.empty() ? song : graph).c_str());
+    printf("    \"seconds\": %.3f,\n", rendered);
+    printf("    \"elapsed\": %.6f,\n", elapsed);
+    printf("    \"realtime_factor\": %.3f,\n", elapsed > 0 ? rendered / elapsed : 0);
+    printf("    \"chunks\": %d,\n", chunk_count);
+    printf("    \"overruns\": %d,\n", overruns);
+    printf("    \"buffer_working_set\": %d,\n", zzub_player_get_buffer_working_set(player));
+    printf("    \"chunk_us\": { \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"p999\": %.2f, \"max\": %.2f, \"deadline\": %.2f },\n",
+        percentile(sorted, 0.5) * 1e6, percentile(sorted, 0.9) * 1e6, percentile(sorted, 0.99) * 1e6,
+        percentile(sorted, 0.999) * 1e6, sorted.empty() ? 0 : sorted.back() * 1e6, deadline * 1e6);
+    printf("    \"plugins\": [");
+
+    int plugin_count = zzub_player_get_plugin_count(player);
+    for (int i = 0; i < plugin_count; i++) {
+        zzub_plugin_t* plugin = zzub_player_get_plugin(player, i);
+        metaplugin& m = *player->front.plugins[zzub_plugin_get_id(plugin)];
+        char name[256];
+        zzub_plugin_get_name(plugin, name, sizeof(name));
+        printf("%s\n      { \"name\": %s, \"uri\": %s, \"seconds\": %.6f, \"share\": %.4f }", i ? "," : "",
+            json_string(name).c_str(), json_string(m.info->uri).c_str(), m.total_work_time,
+            elapsed > 0 ? m.total_work_time / elapsed : 0);
+    }
+    printf("\n    ]\n  }");
+    return true;
+}
+
+void usage() {
+    fprintf(stderr, "usage: zzub-bench [--plugins DIR] [--seconds N] [--rate N] [--buffer N] [--threads N]\n"
+        "                  [--block N] [--generator URI] [--effect URI] [--graph chain|fanin|fanout:N] [song.ccm ...]\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+    options opts;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--plugins" && has_value)
+            opts.plugin_paths.push_back(argv[++i]);
+        else if (arg == "--seconds" && has_value)
+            opts.seconds = atof(argv[++i]);
+        else if (arg == "--rate" && has_value)
+            opts.rate = atoi(argv[++i]);
+        else if (arg == "--buffer" && has_value)
+            opts.buffer = atoi(argv[++i]);
+        else if (arg == "--threads" && has_value)
+            opts.threads = atoi(argv[++i]);
+        else if (arg == "--block" && has_value)
+            opts.block = atoi(argv[++i]);
+        else if (arg == "--graph" && has_value)
+            opts.graphs.push_back(argv[++i]);
+        else if (arg == "--generator" && has_value)
+            opts.generator = argv[++i];
+        else if (arg == "--effect" && has_value)
+            opts.effect = argv[++i];
+        else if (arg.compare(0, 2, "--") == 0) {
+            usage();
+            return 1;
+        } else
+            opts.songs.push_back(arg);
+    }
+
+    if ((opts.songs.empty() && opts.graphs.empty()) || opts.seconds <= 0 || opts.rate <= 0
+        || opts.buffer <= 0 || opts.buffer > audiodriver::MAX_FRAMESIZE
+        || opts.block < 0 || opts.block > zzub::max_block_size) {
+        usage();
+        return 1;
+    }
+
+    printf("{\n\"rate\": %d,\n\"buffer\": %d,\n\"block\": %d,\n\"threads\": %d,\n\"runs\": [",
+        opts.rate, opts.buffer, opts.block != 0 ? opts.block : opts.buffer, opts.threads);
+    bool ok = true;
+    bool first = true;
+    for (size_t i = 0; i < opts.songs.size(); i++)
+        if (run(opts, opts.songs[i], "", first)) first = false; else ok = false;
+    for (size_t i = 0; i < opts.graphs.size(); i++)
+        if (run(opts, "", opts.graphs[i], first)) first = false; else ok = false;
+    printf("\n]\n}\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "libzzub/buffer_arena.h"
+
+namespace zzub {
+
+/*! \struct buffer_arena
+    \brief Aligned stereo buffers for the plugin outputs and the mixing scratch.
+*/
+
+namespace {
+
+// a block plus the margin of three buffer_size the buffers always had, in whole cache lines
+int channel_size_for(int block_size) {
+    int size = block_size + zzub::buffer_size * 3;
+    int line = buffer_arena::alignment / sizeof(float);
+    return (size + line - 1) / line * line;
+}
+
+}
+
+buffer_arena::buffer_arena() {
+    channel_size = channel_size_for(zzub::buffer_size);
+}
+
+buffer_arena::~buffer_arena() {
+    for (size_t i = 0; i < blocks.size(); i++)
+        free(blocks[i]);
+}
+
+void buffer_arena::set_block_size(int block_size) {
+    int size = channel_size_for(block_size);
+    if (size == channel_size) return;
+
+    int count = (int)slots.size();
+    for (size_t i = 0; i < blocks.size(); i++)
+        free(blocks[i]);
+    blocks.clear();
+    slots.clear();
+
+    channel_size = size;
+    reserve(count);
+}
+
+void buffer_arena::reserve(int count) {
+    int added = count - (int)slots.size();
+    if (added <= 0) return;
+
+    // the new slots are allocated in one block, so the slots of one reservation are adjacent
+    size_t slot_bytes = get_slot_size();
+    void* block = 0;
+    if (posix_memalign(&block, alignment, added * slot_bytes) != 0)
+        throw std::bad_alloc();
+    memset(block, 0, added * slot_bytes);
+
+    blocks.push_back((float*)block);
+    for (int i = 0; i < added; i++)
+        slots.push_back((float*)block + i * 2 * channel_size);
+}
+
+}
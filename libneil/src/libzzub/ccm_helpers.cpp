@@ -2,7 +2,12 @@
 
 #include "libzzub/ccm_helpers.h"
 #include <FLAC/all.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "libzzub/wavetable.h"
+#include "libzzub/wave_peaks.h"
 
 
 #if defined(_MAX_PATH)
@@ -340,18 +345,11 @@ bool encodeFLAC(zzub::outstream* writer, zzub::wave_info_ex& info, int level) {
 
 // Flac decoder
 
-struct DecodedFrame {
-    void* buffer;
-    size_t bytes;
-};
-
 struct DecoderInfo {
-    DecoderInfo() {
+    DecoderInfo(decoded_wave& r) : result(r) {
         reader=0;
-        totalSamples=0;
     }
-    std::vector<DecodedFrame> buffers;
-    size_t totalSamples;
+    decoded_wave& result;
     zzub::instream* reader;
 
 };
@@ -365,6 +363,8 @@ static FLAC__StreamDecoderReadStatus flac_stream_decoder_read_callback(const FLA
 
     if (info->reader->position() >= info->reader->size()-1) return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
 
+    size_t remaining = info->reader->size() - info->reader->position();
+    if (*bytes > remaining) *bytes = remaining;
     unsigned int bytesRead = info->reader->read(buffer, *bytes);
     if (bytesRead != *bytes) {
         *bytes = bytesRead;
@@ -374,6 +374,7 @@ static FLAC__StreamDecoderReadStatus flac_stream_decoder_read_callback(const FLA
 
 FLAC__StreamDecoderWriteStatus flac_stream_decoder_write_callback(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 *const buffer[], void *client_data) {
     DecoderInfo* info=(DecoderInfo*)client_data;
+    decoded_wave& result = info->result;
     
     // An array of pointers to decoded channels of data. Each pointer will point to an array of signed samples of length frame->header.blocksize. Currently, the channel order has no meaning except for stereo streams; in this case channel 0 is left and 1 is right.
     size_t numSamples=frame->header.blocksize;
@@ -381,9 +382,12 @@ FLAC__StreamDecoderWriteStatus flac_stream_decoder_write_callback(const FLAC__St
     int bytesPerSample=(frame->header.bits_per_sample / 8);
     size_t bufferSize=bytesPerSample*numSamples*channels;
 
-    void* vp;
-    char* cp=new char[bufferSize];
-    vp=cp;
+    result.channels = (int)channels;
+    result.bits_per_sample = frame->header.bits_per_sample;
+
+    size_t offset = result.samples.size();
+    result.samples.resize(offset + bufferSize);
+    char* cp = &result.samples[offset];
 
     for (size_t i=0; i<numSamples; i++) {
         memcpy(cp, &buffer[0][i], bytesPerSample);
@@ -394,11 +398,7 @@ FLAC__StreamDecoderWriteStatus flac_stream_decoder_write_callback(const FLAC__St
         }
     }
 
-    DecodedFrame df;
-    df.bytes=bufferSize;
-    df.buffer=vp;
-    info->buffers.push_back(df);
-    info->totalSamples+=numSamples;
+    result.sample_count+=(int)numSamples;
 
     return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
     // FLAC__STREAM_DECODER_WRITE_STATUS_ABORT
@@ -412,10 +412,10 @@ void flac_stream_decoder_error_callback(const FLAC__StreamDecoder *decoder, FLAC
     //MessageBox(0, "we got error", "", MB_OK);
 }
 
-void decodeFLAC(zzub::instream* reader, zzub::player& player, int wave, int level) {
+void decodeFLAC(zzub::instream* reader, decoded_wave& result) {
     FLAC__StreamDecoder* decoder = FLAC__stream_decoder_new();
     FLAC__stream_decoder_set_metadata_ignore_all(decoder);
-    DecoderInfo decoder_info;
+    DecoderInfo decoder_info(result);
     decoder_info.reader = reader;
     FLAC__stream_decoder_init_stream(decoder,
                                      flac_stream_decoder_read_callback,
@@ -428,13 +428,20 @@ void decodeFLAC(zzub::instream* reader, zzub::player& player, int wave, int leve
                                      flac_stream_decoder_error_callback,
                                      &decoder_info);
     FLAC__stream_decoder_process_until_end_of_stream(decoder);
+    if (result.channels == 0) {
+        // no frames, use the stats retreived from the decoder stream
+        result.channels = FLAC__stream_decoder_get_channels(decoder);
+        result.bits_per_sample = FLAC__stream_decoder_get_bits_per_sample(decoder);
+    }
     FLAC__stream_decoder_finish(decoder);
-    int channels = FLAC__stream_decoder_get_channels(decoder);
-    unsigned int bps = FLAC__stream_decoder_get_bits_per_sample(decoder);
-    //unsigned int sample_rate = FLAC__stream_decoder_get_sample_rate(decoder);
+    // clean up
+    FLAC__stream_decoder_delete(decoder);
+}
+
+void storeDecodedWave(const decoded_wave& data, zzub::player& player, int wave, int level) {
     // allocate a level based on the stats retreived from the decoder stream
     zzub::wave_buffer_type waveFormat;
-    switch (bps) {
+    switch (data.bits_per_sample) {
     case 16:
         waveFormat = wave_buffer_type_si16;
         break;
@@ -447,21 +454,235 @@ void decodeFLAC(zzub::instream* reader, zzub::player& player, int wave, int leve
     default:
         throw "not a supported bitsize";
     }
-    player.wave_allocate_level(wave, level, decoder_info.totalSamples, channels, waveFormat);
+    player.wave_allocate_level(wave, level, data.sample_count, data.channels, waveFormat);
     //bool result = info.allocate_level(level, decoder_info.totalSamples, waveFormat, channels==2);
     //assert(result); // lr: you don't want to let this one go unnoticed. either bail out or give visual cues.
     wave_info_ex& w = *player.back.wavetable.waves[wave];
     wave_level_ex& l = w.levels[level];
-    char* targetBuf = (char*)l.samples;
-    for (size_t i = 0; i < decoder_info.buffers.size(); i++) {
-        DecodedFrame frame = decoder_info.buffers[i];
-        memcpy(targetBuf, frame.buffer, frame.bytes);
-        targetBuf += frame.bytes;
-        delete[] (char*)frame.buffer; // discard buffer
+    if (!data.samples.empty())
+        memcpy(l.samples, &data.samples[0], data.samples.size());
+}
+
+void decodeFLAC(zzub::instream* reader, zzub::player& player, int wave, int level) {
+    decoded_wave data;
+    decodeFLAC(reader, data);
+    storeDecodedWave(data, player, wave, level);
+}
+
+void run_parallel(int count, const std::function<void(int)>& job, const std::function<void(int, int)>& progress) {
+    if (count <= 0) return;
+    int thread_count = std::min(count, std::max(1, (int)std::thread::hardware_concurrency()));
+
+    std::atomic<int> next(0);
+    int done = 0;
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; t++) {
+        threads.push_back(std::thread([&] {
+            for (int i = next++; i < count; i = next++) {
+                job(i);
+                std::lock_guard<std::mutex> lock(mutex);
+                done++;
+                finished.notify_one();
+            }
+        }));
     }
-    // clean up
-    FLAC__stream_decoder_delete(decoder);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (int reported = 0; reported < count; ) {
+        finished.wait(lock, [&] { return done != reported; });
+        reported = done;
+        if (progress) {
+            lock.unlock();
+            progress(reported, count);
+            lock.lock();
+        }
+    }
+    lock.unlock();
+
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
 }
 
 
+
+// the first level of a complete wave_peaks summary, stored next to the flac so the wave
+// editor can draw large waves right after loading. the header is checked against the
+// decoded level, and a summary that doesn't fit is skipped and rebuilt on demand.
+static const char peaks_magic[4] = { 'z', 'z', 'p', 'k' };
+static const int peaks_version = 1;
+
+bool encodePeaks(zzub::outstream* writer, const zzub::wave_peaks& peaks) {
+    if (peaks.levels.empty() || peaks.valid_samples != peaks.sample_count) return false;
+    const std::vector<wave_peaks::entry>& entries = peaks.levels[0];
+    int header[5] = { peaks_version, wave_peaks::block_size, peaks.channels, peaks.sample_count, (int)entries.size() };
+    writer->write((void*)peaks_magic, sizeof(peaks_magic));
+    writer->write(header, sizeof(header));
+    writer->write((void*)&entries[0], (int)(entries.size() * sizeof(wave_peaks::entry)));
+    return true;
+}
+
+bool decodePeaks(zzub::instream* reader, zzub::wave_info_ex& info, zzub::wave_level_ex& level) {
+    char magic[4];
+    int header[5];
+    if (reader->read(magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, peaks_magic, sizeof(magic)) != 0) return false;
+    if (reader->read(header, sizeof(header)) != sizeof(header)) return false;
+
+    int channels = info.get_stereo() ? 2 : 1;
+    int blocks = (level.sample_count + wave_peaks::block_size - 1) / wave_peaks::block_size;
+    if (header[0] != peaks_version || header[1] != wave_peaks::block_size || header[2] != channels ||
+        header[3] != level.sample_count || header[4] != blocks * channels || blocks == 0)
+        return false;
+
+    std::shared_ptr<wave_peaks> peaks = std::make_shared<wave_peaks>();
+    peaks->samples = level.samples;
+    peaks->sample_count = level.sample_count;
+    peaks->format = level.format;
+    peaks->channels = channels;
+    peaks->levels.resize(1);
+    peaks->levels[0].resize(header[4]);
+    int bytes = header[4] * (int)sizeof(wave_peaks::entry);
+    if (reader->read(&peaks->levels[0][0], bytes) != bytes) return false;
+    peaks->merge_levels(0);
+    peaks->valid_samples = level.sample_count;
+    level.peaks = peaks;
+    return true;
+}
+
+
+// binary pattern chunks, used instead of <e> elements for patterns saved since ccm 0.2.
+// columns are stored one after the other as (group, track, column) indices followed by
+// runs of non-empty rows. a run is the number of empty rows before it, its length and the
+// values as differences to the previous value of the column. all numbers are varints, the
+// differences zigzag coded, so steady automation and repeated values take a byte per row.
+static const char pattern_magic[4] = { 'z', 'z', 'p', 't' };
+static const int pattern_version = 1;
+
+static void write_varint(std::vector<char>& buffer, unsigned int v) {
+    while (v >= 0x80) {
+        buffer.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    buffer.push_back((char)v);
+}
+
+static bool read_varint(const std::vector<char>& buffer, size_t& pos, unsigned int& v) {
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (pos >= buffer.size()) return false;
+        unsigned char c = (unsigned char)buffer[pos++];
+        v |= (unsigned int)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+static unsigned int zigzag(int v) {
+    return ((unsigned int)v << 1) ^ (unsigned int)(v >> 31);
+}
+
+static int unzigzag(unsigned int v) {
+    return (int)(v >> 1) ^ -(int)(v & 1);
+}
+
+bool encodePattern(zzub::outstream* writer, zzub::song& song, int plugin, const zzub::pattern& p, int tpb) {
+    std::vector<char> columns;
+    int column_count = 0;
+
+    for (int group = 0; group < 3; group++) {
+        for (int track = 0; track < p.get_track_count(group); track++) {
+            for (int column = 0; column < p.get_column_count(group, track); column++) {
+                const zzub::parameter* param = song.plugin_get_parameter_info(plugin, group, track, column);
+                assert(param != 0);
+
+                std::vector<char> runs;
+                int run_count = 0;
+                int last_value = 0;
+                int last_row = 0;
+                for (int row = 0; row < p.rows; ) {
+                    if (p.value(group, track, column, row) == param->value_none) {
+                        row++;
+                        continue;
+                    }
+                    int first = row;
+                    while (row < p.rows && p.value(group, track, column, row) != param->value_none)
+                        row++;
+
+                    write_varint(runs, first - last_row);
+                    write_varint(runs, row - first);
+                    for (int r = first; r < row; r++) {
+                        int value = p.value(group, track, column, r);
+                        write_varint(runs, zigzag(value - last_value));
+                        last_value = value;
+                    }
+                    last_row = row;
+                    run_count++;
+                }
+                if (run_count == 0) continue;
+
+                write_varint(columns, group);
+                write_varint(columns, track);
+                write_varint(columns, column);
+                write_varint(columns, run_count);
+                columns.insert(columns.end(), runs.begin(), runs.end());
+                column_count++;
+            }
+        }
+    }
+
+    int header[4] = { pattern_version, p.rows, tpb, column_count };
+    writer->write((void*)pattern_magic, sizeof(pattern_magic));
+    writer->write(header, sizeof(header));
+    if (!columns.empty())
+        writer->write(&columns[0], (int)columns.size());
+    return true;
+}
+
+// p must be created for the target plugin with the length of the pattern in the current
+// tpb. rows are scaled when the pattern was saved with another tpb, and columns the plugin
+// doesn't have are skipped, like in the xml loader.
+bool decodePattern(zzub::instream* reader, zzub::pattern& p, int tpb) {
+    char magic[4];
+    int header[4];
+    if (reader->read(magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, pattern_magic, sizeof(magic)) != 0) return false;
+    if (reader->read(header, sizeof(header)) != sizeof(header)) return false;
+    if (header[0] != pattern_version || header[1] < 0 || header[2] <= 0) return false;
+
+    std::vector<char> buffer(reader->size() - reader->position());
+    if (!buffer.empty() && reader->read(&buffer[0], (int)buffer.size()) != (int)buffer.size()) return false;
+
+    double rowfac = double(tpb) / double(header[2]);
+    size_t pos = 0;
+    for (int i = 0; i < header[3]; i++) {
+        unsigned int group, track, column, run_count;
+        if (!read_varint(buffer, pos, group) || !read_varint(buffer, pos, track) || !read_varint(buffer, pos, column) || !read_varint(buffer, pos, run_count))
+            return false;
+        bool valid = group < 3 && (int)track < p.get_track_count(group) && (int)column < p.get_column_count(group, track);
+
+        int value = 0;
+        int row = 0;
+        for (unsigned int j = 0; j < run_count; j++) {
+            unsigned int skip, length;
+            if (!read_varint(buffer, pos, skip) || !read_varint(buffer, pos, length))
+                return false;
+            // runs never reach past the saved rows, corrupt input must not overflow row
+            if (skip > (unsigned int)(header[1] - row)) return false;
+            row += skip;
+            if (length > (unsigned int)(header[1] - row)) return false;
+            for (unsigned int k = 0; k < length; k++, row++) {
+                unsigned int delta;
+                if (!read_varint(buffer, pos, delta))
+                    return false;
+                value += unzigzag(delta);
+                int target_row = int(double(row) * rowfac + 0.5);
+                if (valid && target_row >= 0 && target_row < p.rows)
+                    p.value(group, track, column, target_row) = value;
+            }
+        }
+    }
+    return true;
+}
+
 }
\ No newline at end of file
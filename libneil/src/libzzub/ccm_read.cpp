@@ -57,7 +57,7 @@ bool CcmReader::loadClasses(xml_node &classes, zzub::player &player) {
                     std::cout << "ccm: searching for loader for " << uri << std::endl;
                     std::vector<pluginlib*>::iterator lib;
                     for (lib = player.plugin_libraries.begin(); lib != player.plugin_libraries.end(); ++lib) {
-                        if ((*lib)->collection) {
+                        if ((*lib)->ensure_loaded()) {
                             const zzub::info *_info = (*lib)->collection->get_info(uri.c_str(), &arc);
                             if (_info) { // library could read archive
                                 (*lib)->register_info(_info); // register the new info
@@ -405,6 +405,20 @@ bool CcmReader::loadPlugins(xml_node plugins, zzub::player &player) {
                     pattern p;
                     player.back.create_pattern(p, target_id, rows);
                     p.name = i->attribute("name").value();
+
+                    // binary values since ccm 0.2 are filled in before the pattern is added,
+                    // the <e> elements of older songs are set one by one below
+                    if (!i->attribute("src").empty()) {
+                        compressed_file_info cfi;
+                        if (!arch.openFileInArchive(i->attribute("src").value(), &cfi)) {
+                            std::cerr << "ccm: unable to open " << i->attribute("src").value() << std::endl;
+                        } else {
+                            if (!decodePattern(&arch, p, (int)tpbfac))
+                                std::cerr << "ccm: invalid pattern data in " << i->attribute("src").value() << std::endl;
+                            arch.closeFileInArchve();
+                        }
+                    }
+
                     player.plugin_add_pattern(target_id, p);
                     int pattern_index = player.back.plugins[target_id]->patterns.size() - 1;
                     i->append_attribute("index") = pattern_index;  // set an index attribute
@@ -576,6 +590,47 @@ bool CcmReader::loadInstruments(xml_node &instruments, zzub::player &player) {
     // load wave table
     // load instruments
 
+    // read the compressed levels from the archive first and decode them in parallel, the
+    // loop below then copies them into the song in the same order they were read.
+    struct wave_job {
+        int number;					// of the wave node among all wave nodes
+        std::vector<char> data;
+        decoded_wave wave;
+    };
+    std::vector<wave_job> jobs;
+    int wave_number = 0;
+
+    for (xml_node::iterator i = instruments.begin(); i != instruments.end(); ++i) {
+        if (!strcmp(i->name(), "instrument")) {
+            xml_node waves = i->child("waves");
+            if (!waves.empty()) {
+                for (xml_node::iterator w = waves.begin(); w != waves.end(); ++w) {
+                    if (strcmp(w->name(), "wave")) continue;
+                    compressed_file_info cfi;
+                    if (arch.openFileInArchive(w->attribute("src").value(), &cfi)) {
+                        jobs.push_back(wave_job());
+                        wave_job& job = jobs.back();
+                        job.number = wave_number;
+                        job.data.resize(cfi.uncompressed_size);
+                        if (!job.data.empty())
+                            job.data.resize(arch.read(&job.data[0], (int)job.data.size()));
+                        arch.closeFileInArchve();
+                    }
+                    wave_number++;
+                }
+            }
+        }
+    }
+
+    run_parallel((int)jobs.size(), [&jobs](int i) {
+        mem_instream reader(jobs[i].data);
+        decodeFLAC(&reader, jobs[i].wave);
+        std::vector<char>().swap(jobs[i].data);
+    }, player.ccm_progress);
+
+    size_t next_job = 0;
+    wave_number = 0;
+
     for (xml_node::iterator i = instruments.begin(); i != instruments.end(); ++i) {
         if (!strcmp(i->name(), "instrument")) {
             int wave_index = long(i->attribute("index").as_int());
@@ -588,10 +643,12 @@ bool CcmReader::loadInstruments(xml_node &instruments, zzub::player &player) {
             if (!waves.empty()) {
                 for (xml_node::iterator w = waves.begin(); w != waves.end(); ++w) {
                     if (!strcmp(w->name(), "wave")) {
-                        if (arch.openFileInArchive(w->attribute("src").value())) {
+                        int number = wave_number++;
+                        if (next_job < jobs.size() && jobs[next_job].number == number) {
                             long index = long(w->attribute("index").as_int());
-                            decodeFLAC(&arch, player, wave_index, index);
-                            arch.closeFileInArchve();
+                            storeDecodedWave(jobs[next_job].wave, player, wave_index, index);
+                            std::vector<char>().swap(jobs[next_job].wave.samples);
+                            next_job++;
                             wave_info_ex &info = *player.back.wavetable.waves[wave_index];
                             wave_level_ex &level = info.levels[index];
 
@@ -620,6 +677,13 @@ bool CcmReader::loadInstruments(xml_node &instruments, zzub::player &player) {
                                     }
                                 }
                             }
+
+                            // optional, older songs and unfinished summaries have none
+                            if (!w->attribute("peaks").empty() && arch.openFileInArchive(w->attribute("peaks").value())) {
+                                wave_info_ex &pinfo = *player.back.wavetable.waves[wave_index];
+                                decodePeaks(&arch, pinfo, pinfo.levels[index]);
+                                arch.closeFileInArchve();
+                            }
                         }
                     }
                 }
@@ -681,14 +745,17 @@ bool CcmReader::loadInstruments(xml_node &instruments, zzub::player &player) {
 }
 
 bool CcmReader::loadSequencer(xml_node &item, zzub::player &player) {
-    double tpbfac = double(player.front.plugin_get_parameter(0, 1, 0, 2));
+    // open() loads in song build mode: the master parameters were set on the backbuffer,
+    // and the backbuffer song variables replace the front ones in end_song_build()
+    zzub::song& song = player.back;
+    double tpbfac = double(song.plugin_get_parameter(0, 1, 0, 2));
 
     //sequencer &seq = player.song_sequencer;
     player.front.seqstep = int(item.attribute("seqstep").as_int());
-    player.front.song_loop_begin = int(double(item.attribute("loopstart").as_double()) * tpbfac + 0.5);
-    player.front.song_loop_end = int(double(item.attribute("loopend").as_double()) * tpbfac + 0.5);
-    player.front.song_begin = int(double(item.attribute("start").as_double()) * tpbfac + 0.5);
-    player.front.song_end = int(double(item.attribute("end").as_double()) * tpbfac + 0.5);
+    song.song_loop_begin = int(double(item.attribute("loopstart").as_double()) * tpbfac + 0.5);
+    song.song_loop_end = int(double(item.attribute("loopend").as_double()) * tpbfac + 0.5);
+    song.song_begin = int(double(item.attribute("start").as_double()) * tpbfac + 0.5);
+    song.song_end = int(double(item.attribute("end").as_double()) * tpbfac + 0.5);
     return true;
 }
 
@@ -698,6 +765,7 @@ bool CcmReader::open(std::string fileName, zzub::player* player) {
 
     bool result = false;
     player->set_state(player_state_muted);
+    player->begin_song_build();
 
     if (arch.open(fileName)) {
         compressed_file_info cfi;
@@ -774,7 +842,7 @@ bool CcmReader::open(std::string fileName, zzub::player* player) {
     }
 
     player->set_state(player_state_stopped);
-    player->flush_operations(0, 0, 0);
+    player->end_song_build();
     player->flush_from_history();	// TODO: ccm loading doesnt support undo yet
     
 
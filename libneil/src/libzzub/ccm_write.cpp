@@ -1,6 +1,7 @@
 #include "libzzub/ccm_write.h"
 #include "libzzub/ccm_helpers.h"
 #include "libzzub/connections.h"
+#include "libzzub/wave_peaks.h"
 
 
 namespace zzub {
@@ -12,18 +13,9 @@ xml_node CcmWriter::saveHead(xml_node& parent, zzub::song& player)
 {
     if (strlen(player.song_comment.c_str())) {
         // save song info
-        if (arch.createFileInArchive("readme.txt")) {
-            arch.write(
-                (void*)player.song_comment.c_str(),
-                (int)strlen(player.song_comment.c_str())
-            );
-
-            arch.closeFileInArchive();
-            xml_node commentmeta = addMeta(parent, "comment");
-            commentmeta.append_attribute("src") = "readme.txt";
-        } else {
-            std::cerr << "unable to save comment in readme.txt" << std::endl;
-        }
+        addEntry("readme.txt", player.song_comment.c_str(), (int)strlen(player.song_comment.c_str()));
+        xml_node commentmeta = addMeta(parent, "comment");
+        commentmeta.append_attribute("src") = "readme.txt";
     }
     return parent;
 }
@@ -231,9 +223,7 @@ xml_node CcmWriter::saveArchive(xml_node& parent, const std::string& pathbase, z
             } else {
                 filename = pathbase + "/" + i->first;
             }
-            arch.createFileInArchive(filename);
-            arch.write(&i->second[0], i->second.size());
-            arch.closeFileInArchive();
+            addEntry(filename, &i->second[0], (int)i->second.size());
             data.append_attribute("src") = filename.c_str();
         }
     }
@@ -315,11 +305,11 @@ xml_node CcmWriter::savePatternTrack(xml_node& parent, const std::string& colnam
 
     // zzub::patterntrack& t = *p.getPatternTrack(group, track);
     for (int i = 0; i < p.rows; ++i) {
-        for (size_t j = 0; j < p.groups[group][track].size(); ++j) {
+        for (int j = 0; j < p.get_column_count(group, track); ++j) {
             const zzub::parameter* param = player.plugin_get_parameter_info(plugin, group, track, j);
             assert(param != 0);
 
-            int value = p.groups[group][track][j][i];
+            int value = p.value(group, track, j, i);
             if (value != param->value_none) {
                 xml_node e = item.append_child(node_element);
                 e.set_name("e");
@@ -376,8 +366,19 @@ xml_node CcmWriter::savePattern(xml_node& parent, zzub::song& player, int plugin
     item.append_attribute("name") = p.name.c_str();
     item.append_attribute("length") = double(p.rows) * tpbfac;
 
+    if (binary_patterns) {
+        // the values go to a separate archive entry, see encodePattern()
+        std::vector<char> data;
+        mem_outstream writer(data);
+        encodePattern(&writer, player, plugin, p, player.plugin_get_parameter(0, 1, 0, 2));
+        std::string filename = id_from_ptr(&p) + ".pattern";
+        addEntry(filename, &data[0], (int)data.size());
+        item.append_attribute("src") = filename.c_str();
+        return item;
+    }
+
     // save connection columns
-    for (size_t j = 0; j < p.groups[0].size(); ++j) {
+    for (int j = 0; j < p.get_track_count(0); ++j) {
         savePatternTrack(item, "c", tpbfac, player, plugin, p, 0, j);
     }
 
@@ -385,7 +386,7 @@ xml_node CcmWriter::savePattern(xml_node& parent, zzub::song& player, int plugin
     savePatternTrack(item, "g", tpbfac, player, plugin, p, 1, 0);
 
     // save tracks
-    for (size_t j = 0; j < p.groups[2].size(); j++) {
+    for (int j = 0; j < p.get_track_count(2); j++) {
         savePatternTrack(item, "t", tpbfac, player, plugin, p, 2, j);
     }
 
@@ -635,6 +636,9 @@ xml_node CcmWriter::saveWave(xml_node& parent, zzub::wave_info_ex& info)
     xml_node waves = item.append_child(node_element);
     waves.set_name("waves");
 
+    // the entries share one copy of the wave, the sample data is not copied
+    std::shared_ptr<wave_info_ex> wave = std::make_shared<wave_info_ex>(info);
+
     for (int j = 0; j < info.get_levels(); j++) {
         if (info.get_sample_count(j)) {
             wave_level_ex& level = info.levels[j];
@@ -681,10 +685,21 @@ xml_node CcmWriter::saveWave(xml_node& parent, zzub::wave_info_ex& info)
             std::string wavename = id_from_ptr(&level) + ".flac";
             levelnode.append_attribute("src") = wavename.c_str();
 
-            arch.createFileInArchive(wavename);
-            // TODO: floats should be saved in a different format
-            encodeFLAC(&arch, info, j);
-            arch.closeFileInArchive();
+            // encoded by write()
+            archive_entry entry;
+            entry.name = wavename;
+            entry.wave = wave;
+            entry.level = j;
+            entries.push_back(entry);
+
+            if (level.peaks && level.peaks->matches(info, level) && level.peaks->valid_samples == level.sample_count) {
+                std::string peaksname = id_from_ptr(&level) + ".peaks";
+                levelnode.append_attribute("peaks") = peaksname.c_str();
+                std::vector<char> peaks;
+                mem_outstream writer(peaks);
+                encodePeaks(&writer, *level.peaks);
+                addEntry(peaksname, &peaks[0], (int)peaks.size());
+            }
         }
     }
 
@@ -710,16 +725,26 @@ xml_node CcmWriter::saveWaves(xml_node& parent, zzub::song& player)
     return item;
 }
 
-bool CcmWriter::save(std::string fileName, zzub::player* player)
+void CcmWriter::addEntry(const std::string& name, const void* data, int size)
 {
+    archive_entry entry;
+    entry.name = name;
+    entry.data.assign((const char*)data, (const char*)data + size);
+    entry.level = -1;
+    entries.push_back(entry);
+}
 
-    if (!arch.create(fileName))
+bool CcmWriter::save(std::string fileName, zzub::player* player)
+{
+    if (!snapshot(player))
         return false;
+    return write(fileName, player->ccm_progress);
+}
 
+bool CcmWriter::snapshot(zzub::player* player)
+{
     const char* loc = setlocale(LC_NUMERIC, "C");
 
-    pugi::xml_document xml;
-
     xml_node xmldesc = xml.append_child(node_pi);
     xmldesc.set_name("xml");
     xmldesc.set_value("version=\"1.0\" encoding=\"utf8\"");
@@ -758,6 +783,39 @@ bool CcmWriter::save(std::string fileName, zzub::player* player)
     // save waves
     saveWaves(xmix, player->front);
 
+    setlocale(LC_NUMERIC, loc);
+
+    return true;
+}
+
+bool CcmWriter::write(std::string fileName, const std::function<void(int, int)>& progress)
+{
+    std::vector<archive_entry*> waves;
+    for (size_t i = 0; i < entries.size(); i++)
+        if (entries[i].wave) waves.push_back(&entries[i]);
+
+    // flac encoding is the slow part of saving sample heavy songs, so all levels are encoded
+    // to memory in parallel. the archive is written in entry order to keep the file stable.
+    run_parallel((int)waves.size(), [&waves](int i) {
+        archive_entry& entry = *waves[i];
+        mem_outstream writer(entry.data);
+        // TODO: floats should be saved in a different format
+        encodeFLAC(&writer, *entry.wave, entry.level);
+    }, progress);
+
+    if (!arch.create(fileName))
+        return false;
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        archive_entry& entry = entries[i];
+        arch.createFileInArchive(entry.name);
+        if (!entry.data.empty())
+            arch.write(&entry.data[0], (int)entry.data.size());
+        arch.closeFileInArchive();
+        std::vector<char>().swap(entry.data);
+    }
+    entries.clear();
+
     std::ostringstream oss("");
     xml.print(oss);
     std::string xmlstr = oss.str();
@@ -767,8 +825,6 @@ bool CcmWriter::save(std::string fileName, zzub::player* player)
 
     arch.close();
 
-    setlocale(LC_NUMERIC, loc);
-
     return true;
 }
 
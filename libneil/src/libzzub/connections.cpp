@@ -99,24 +99,37 @@ audio_connection::work(
     uint sample_count,
     uint work_position
 )
+{
+    return work_range(player, conn, 0, sample_count, work_position);
+}
+
+
+bool 
+audio_connection::work_range(
+    zzub::song& player, 
+    const zzub::connection_descriptor& conn, 
+    uint offset,
+    uint sample_count,
+    uint work_position
+)
 {
 
     metaplugin& plugin_from = player.get_plugin(target(conn, player.graph));
     metaplugin& plugin_to = player.get_plugin(source(conn, player.graph));
 
     float* plout[] = {
-        &plugin_to.work_buffer[0].front(),
-        &plugin_to.work_buffer[1].front()
+        plugin_to.work_buffer[0] + offset,
+        plugin_to.work_buffer[1] + offset
     };
 
     float* plin[2] = { 0, 0 };
 
     if (work_position == plugin_from.last_work_frame) {
-        plin[0] = &plugin_from.work_buffer[0].front();
-        plin[1] = &plugin_from.work_buffer[1].front();
+        plin[0] = plugin_from.work_buffer[0] + offset;
+        plin[1] = plugin_from.work_buffer[1] + offset;
     } else {
-        plin[0] = &plugin_from.callbacks->feedback_buffer[0].front();
-        plin[1] = &plugin_from.callbacks->feedback_buffer[1].front();
+        plin[0] = plugin_from.callbacks->get_feedback(0) + offset;
+        plin[1] = plugin_from.callbacks->get_feedback(1) + offset;
     }
 
     bool plugin_to_does_input_mixing = (plugin_to.info->flags & zzub::plugin_flag_does_input_mixing) != 0;
@@ -136,6 +149,17 @@ audio_connection::work(
     return result;
 }
 
+
+bool 
+audio_connection::has_signals(
+    zzub::song& player, 
+    const zzub::connection_descriptor& conn
+)
+{
+    metaplugin& plugin_from = player.get_plugin(target(conn, player.graph));
+    return zzub::tools::plugin_has_audio(plugin_from, values.amp);
+}
+
 // only used in commented out code in event_connection - replaced by player.get_parameter
 // const zzub::parameter *event_connection::getParam(struct metaplugin *mp, int group, int index)
 // {
@@ -525,6 +549,14 @@ midi_connection::work(zzub::song& player, const zzub::connection_descriptor& con
 }
 
 
+bool 
+midi_connection::has_signals(zzub::song& player, const zzub::connection_descriptor& conn)
+{
+    metaplugin& m = player.get_plugin(target(conn, player.graph));
+    return m.midi_messages.size() != 0;
+}
+
+
 int 
 midi_connection::get_midi_device(zzub::song& player, int plugin_id, std::string name)
 {
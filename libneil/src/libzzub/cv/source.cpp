@@ -53,14 +53,14 @@ void cv_source_mono_audio::initialize(
     zzub::metaplugin& plugin_from
 )
 {
-    src = &plugin_from.callbacks->feedback_buffer[node.value - 1].front();
+    src = plugin_from.callbacks;
 }
 
 void cv_source_mono_audio::work(
     int numsamples
 )
 {
-    data->add(src, numsamples);
+    data->add(src->get_feedback(node.value - 1), numsamples);
 }
 
 
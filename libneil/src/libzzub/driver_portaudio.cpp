@@ -196,6 +196,7 @@ bool audiodriver_portaudio::createDevice(int index, int inIndex) {
     worker->work_in_first_channel = 0;
     worker->work_in_channel_count = inIndex != -1 ? 2 : 0;
     worker->samplerate_changed();
+    worker->buffersize_changed();
     return true;
 }
 
@@ -0,0 +1,174 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libzzub/common.h"
+#include "libzzub/event_queue.h"
+
+namespace zzub {
+
+namespace {
+
+inline size_t hash_parameter(int plugin_id, event_handler* handler, int group, int track, int column) {
+    size_t h = (size_t)plugin_id * 0x9e3779b1u;
+    h ^= ((size_t)handler >> 4) + 0x7f4a7c15u + (h << 6) + (h >> 2);
+    h ^= (size_t)(group << 24 | track << 12 | column) + 0x7f4a7c15u + (h << 6) + (h >> 2);
+    return h;
+}
+
+}
+
+
+event_queue::event_queue(size_t capacity) {
+    init(capacity);
+}
+
+void event_queue::init(size_t requested) {
+    capacity = 4;
+    while (capacity < requested) capacity <<= 1;
+    mask = capacity - 1;
+
+    slots.reset(new slot[capacity]);
+    for (size_t i = 0; i < capacity; i++) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+        slots[i].handler.store(0, std::memory_order_relaxed);
+        slots[i].value.store(0, std::memory_order_relaxed);
+    }
+
+    write_index.store(0, std::memory_order_relaxed);
+    read_index.store(0, std::memory_order_relaxed);
+    dropped.store(0, std::memory_order_relaxed);
+    coalesced.store(0, std::memory_order_relaxed);
+
+    coalesce_entry empty = { 0 };
+    coalesce_table.assign(coalesce_table_size, empty);
+}
+
+// reserves the slot at pos, returns false if the queue is full
+bool event_queue::claim(size_t& pos) {
+    pos = write_index.load(std::memory_order_relaxed);
+    for (;;) {
+        size_t seq = slots[pos & mask].sequence.load(std::memory_order_acquire);
+        if (seq == pos) {
+            if (write_index.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                return true;
+        } else if ((ptrdiff_t)(seq - pos) < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = write_index.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool event_queue::push(const event_message& message) {
+    size_t pos;
+    if (!claim(pos)) return false;
+
+    slot& s = slots[pos & mask];
+    s.message = message;
+    s.handler.store(message.event, std::memory_order_relaxed);
+    s.value.store(message.data.change_parameter.value, std::memory_order_relaxed);
+    s.sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool event_queue::push_parameter_change(const event_message& message) {
+    const zzub_event_data_change_parameter_t& change = message.data.change_parameter;
+    coalesce_entry& entry = coalesce_table[hash_parameter(message.plugin_id, message.event, change.group, change.track, change.param) % coalesce_table_size];
+
+    if (entry.used && entry.plugin_id == message.plugin_id && entry.handler == message.event
+        && entry.group == change.group && entry.track == change.track && entry.column == change.param)
+    {
+        // overwrite the value of the pending event. if the consumer started reading the slot
+        // before our store became visible, it has moved the sequence on and we queue a new event.
+        slot& s = slots[entry.ticket & mask];
+        if (s.sequence.load(std::memory_order_acquire) == entry.ticket + 1) {
+            s.value.store(change.value, std::memory_order_seq_cst);
+            if (s.sequence.load(std::memory_order_seq_cst) == entry.ticket + 1) {
+                coalesced.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+
+    size_t pos;
+    if (!claim(pos)) return false;
+
+    slot& s = slots[pos & mask];
+    s.message = message;
+    s.handler.store(message.event, std::memory_order_relaxed);
+    s.value.store(change.value, std::memory_order_relaxed);
+    s.sequence.store(pos + 1, std::memory_order_release);
+
+    entry.plugin_id = message.plugin_id;
+    entry.handler = message.event;
+    entry.group = change.group;
+    entry.track = change.track;
+    entry.column = change.param;
+    entry.ticket = pos;
+    entry.used = true;
+    return true;
+}
+
+bool event_queue::pop(event_message& message) {
+    size_t pos = read_index.load(std::memory_order_relaxed);
+    slot& s = slots[pos & mask];
+    if (s.sequence.load(std::memory_order_acquire) != pos + 1)
+        return false;
+
+    message = s.message;
+    message.event = s.handler.load(std::memory_order_acquire);
+
+    if (message.data.type == zzub_event_type_parameter_changed) {
+        // closes the slot for push_parameter_change() before the value is read
+        s.sequence.store(pos + 2, std::memory_order_seq_cst);
+        message.data.change_parameter.value = s.value.load(std::memory_order_seq_cst);
+    }
+
+    s.sequence.store(pos + capacity, std::memory_order_release);
+    read_index.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+int event_queue::pop_batch(event_message* messages, int max_count) {
+    int count = 0;
+    while (count < max_count && pop(messages[count]))
+        count++;
+    return count;
+}
+
+// detaches pending events from their handler, the consumer skips events without a handler
+template <typename F>
+void event_queue::clear_if(F match) {
+    size_t end = write_index.load(std::memory_order_acquire);
+    for (size_t pos = read_index.load(std::memory_order_acquire); pos != end; pos++) {
+        slot& s = slots[pos & mask];
+        if (s.sequence.load(std::memory_order_acquire) != pos + 1)
+            continue;
+        if (match(s.message))
+            s.handler.store(0, std::memory_order_release);
+    }
+}
+
+void event_queue::clear_plugin(int plugin_id) {
+    clear_if([plugin_id](const event_message& m) { return m.plugin_id == plugin_id; });
+}
+
+void event_queue::clear_handler(event_handler* handler) {
+    clear_if([handler](const event_message& m) { return m.event == handler; });
+}
+
+}
@@ -23,6 +23,8 @@ using namespace std;
 
 namespace zzub {
 
+float host::no_feedback[zzub::max_block_size];
+
 /*! \struct host
     \brief The host interface exposes methods to the plugins.
 
@@ -36,16 +38,46 @@ host::host(zzub::player* play, zzub_plugin_t* plug) {
 
     aux_buffer.resize(2);
     for (unsigned int c = 0; c < aux_buffer.size(); ++c) {
-        aux_buffer[c].resize(zzub::buffer_size * sizeof(float) * 4);
+        aux_buffer[c].resize(zzub::buffer_size * 4);
     }
 
+    feedback_position = 0;
+    feedback_delay = 0;
+}
+
+host::~host() {
+}
+
+void host::enable_feedback_history() {
+    int delay = _player->front.block_size;
+    if (!feedback_buffer.empty() && feedback_delay == delay) return;
+
     feedback_buffer.resize(2);
     for (unsigned int c = 0; c < feedback_buffer.size(); ++c) {
-        feedback_buffer[c].resize(zzub::buffer_size * sizeof(float) * 2);
+        feedback_buffer[c].assign(delay * 8, 0.0f);
     }
+    feedback_delay = delay;
+    feedback_position = delay;
 }
 
-host::~host() {
+void host::write_feedback(float** samples, int numsamples) {
+    int size = (int)feedback_buffer[0].size();
+    if (feedback_position + numsamples > size) {
+        for (unsigned int c = 0; c < feedback_buffer.size(); ++c) {
+            float* buffer = &feedback_buffer[c].front();
+            memmove(buffer, buffer + feedback_position - feedback_delay, feedback_delay * sizeof(float));
+        }
+        feedback_position = feedback_delay;
+    }
+
+    for (unsigned int c = 0; c < feedback_buffer.size(); ++c) {
+        float* dest = &feedback_buffer[c][feedback_position];
+        if (samples)
+            memcpy(dest, samples[c], numsamples * sizeof(float));
+        else
+            memset(dest, 0, numsamples * sizeof(float));
+    }
+    feedback_position += numsamples;
 }
 
 const wave_info* host::get_wave(int i) {
@@ -492,15 +524,7 @@ void host::remove_event_handler(metaplugin_proxy* pmac, event_handler* handler)
     handlers.erase(i);
 
     // clear events in queue using this handler
-    unsigned int read_pos = plugin_player->user_event_queue_read;
-    while (read_pos != plugin_player->user_event_queue_write) {
-        event_message& ev = plugin_player->user_event_queue[read_pos];
-        if (ev.event == handler) ev.event = 0;
-
-        if (read_pos == plugin_player->user_event_queue.size() - 1)
-            read_pos = 0; else
-            read_pos++;
-    }
+    _player->front.user_events.clear_handler(handler);
 }
 
 char const *host::get_wave_name(int const i) {
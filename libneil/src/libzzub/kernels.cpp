@@ -0,0 +1,335 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "libzzub/kernels.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define ZZUB_X86_KERNELS
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// same value as SIGNAL_TRESHOLD in zzub/internal.h
+#define KERNEL_SIGNAL_THRESHOLD (0.0000158489f)
+
+namespace zzub {
+
+namespace {
+
+// scalar kernels. these are also the tails of the vector kernels, so keep the operations
+// in the same order as the vector code.
+
+void add_pan_scalar(float* out_l, float* out_r, const float* in_l, const float* in_r, int sample_count, float amp_l, float amp_r) {
+    for (int i = 0; i < sample_count; i++) {
+        out_l[i] += in_l[i] * amp_l;
+        out_r[i] += in_r[i] * amp_r;
+    }
+}
+
+void add_scalar(float* out, const float* in, int sample_count, float amp) {
+    for (int i = 0; i < sample_count; i++)
+        out[i] += in[i] * amp;
+}
+
+void amp_scalar(float* buffer, int sample_count, float amp) {
+    for (int i = 0; i < sample_count; i++)
+        buffer[i] *= amp;
+}
+
+void copy_mono_to_stereo_scalar(float* out, const float* in, int sample_count, float amp) {
+    for (int i = 0; i < sample_count; i++) {
+        float s = in[i] * amp;
+        out[i * 2] = s;
+        out[i * 2 + 1] = s;
+    }
+}
+
+void copy_stereo_to_mono_scalar(float* out, const float* in, int sample_count, float amp) {
+    for (int i = 0; i < sample_count; i++)
+        out[i] = (in[i * 2] + in[i * 2 + 1]) * amp;
+}
+
+// nans are ignored, like maxps does when the running maximum is the second operand
+inline float peak_scalar_from(const float* buffer, int sample_count, float peak) {
+    for (int i = 0; i < sample_count; i++) {
+        float s = std::abs(buffer[i]);
+        peak = s > peak ? s : peak;
+    }
+    return peak;
+}
+
+float peak_scalar(const float* buffer, int sample_count) {
+    return peak_scalar_from(buffer, sample_count, 0.0f);
+}
+
+bool has_signals_scalar(const float* buffer, int sample_count) {
+    for (int i = 0; i < sample_count; i++) {
+        if (buffer[i] > KERNEL_SIGNAL_THRESHOLD || buffer[i] < -KERNEL_SIGNAL_THRESHOLD)
+            return true;
+    }
+    return false;
+}
+
+const mixing_kernels scalar_kernels = {
+    "scalar",
+    add_pan_scalar,
+    add_scalar,
+    amp_scalar,
+    copy_mono_to_stereo_scalar,
+    copy_stereo_to_mono_scalar,
+    peak_scalar,
+    has_signals_scalar,
+};
+
+
+#if defined(ZZUB_X86_KERNELS)
+
+// sse2
+
+TARGET_SSE2 void add_pan_sse2(float* out_l, float* out_r, const float* in_l, const float* in_r, int sample_count, float amp_l, float amp_r) {
+    __m128 al = _mm_set1_ps(amp_l);
+    __m128 ar = _mm_set1_ps(amp_r);
+    int i = 0;
+    for (; i + 4 <= sample_count; i += 4) {
+        _mm_storeu_ps(out_l + i, _mm_add_ps(_mm_loadu_ps(out_l + i), _mm_mul_ps(_mm_loadu_ps(in_l + i), al)));
+        _mm_storeu_ps(out_r + i, _mm_add_ps(_mm_loadu_ps(out_r + i), _mm_mul_ps(_mm_loadu_ps(in_r + i), ar)));
+    }
+    add_pan_scalar(out_l + i, out_r + i, in_l + i, in_r + i, sample_count - i, amp_l, amp_r);
+}
+
+TARGET_SSE2 void add_sse2(float* out, const float* in, int sample_count, float amp) {
+    __m128 a = _mm_set1_ps(amp);
+    int i = 0;
+    for (; i + 4 <= sample_count; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), a)));
+    add_scalar(out + i, in + i, sample_count - i, amp);
+}
+
+TARGET_SSE2 void amp_sse2(float* buffer, int sample_count, float amp) {
+    __m128 a = _mm_set1_ps(amp);
+    int i = 0;
+    for (; i + 4 <= sample_count; i += 4)
+        _mm_storeu_ps(buffer + i, _mm_mul_ps(_mm_loadu_ps(buffer + i), a));
+    amp_scalar(buffer + i, sample_count - i, amp);
+}
+
+TARGET_SSE2 void copy_mono_to_stereo_sse2(float* out, const float* in, int sample_count, float amp) {
+    __m128 a = _mm_set1_ps(amp);
+    int i = 0;
+    for (; i + 4 <= sample_count; i += 4) {
+        __m128 s = _mm_mul_ps(_mm_loadu_ps(in + i), a);
+        _mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(s, s));
+        _mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(s, s));
+    }
+    copy_mono_to_stereo_scalar(out + i * 2, in + i, sample_count - i, amp);
+}
+
+TARGET_SSE2 void copy_stereo_to_mono_sse2(float* out, const float* in, int sample_count, float amp) {
+    __m128 a = _mm_set1_ps(amp);
+    int i = 0;
+    for (; i + 4 <= sample_count; i += 4) {
+        __m128 s0 = _mm_loadu_ps(in + i * 2);
+        __m128 s1 = _mm_loadu_ps(in + i * 2 + 4);
+        __m128 l = _mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 r = _mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(l, r), a));
+    }
+    copy_stereo_to_mono_scalar(out + i, in + i * 2, sample_count - i, amp);
+}
+
+TARGET_SSE2 float peak_sse2(const float* buffer, int sample_count) {
+    __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 peak = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= sample_count; i += 4)
+        peak = _mm_max_ps(_mm_and_ps(_mm_loadu_ps(buffer + i), abs_mask), peak);
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, peak);
+    float result = peak_scalar_from(lanes, 4, 0.0f);
+    return peak_scalar_from(buffer + i, sample_count - i, result);
+}
+
+TARGET_SSE2 bool has_signals_sse2(const float* buffer, int sample_count) {
+    __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 threshold = _mm_set1_ps(KERNEL_SIGNAL_THRESHOLD);
+    int i = 0;
+    for (; i + 4 <= sample_count; i += 4) {
+        __m128 above = _mm_cmpgt_ps(_mm_and_ps(_mm_loadu_ps(buffer + i), abs_mask), threshold);
+        if (_mm_movemask_ps(above) != 0) return true;
+    }
+    return has_signals_scalar(buffer + i, sample_count - i);
+}
+
+const mixing_kernels sse2_kernels = {
+    "sse2",
+    add_pan_sse2,
+    add_sse2,
+    amp_sse2,
+    copy_mono_to_stereo_sse2,
+    copy_stereo_to_mono_sse2,
+    peak_sse2,
+    has_signals_sse2,
+};
+
+
+// avx2. only the float part of avx is used, fma is left out on purpose so the results
+// match the other sets.
+
+TARGET_AVX2 void add_pan_avx2(float* out_l, float* out_r, const float* in_l, const float* in_r, int sample_count, float amp_l, float amp_r) {
+    __m256 al = _mm256_set1_ps(amp_l);
+    __m256 ar = _mm256_set1_ps(amp_r);
+    int i = 0;
+    for (; i + 8 <= sample_count; i += 8) {
+        _mm256_storeu_ps(out_l + i, _mm256_add_ps(_mm256_loadu_ps(out_l + i), _mm256_mul_ps(_mm256_loadu_ps(in_l + i), al)));
+        _mm256_storeu_ps(out_r + i, _mm256_add_ps(_mm256_loadu_ps(out_r + i), _mm256_mul_ps(_mm256_loadu_ps(in_r + i), ar)));
+    }
+    add_pan_scalar(out_l + i, out_r + i, in_l + i, in_r + i, sample_count - i, amp_l, amp_r);
+}
+
+TARGET_AVX2 void add_avx2(float* out, const float* in, int sample_count, float amp) {
+    __m256 a = _mm256_set1_ps(amp);
+    int i = 0;
+    for (; i + 8 <= sample_count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_loadu_ps(in + i), a)));
+    add_scalar(out + i, in + i, sample_count - i, amp);
+}
+
+TARGET_AVX2 void amp_avx2(float* buffer, int sample_count, float amp) {
+    __m256 a = _mm256_set1_ps(amp);
+    int i = 0;
+    for (; i + 8 <= sample_count; i += 8)
+        _mm256_storeu_ps(buffer + i, _mm256_mul_ps(_mm256_loadu_ps(buffer + i), a));
+    amp_scalar(buffer + i, sample_count - i, amp);
+}
+
+TARGET_AVX2 void copy_mono_to_stereo_avx2(float* out, const float* in, int sample_count, float amp) {
+    __m256 a = _mm256_set1_ps(amp);
+    int i = 0;
+    for (; i + 8 <= sample_count; i += 8) {
+        __m256 s = _mm256_mul_ps(_mm256_loadu_ps(in + i), a);
+        // unpack works per 128 bit lane, put the lanes back in order
+        __m256 lo = _mm256_unpacklo_ps(s, s);
+        __m256 hi = _mm256_unpackhi_ps(s, s);
+        _mm256_storeu_ps(out + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    copy_mono_to_stereo_scalar(out + i * 2, in + i, sample_count - i, amp);
+}
+
+TARGET_AVX2 void copy_stereo_to_mono_avx2(float* out, const float* in, int sample_count, float amp) {
+    __m256 a = _mm256_set1_ps(amp);
+    int i = 0;
+    for (; i + 8 <= sample_count; i += 8) {
+        __m256 s0 = _mm256_loadu_ps(in + i * 2);
+        __m256 s1 = _mm256_loadu_ps(in + i * 2 + 8);
+        __m256 l = _mm256_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 r = _mm256_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1));
+        // the shuffles leave the samples in order 0 1 4 5 2 3 6 7
+        __m256 m = _mm256_mul_ps(_mm256_add_ps(l, r), a);
+        _mm256_storeu_ps(out + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(m), _MM_SHUFFLE(3, 1, 2, 0))));
+    }
+    copy_stereo_to_mono_scalar(out + i, in + i * 2, sample_count - i, amp);
+}
+
+TARGET_AVX2 float peak_avx2(const float* buffer, int sample_count) {
+    __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 peak = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= sample_count; i += 8)
+        peak = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(buffer + i), abs_mask), peak);
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, peak);
+    float result = peak_scalar_from(lanes, 8, 0.0f);
+    return peak_scalar_from(buffer + i, sample_count - i, result);
+}
+
+TARGET_AVX2 bool has_signals_avx2(const float* buffer, int sample_count) {
+    __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 threshold = _mm256_set1_ps(KERNEL_SIGNAL_THRESHOLD);
+    int i = 0;
+    for (; i + 8 <= sample_count; i += 8) {
+        __m256 above = _mm256_cmp_ps(_mm256_and_ps(_mm256_loadu_ps(buffer + i), abs_mask), threshold, _CMP_GT_OQ);
+        if (_mm256_movemask_ps(above) != 0) return true;
+    }
+    return has_signals_scalar(buffer + i, sample_count - i);
+}
+
+const mixing_kernels avx2_kernels = {
+    "avx2",
+    add_pan_avx2,
+    add_avx2,
+    amp_avx2,
+    copy_mono_to_stereo_avx2,
+    copy_stereo_to_mono_avx2,
+    peak_avx2,
+    has_signals_avx2,
+};
+
+#endif
+
+const mixing_kernels* select_kernels() {
+    const mixing_kernels* best = &scalar_kernels;
+    for (int i = kernel_set_count - 1; i >= 0; i--) {
+        const mixing_kernels* k = get_mixing_kernels((kernel_set)i);
+        if (k) {
+            best = k;
+            break;
+        }
+    }
+
+    const char* name = getenv("ZZUB_KERNELS");
+    if (name) {
+        for (int i = 0; i < kernel_set_count; i++) {
+            const mixing_kernels* k = get_mixing_kernels((kernel_set)i);
+            if (k && strcmp(k->name, name) == 0) return k;
+        }
+        std::cerr << "ZZUB_KERNELS: " << name << " is not available, using " << best->name << std::endl;
+    }
+    return best;
+}
+
+}
+
+
+const mixing_kernels* get_mixing_kernels(kernel_set set) {
+    switch (set) {
+    case kernel_set_scalar:
+        return &scalar_kernels;
+#if defined(ZZUB_X86_KERNELS)
+    case kernel_set_sse2:
+        return __builtin_cpu_supports("sse2") ? &sse2_kernels : 0;
+    case kernel_set_avx2:
+        return __builtin_cpu_supports("avx2") ? &avx2_kernels : 0;
+#endif
+    default:
+        return 0;
+    }
+}
+
+const mixing_kernels& kernels() {
+    static const mixing_kernels* selected = select_kernels();
+    return *selected;
+}
+
+}
@@ -193,6 +193,22 @@ void zzub_player_history_flush_last(
 }
 
 
+void zzub_player_begin_song_build(
+    zzub_player_t* player
+)
+{
+    player->begin_song_build();
+}
+
+
+void zzub_player_end_song_build(
+    zzub_player_t* player
+)
+{
+    player->end_song_build();
+}
+
+
 int zzub_player_history_get_size(
     zzub_player_t* player
 )
@@ -236,7 +252,8 @@ void zzub_plugincollection_configure(
     const char* value
 )
 {
-    collection->collection->configure(key, value);
+    if (collection->ensure_loaded())
+        collection->collection->configure(key, value);
 }
 
 
@@ -285,6 +302,24 @@ int zzub_player_save_ccm(
 }
 
 
+void zzub_player_set_ccm_progress_callback(zzub_player_t* player, zzub_ccm_progress_callback_t callback, void* tag)
+{
+    if (callback)
+        player->ccm_progress = [=](int done, int total) { callback(player, done, total, tag); };
+    else
+        player->ccm_progress = nullptr;
+}
+
+
+int zzub_player_save_ccm_async(
+    zzub_player_t* player,
+    const char* fileName
+)
+{
+    return player->save_ccm_async(fileName);
+}
+
+
 int zzub_player_save_ccm_selected(
     zzub_player_t* player, 
     const char* fileName, 
@@ -714,6 +749,16 @@ zzub_event_data_t* zzub_player_get_next_event(
 }
 
 
+int zzub_player_get_next_events(
+    zzub_player_t* player,
+    zzub_event_data_t** events,
+    int max_count
+)
+{
+    return player->pop_events(events, max_count);
+}
+
+
 void zzub_player_set_callback(
     zzub_player_t* player, 
     zzub_callback_t callback, 
@@ -819,6 +864,75 @@ void zzub_player_set_midi_transport(zzub_player_t* player, int enable)
     player->front.is_syncing_midi_transport = enable != 0 ? true : false;
 }
 
+void zzub_player_set_work_mode(zzub_player_t* player, int mode, int thread_count)
+{
+    player->set_work_mode((zzub::work_mode)mode, thread_count);
+}
+
+
+int zzub_player_get_work_mode(zzub_player_t* player)
+{
+    return player->front.scheduler.get_mode();
+}
+
+
+int zzub_player_render_offline(zzub_player_t* player, int start, int end, const char* path, int format, zzub_render_callback_t callback, void* tag)
+{
+    std::function<bool(int, float)> progress;
+    if (callback)
+        progress = [=](int position, float fraction) { return callback(player, position, fraction, tag) != 0; };
+    return player->render_offline(start, end, path, (zzub::wave_buffer_type)format, progress);
+}
+
+
+void zzub_player_cancel_render(zzub_player_t* player)
+{
+    player->cancel_render();
+}
+
+
+void zzub_player_set_tracing(zzub_player_t* player, int enable)
+{
+    player->set_tracing(enable != 0);
+}
+
+
+int zzub_player_save_trace(zzub_player_t* player, const char* path)
+{
+    return player->save_trace(path);
+}
+
+
+int zzub_player_get_rt_violations(zzub_player_t* player)
+{
+    return rtcheck_violations();
+}
+
+
+int zzub_player_get_work_thread_count(zzub_player_t* player)
+{
+    return player->front.scheduler.get_thread_count();
+}
+
+
+int zzub_player_get_buffer_working_set(zzub_player_t* player)
+{
+    return (int)player->front.get_buffer_working_set();
+}
+
+
+void zzub_player_set_block_size(zzub_player_t* player, int size)
+{
+    player->set_block_size(size);
+}
+
+
+int zzub_player_get_block_size(zzub_player_t* player)
+{
+    return player->get_block_size();
+}
+
+
 void zzub_player_reset_keyjazz(zzub_player_t* player)
 {
     player->reset_keyjazz();
@@ -997,7 +1111,8 @@ zzub_attribute_t* zzub_pluginloader_get_attribute(zzub_pluginloader_t* loader, i
 
 int zzub_pluginloader_get_instrument_list(zzub_pluginloader_t* loader, char* result, int maxbytes)
 {
-    if (loader->plugin_lib == 0)
+    loader = zzub::resolve_info(loader);
+    if (loader == 0 || loader->plugin_lib == 0)
         return 0;
 
     vector<char> outputBytes;
@@ -1464,7 +1579,31 @@ int zzub_plugin_get_pattern_value(zzub_plugin_t* plugin, int pattern, int group,
     flags.copy_plugins = true;
     plugin->_player->merge_backbuffer_flags(flags);
 
-    return plugin->_player->back.plugins[plugin->id]->patterns[pattern]->groups[group][track][column][row];
+    return plugin->_player->back.plugins[plugin->id]->patterns[pattern]->value(group, track, column, row);
+}
+
+int zzub_plugin_get_pattern_values(zzub_plugin_t* plugin, int pattern, int row, int rows, int column, int columns, int* values, int maxvalues)
+{
+    operation_copy_flags flags;
+    flags.copy_plugins = true;
+    plugin->_player->merge_backbuffer_flags(flags);
+
+    const zzub::pattern& p = *plugin->_player->back.plugins[plugin->id]->patterns[pattern];
+
+    // values keeps a stride of columns even when the range is clipped to the pattern
+    if (columns <= 0) return 0;
+    rows = std::min(rows, maxvalues / columns);
+    int first_row = std::max(row, 0);
+    int last_row = std::min(row + rows, p.rows);
+    int first_column = std::max(column, 0);
+    int last_column = std::min(column + columns, p.column_count);
+    if (first_row >= last_row || first_column >= last_column) return 0;
+
+    for (int i = first_row; i < last_row; i++) {
+        const int* src = p.get_row(i);
+        std::copy(src + first_column, src + last_column, values + (i - row) * columns + (first_column - column));
+    }
+    return last_row - first_row;
 }
 
 int zzub_plugin_get_global_parameter_count(zzub_plugin_t* plugin)
@@ -1519,31 +1658,36 @@ void zzub_plugin_remove_pattern_rows(zzub_plugin_t* plugin, int pattern, const i
     plugin->_player->plugin_remove_pattern_rows(plugin->id, pattern, (int*)column_indices, num_indices, start, rows);
 }
 
-/*void zzub_plugin_set_pattern_values(zzub_player_t* player, int plugin, int pattern, int target_row, zzub_pattern_t* src_pattern, int* mappings, int mappings_count) {
-    player->begin_operation();
-    for (int i = 0; i < mappings_count; i++) {
-    int source_group = mappings[i * 6 + 0];
-    int source_track = mappings[i * 6 + 1];
-    int source_column = mappings[i * 6 + 2];
-    int target_group = mappings[i * 6 + 3];
-    int target_track = mappings[i * 6 + 4];
-    int target_column = mappings[i * 6 + 5];
-    const zzub_parameter_t* target_param = zzub_plugin_get_parameter(player, plugin, target_group, target_track, target_column);
-    for (int j = 0; j < zzub_pattern_get_row_count(src_pattern); j++) {
-    if (target_row + j < 0) continue;
-    if (target_row + j >= zzub_plugin_get_pattern_length(player, plugin, pattern)) break;
-    int v = src_pattern->groups[source_group][source_track][source_column][j];
-    if (v == -1) v = target_param->value_none;
-
-    // value must be within the valid range
-    if (v != target_param->value_none && v < target_param->value_min) v = target_param->value_min;
-    if (v != target_param->value_none && v > target_param->value_max) v = target_param->value_max;
-
-    player->plugin_set_pattern_value(plugin, pattern, target_group, target_track, target_column, target_row + j, v);
-    }
-    }
-    player->commit_operation();
-    }*/
+void zzub_plugin_set_pattern_values(zzub_plugin_t* plugin, int pattern, const int* cells, int count)
+{
+    // cells outside the pattern are dropped, values are checked by the operation like in set_pattern_value
+    operation_copy_flags flags;
+    flags.copy_plugins = true;
+    operation_copy_plugin_flags pluginflags;
+    pluginflags.plugin_id = plugin->id;
+    pluginflags.copy_plugin = true;
+    pluginflags.copy_patterns = true;
+    flags.plugin_flags.push_back(pluginflags);
+    plugin->_player->merge_backbuffer_flags(flags);
+
+    zzub::metaplugin& m = *plugin->_player->back.plugins[plugin->id];
+    if (pattern < 0 || pattern >= (int)m.patterns.size()) return;
+
+    const zzub::pattern& p = *m.patterns[pattern];
+    std::vector<int> valid;
+    valid.reserve(count * 5);
+    for (int i = 0; i < count; i++) {
+        const int* cell = &cells[i * 5];
+        if (cell[0] < 0 || cell[0] >= p.get_group_count()) continue;
+        if (cell[1] < 0 || cell[1] >= p.get_track_count(cell[0])) continue;
+        if (cell[2] < 0 || cell[2] >= p.get_column_count(cell[0], cell[1])) continue;
+        if (cell[3] < 0 || cell[3] >= p.rows) continue;
+        valid.insert(valid.end(), cell, cell + 5);
+    }
+    if (valid.empty()) return;
+
+    plugin->_player->plugin_set_pattern_values(plugin->id, pattern, &valid.front(), valid.size() / 5);
+}
 
 const char* zzub_plugin_get_preset_file_extensions(zzub_plugin_t* plugin)
 {
@@ -2071,6 +2215,12 @@ double zzub_plugin_get_last_cpu_load(zzub_plugin_t* plugin)
 }
 
 
+int zzub_plugin_get_work_time_stats(zzub_plugin_t* plugin, float* p50, float* p99, float* max)
+{
+    return plugin->_player->get_plugin_work_time_stats(plugin->id, *p50, *p99, *max);
+}
+
+
 int zzub_plugin_get_last_audio_result(zzub_plugin_t* plugin)
 {
     if (plugin->id >= plugin->_player->front.plugins.size() || plugin->_player->front.plugins[plugin->id] == 0)
@@ -2344,6 +2494,26 @@ int zzub_sequence_get_event(zzub_sequence_t* sequence, int index, int* pos, int*
     return 0;
 }
 
+int zzub_sequence_get_events(zzub_sequence_t* sequence, int start, int end, int* positions, int* values, int maxcount)
+{
+    operation_copy_flags flags;
+    flags.copy_sequencer_tracks = true;
+    sequence->_player->merge_backbuffer_flags(flags);
+
+    const std::vector<sequence_event>& events = sequence->_player->back.sequencer_tracks[sequence->track].events;
+
+    // events are sorted by time
+    std::vector<sequence_event>::const_iterator i = std::lower_bound(events.begin(), events.end(), start,
+        [](const sequence_event& ev, int time) { return ev.time < time; });
+
+    int count = 0;
+    for (; i != events.end() && i->time < end && count < maxcount; ++i, ++count) {
+        positions[count] = i->time;
+        values[count] = i->pattern_event.value;
+    }
+    return count;
+}
+
 zzub_plugin_t* zzub_sequence_get_plugin(zzub_sequence_t* sequence)
 {
 
@@ -2420,13 +2590,9 @@ zzub_pattern_t* zzub_plugin_create_pattern(zzub_plugin_t* plugin, int rows)
 zzub_pattern_t* zzub_plugin_create_range_pattern(zzub_player_t* player, int columns, int rows)
 {
     zzub::pattern* p = new zzub::pattern();
-    p->groups.resize(1);
-    p->groups[0].resize(1);
-    p->groups[0][0].resize(columns);
-    for (size_t i = 0; i < p->groups[0][0].size(); i++) {
-        p->groups[0][0][i].resize(rows);
-    }
     p->rows = rows;
+    p->set_group_count(1);
+    p->add_track(0, columns, 0);
     return p;
 }
 
@@ -2477,27 +2643,27 @@ int zzub_pattern_get_row_count(zzub_pattern_t* pattern)
 
 int zzub_pattern_get_group_count(zzub_pattern_t* pattern)
 {
-    return (int)pattern->groups.size();
+    return pattern->get_group_count();
 }
 
 int zzub_pattern_get_track_count(zzub_pattern_t* pattern, int group)
 {
-    return (int)pattern->groups[group].size();
+    return pattern->get_track_count(group);
 }
 
 int zzub_pattern_get_column_count(zzub_pattern_t* pattern, int group, int track)
 {
-    return (int)pattern->groups[group][track].size();
+    return pattern->get_column_count(group, track);
 }
 
 int zzub_pattern_get_value(zzub_pattern_t* pattern, int row, int group, int track, int column)
 {
-    return pattern->groups[group][track][column][row];
+    return pattern->value(group, track, column, row);
 }
 
 void zzub_pattern_set_value(zzub_pattern_t* pattern, int row, int group, int track, int column, int value)
 {
-    pattern->groups[group][track][column][row] = value;
+    pattern->value(group, track, column, row) = value;
 }
 
 void zzub_pattern_interpolate(zzub_pattern_t* pattern)
@@ -3204,6 +3370,7 @@ void zzub_wavelevel_xfade(zzub_wavelevel_t* level, int start, int end)
             fade2 -= dfade;
         }
     }
+    l.peaks.reset();
     l.loop_start = start;
     l.loop_end = end;
     w.flags = w.flags | zzub_wave_flag_loop;
@@ -3249,6 +3416,7 @@ void zzub_wavelevel_normalize(zzub_wavelevel_t* level)
             normalizer = (0.5 * pow(2.0, bitsps)) / float(max_sample);
         }
     }
+    l.peaks.reset();
 }
 
 void zzub_wavelevel_get_samples_digest(zzub_wavelevel_t* level, int channel, int start, int end, float* mindigest, float* maxdigest, float* ampdigest, int digestsize)
@@ -3261,96 +3429,7 @@ void zzub_wavelevel_get_samples_digest(zzub_wavelevel_t* level, int channel, int
     wave_info_ex& w = *level->_player->back.wavetable.waves[level->wave];
     wave_level_ex& l = level->_player->back.wavetable.waves[level->wave]->levels[level->level];
 
-    unsigned char* samples = (unsigned char*)l.samples;
-    int bitsps = l.get_bytes_per_sample() * 8;
-    int bps = l.get_bytes_per_sample();
-    wave_buffer_type format = (wave_buffer_type)l.format;
-    float scaler = 1.0f / (1 << (bitsps - 1));
-    // int samplecount = l.sample_count;
-    int samplerange = end - start;
-    // assert((start >= 0) && (start < samplecount));
-    // assert((end > start) && (end <= samplecount));
-    assert(samplerange > 0);
-    int channels = w.get_stereo() ? 2 : 1;
-    float sps = (float)samplerange / (float)digestsize; // samples per sample
-    float blockstart = (float)start;
-    if (sps > 1) {
-        for (int i = 0; i < digestsize; ++i) {
-            float blockend = std::min(blockstart + sps, (float)end);
-            float minsample = 1.0f;
-            float maxsample = -1.0f;
-            float amp = 0.0f;
-            for (int s = (int)blockstart; s < (int)blockend; ++s) {
-                int offset = (s * channels + channel) * bps;
-                int isample = 0;
-                switch (bps) {
-                case 1:
-                    isample = *(char*)&samples[offset];
-                    break;
-                case 2:
-                    isample = *(short*)&samples[offset];
-                    break;
-                case 3:
-                    isample = *(int*)&samples[offset] & 0x00ffffff;
-                    if (isample & 0x00800000)
-                        isample = isample | 0xFF000000;
-                    break; // TODO
-                case 4:
-                    switch (format) {
-                    case wave_buffer_type_si16:
-                        break;
-                    case wave_buffer_type_si24:
-                        break;
-                    case wave_buffer_type_si32:
-                        isample = *(int*)&samples[offset];
-                        break;
-                    case wave_buffer_type_f32:
-                        isample = (int)((*(float*)&samples[offset]) / scaler);
-                        break;
-                    }
-                    break;
-                }
-                float sample = (float)(isample)*scaler;
-                minsample = std::min(minsample, sample);
-                maxsample = std::max(maxsample, sample);
-                amp += sample * sample;
-            }
-            if (mindigest)
-                mindigest[i] = minsample;
-            if (maxdigest)
-                maxdigest[i] = maxsample;
-            if (ampdigest)
-                ampdigest[i] = sqrtf(amp / (blockend - blockstart));
-            blockstart = blockend;
-        }
-    } else {
-        for (int i = 0; i < digestsize; ++i) {
-            int s = (int)(blockstart + i * sps /* + 0.5f */);
-            int offset = (s * channels + channel) * bps;
-            int isample = 0;
-            switch (bps) {
-            case 1:
-                isample = *(char*)&samples[offset];
-                break;
-            case 2:
-                isample = *(short*)&samples[offset];
-                break;
-            case 3:
-                isample = *(int*)&samples[offset];
-                break; // TODO
-            case 4:
-                isample = *(int*)&samples[offset];
-                break;
-            }
-            float sample = (float)(isample)*scaler;
-            if (mindigest)
-                mindigest[i] = sample;
-            if (maxdigest)
-                maxdigest[i] = sample;
-            if (ampdigest)
-                ampdigest[i] = std::abs(sample);
-        }
-    }
+    get_wave_digest(w, l, channel, start, end, mindigest, maxdigest, ampdigest, digestsize);
 }
 
 /*int zzub_wavelevel_get_sample_count(zzub_wavelevel_t * level) {
@@ -52,7 +52,8 @@ master_plugin_info::master_plugin_info()
             zzub::plugin_flag_has_audio_output |
             zzub::plugin_flag_has_audio_input |
             zzub::plugin_flag_has_midi_input |
-            zzub::plugin_flag_has_ports;
+            zzub::plugin_flag_has_ports |
+            zzub::plugin_flag_large_blocks;
 
     this->name = "Master";
     this->short_name = "Master";
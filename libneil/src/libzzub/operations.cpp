@@ -163,6 +163,18 @@ op_plugin_create::op_plugin_create(zzub::player* _player, int _id, std::string _
 }
 
 bool op_plugin_create::prepare(zzub::song& song) {
+    // the plugin is built from what the library reports, a cached info only stands in for it.
+    // the song data may have been laid out from the cache, so a changed plugin is refused.
+    if (const cached_info* cached = dynamic_cast<const cached_info*>(loader)) {
+        const zzub::info* loaded = cached->resolve();
+        if (loaded == 0)
+            return false;
+        if (!cached->matches(*loaded)) {
+            std::cerr << "plugin cache: " << loaded->uri << " changed since it was cached, not creating it from the cached layout" << std::endl;
+            return false;
+        }
+        loader = loaded;
+    }
 
     zzub::plugin* instance = loader->create_plugin();
     if (instance == 0) {
@@ -202,10 +214,14 @@ bool op_plugin_create::prepare(zzub::song& song) {
     plugin.last_work_max_right = 0;
     plugin.last_work_time = 0.0f;
     plugin.last_work_frame = 0;
+    plugin.keeps_feedback_history = false;
     plugin.cpu_load = 0.0f;
     plugin.cpu_load_buffersize = 0;
     plugin.cpu_load_time = 0.0f;
+    plugin.total_work_time = 0;
     plugin.writemode_errors = 0;
+    plugin.silent_samples = 0;
+    plugin.is_sleeping = false;
 
     if (get_note_info(loader, plugin.note_group, plugin.note_column)) {
         if (!get_velocity_info(loader, plugin.note_group, plugin.velocity_column)) {
@@ -223,9 +239,8 @@ bool op_plugin_create::prepare(zzub::song& song) {
 
 
     plugin.initialized = false;
-    plugin.work_buffer.resize(2);
-    plugin.work_buffer[0].resize(buffer_size * 4);
-    plugin.work_buffer[1].resize(buffer_size * 4);
+    plugin.work_buffer[0] = 0;
+    plugin.work_buffer[1] = 0;
     plugin.proxy = new metaplugin_proxy(player, id);
     plugin.callbacks = new host(player, plugin.proxy);
     plugin.callbacks->plugin_player = &song;
@@ -260,33 +275,31 @@ bool op_plugin_create::prepare(zzub::song& song) {
     plugin.stream_source = plugin_stream_source ? plugin_stream_source : "";
     // add states for controller columns
     if (plugin.info->flags & zzub::plugin_flag_has_event_output) {
-        plugin.state_write.groups.push_back(pattern::group());
-        plugin.state_last.groups.push_back(pattern::group());
-        plugin.state_automation.groups.push_back(pattern::group());
-        // the controller group has one track
-        plugin.state_write.groups.back().push_back(pattern::track());
-        plugin.state_last.groups.back().push_back(pattern::track());
-        plugin.state_automation.groups.back().push_back(pattern::track());
-        for (size_t i = 0; i < plugin.info->controller_parameters.size(); i++) {
-            // the controller group (track 0) has multiple columns
-            plugin.state_write.groups.back().back().push_back(pattern::column());
-            plugin.state_write.groups.back().back().back().push_back(plugin.info->controller_parameters[i]->value_none);
-            plugin.state_last.groups.back().back().push_back(pattern::column());
-            plugin.state_last.groups.back().back().back().push_back(plugin.info->controller_parameters[i]->value_none);
-            plugin.state_automation.groups.back().back().push_back(pattern::column());
-            plugin.state_automation.groups.back().back().back().push_back(plugin.info->controller_parameters[i]->value_none);
-        }
+        // the controller group has one track with multiple columns
+        std::vector<int> controller_none(plugin.info->controller_parameters.size());
+        for (size_t i = 0; i < plugin.info->controller_parameters.size(); i++)
+            controller_none[i] = plugin.info->controller_parameters[i]->value_none;
+        const int* fill = controller_none.empty() ? 0 : &controller_none.front();
+        int columns = (int)controller_none.size();
+
+        plugin.state_write.set_group_count(4);
+        plugin.state_write.add_track(3, columns, fill);
+        plugin.state_last.set_group_count(4);
+        plugin.state_last.add_track(3, columns, fill);
+        plugin.state_automation.set_group_count(4);
+        plugin.state_automation.add_track(3, columns, fill);
     }
     // fill state pattern with default values and copy to live
-    song.default_plugin_parameter_track(plugin.state_write.groups[1][0], loader->global_parameters);
+    song.default_plugin_parameter_track(plugin.state_write, 1, 0, loader->global_parameters);
     //song.transfer_plugin_parameter_track_row(id, 1, 0, plugin.state_write, (char*)plugin.plugin->global_values, 0, true);
     //char* track_ptr = (char*)plugin.plugin->track_values;
     //int track_size = song.get_plugin_parameter_track_row_bytesize(id, 2, 0);
     for (int j = 0; j < plugin.tracks; j++) {
-        song.default_plugin_parameter_track(plugin.state_write.groups[2][j], loader->track_parameters);
+        song.default_plugin_parameter_track(plugin.state_write, 2, j, loader->track_parameters);
         //song.transfer_plugin_parameter_track_row(id, 2, j, plugin.state_write, track_ptr, 0, true);
         //track_ptr += track_size;
     }
+    song.make_parameter_transfer_plan(id);
     instance->set_track_count(plugin.tracks);
     instance->attributes_changed();
     song.process_plugin_events(id);
@@ -366,14 +379,7 @@ bool op_plugin_delete::operate(zzub::song& song) {
     song.plugins[id] = 0;
 
     // clear events targeted for this plugin:
-    size_t read_pos = song.user_event_queue_read;
-    while (read_pos != song.user_event_queue_write) {
-        event_message& ev = song.user_event_queue[read_pos];
-        if (ev.plugin_id == id) ev.event = 0;
-        if (read_pos == song.user_event_queue.size() - 1)
-            read_pos = 0; else
-            read_pos++;
-    }
+    if (song.user_event_queue) song.user_event_queue->clear_plugin(id);
 
     // remove currently playing keyjazz notes for this plugin
     for (size_t i = 0; i < song.keyjazz.size(); ) {
@@ -561,7 +567,7 @@ bool op_plugin_connect::prepare(zzub::song& song) {
     connection* conn = song.plugin_get_input_connection(to_id, conn_index);
 
     for (size_t i = 0; i < values.size() && i < conn->connection_parameters.size(); i++) {
-        to_mpl.state_write.groups[0].back()[i][0] = values[i];
+        to_mpl.state_write.value(0, to_mpl.state_write.get_track_count(0) - 1, i, 0) = values[i];
     }
 
     switch (type) {
@@ -992,6 +998,7 @@ bool op_plugin_set_track_count::prepare(zzub::song& song) {
     song.set_pattern_tracks(m.state_automation, m.info->track_parameters, tracks, false);
 
     m.tracks = tracks;
+    song.make_parameter_transfer_plan(id);
 
     event_data.type = event_type_set_tracks;
     event_data.set_tracks.plugin = m.proxy;
@@ -1101,8 +1108,8 @@ bool op_plugin_set_parameter::prepare(zzub::song& song) {
     assert(song.plugins[id] != 0);
     metaplugin& m = *song.plugins[id];
     // write to backbuffer so we can read them later
-    m.state_write.groups[group][track][column][0] = value;
-    if (record) m.state_automation.groups[group][track][column][0] = value;
+    m.state_write.value(group, track, column, 0) = value;
+    if (record) m.state_automation.value(group, track, column, 0) = value;
     return true;
 }
 
@@ -1115,8 +1122,8 @@ bool op_plugin_set_parameter::operate(zzub::song& song) {
     if (m.descriptor == graph_traits<plugin_map>::null_vertex()) return true;
 
     m.sequencer_state = sequencer_event_type_none;
-    //m.state_write.groups[group][track][column][0] = value;
-    //if (record) m.state_automation.groups[group][track][column][0] = value;
+    //m.state_write.value(group, track, column, 0) = value;
+    //if (record) m.state_automation.value(group, track, column, 0) = value;
     return true;
 }
 
@@ -1271,15 +1278,11 @@ bool op_pattern_edit::prepare(zzub::song& song) {
     assert(id < song.plugins.size());
     assert(song.plugins[id] != 0);
     assert(index >= 0 && (size_t)index < song.plugins[id]->patterns.size());
-    assert(group >= 0 && group < song.plugins[id]->patterns[index]->groups.size());
-    assert(track >= 0 && track < song.plugins[id]->patterns[index]->groups[group].size());
-    assert(column >= 0 && column < song.plugins[id]->patterns[index]->groups[group][track].size());
-    assert(row >= 0 && row < song.plugins[id]->patterns[index]->groups[group][track][column].size());
 
     const zzub::parameter* param = song.plugin_get_parameter_info(id, group, track, column);
     assert((value >= param->value_min && value <= param->value_max) || value == param->value_none  || (param->type == zzub::parameter_type_note && value == zzub::note_value_off));
 
-    song.plugins[id]->patterns[index]->groups[group][track][column][row] = value;
+    song.plugins[id]->patterns[index]->value(group, track, column, row) = value;
 
     event_data.type = event_type_edit_pattern;
     event_data.edit_pattern.plugin = song.plugins[id]->proxy;
@@ -1296,7 +1299,7 @@ bool op_pattern_edit::prepare(zzub::song& song) {
 bool op_pattern_edit::operate(zzub::song& song) {
 
     // TODO: may crash here if pattern/machine was deleted and edited in the same operation?
-    song.plugins[id]->patterns[index]->groups[group][track][column][row] = value;
+    song.plugins[id]->patterns[index]->value(group, track, column, row) = value;
 
     return true;
 }
@@ -1305,6 +1308,62 @@ void op_pattern_edit::finish(zzub::song& song, bool send_events) {
     if (send_events) song.plugin_invoke_event(0, event_data, true);
 }
 
+// ---------------------------------------------------------------------------
+//
+// op_pattern_edit_block
+//
+// ---------------------------------------------------------------------------
+
+op_pattern_edit_block::op_pattern_edit_block(int _id, int _index, const std::vector<cell>& _cells) {
+    id = _id;
+    index = _index;
+    cells = _cells;
+
+    copy_flags.copy_plugins = true;
+}
+
+bool op_pattern_edit_block::prepare(zzub::song& song) {
+
+    assert(id < song.plugins.size());
+    assert(song.plugins[id] != 0);
+    assert(index >= 0 && (size_t)index < song.plugins[id]->patterns.size());
+
+    zzub::pattern& p = *song.plugins[id]->patterns[index];
+    int first_row = p.rows, last_row = -1;
+    for (size_t i = 0; i < cells.size(); i++) {
+        const cell& c = cells[i];
+        const zzub::parameter* param = song.plugin_get_parameter_info(id, c.group, c.track, c.column);
+        assert((c.value >= param->value_min && c.value <= param->value_max) || c.value == param->value_none  || (param->type == zzub::parameter_type_note && c.value == zzub::note_value_off));
+
+        p.value(c.group, c.track, c.column, c.row) = c.value;
+        first_row = std::min(first_row, c.row);
+        last_row = std::max(last_row, c.row);
+    }
+
+    event_data.type = event_type_edit_pattern_block;
+    event_data.edit_pattern_block.plugin = song.plugins[id]->proxy;
+    event_data.edit_pattern_block.index = index;
+    event_data.edit_pattern_block.row = first_row;
+    event_data.edit_pattern_block.rows = std::max(last_row - first_row + 1, 0);
+
+    return true;
+}
+
+bool op_pattern_edit_block::operate(zzub::song& song) {
+
+    zzub::pattern& p = *song.plugins[id]->patterns[index];
+    for (size_t i = 0; i < cells.size(); i++) {
+        const cell& c = cells[i];
+        p.value(c.group, c.track, c.column, c.row) = c.value;
+    }
+
+    return true;
+}
+
+void op_pattern_edit_block::finish(zzub::song& song, bool send_events) {
+    if (send_events) song.plugin_invoke_event(0, event_data, true);
+}
+
 // ---------------------------------------------------------------------------
 //
 // op_pattern_insert
@@ -1570,10 +1629,8 @@ bool op_pattern_insert_rows::prepare(zzub::song& song) {
         int group = columns[i * 3 + 0];
         int track = columns[i * 3 + 1];
         int column = columns[i * 3 + 2];
-        zzub::pattern::column& patterncolumn = p.groups[group][track][column];
         const zzub::parameter* param = song.plugin_get_parameter_info(id, group, track, column);
-        patterncolumn.insert(patterncolumn.begin() + row, count, param->value_none);
-        patterncolumn.erase(patterncolumn.begin() + p.rows, patterncolumn.end());
+        p.insert_column_rows(group, track, column, row, count, param->value_none);
     }
 
     event_data.type = event_type_pattern_insert_rows;
@@ -1637,10 +1694,8 @@ bool op_pattern_remove_rows::prepare(zzub::song& song) {
         int group = columns[i * 3 + 0];
         int track = columns[i * 3 + 1];
         int column = columns[i * 3 + 2];
-        zzub::pattern::column& patterncolumn = p.groups[group][track][column];
         const zzub::parameter* param = song.plugin_get_parameter_info(id, group, track, column);
-        patterncolumn.erase(patterncolumn.begin() + row, patterncolumn.begin() + row + count);
-        patterncolumn.insert(patterncolumn.end(), count, param->value_none);
+        p.remove_column_rows(group, track, column, row, count, param->value_none);
     }
 
     event_data.type = event_type_pattern_remove_rows;
@@ -2211,6 +2266,7 @@ bool op_wavetable_insert_sampledata::prepare(zzub::song& song) {
 
     void* copybuffer = new char[bytes_per_sample * channels * numsamples];
     memcpy(copybuffer, w.get_sample_ptr(level), bytes_per_sample * channels * numsamples);
+    std::shared_ptr<wave_peaks> peaks = l.peaks;
 
     bool allocw = w.allocate_level(level, newsamples, (wave_buffer_type)format, channels == 2 ? true : false);
     assert(allocw);
@@ -2234,6 +2290,7 @@ bool op_wavetable_insert_sampledata::prepare(zzub::song& song) {
         CopySamples(copybuffer, dst, numsamples - pos, format, format, channels, channels, pos * channels + 1, (pos + samples_length) * channels + 1);
 
     }
+    invalidate_wave_peaks(w, l, peaks, pos);
 
     // Don't know if this is right?
     switch (format) {
@@ -2300,6 +2357,7 @@ bool op_wavetable_remove_sampledata::prepare(zzub::song& song) {
 
     void* copybuffer = new char[numsamples * bytes_per_sample * channels];
     memcpy(copybuffer, w.get_sample_ptr(level), numsamples * bytes_per_sample * channels);
+    std::shared_ptr<wave_peaks> peaks = l.peaks;
 
     // NOTE: this will delete[] live sample data unless wavelevel_copy_flags.copy_samples is set to true
     w.reallocate_level(level, newsamples);
@@ -2313,6 +2371,7 @@ bool op_wavetable_remove_sampledata::prepare(zzub::song& song) {
         CopySamples(copybuffer, dst, pos, format, format, channels, channels, 1, 1);
         CopySamples(copybuffer, dst, numsamples - (pos + samples), format, format, channels, channels, (pos + samples) * channels + 1, pos * channels + 1);
     }
+    invalidate_wave_peaks(w, l, peaks, pos);
     // Don't know if this is right?
     switch (format) {
     case 0:
@@ -18,6 +18,7 @@
 
 #include "libzzub/common.h"
 #include <functional>
+#include <limits>
 #include <algorithm>
 #include <cctype>
 #include <ctime>
@@ -26,6 +27,8 @@
 
 
 #include "libzzub/waveimport.h"
+#include "libzzub/recorder/file_recorder.h"
+#include "libzzub/ccm.h"
 
 #include <dirent.h>
 #include <sys/stat.h>
@@ -41,6 +44,14 @@ namespace zzub {
 
 player::player() {
     swap_operations_commit = false;
+    user_events_dropped = 0;
+    is_rendering_offline = false;
+    is_render_cancelled = false;
+    last_async_save_id = 0;
+    scanning_plugins = false;
+    plugin_refresh_done = false;
+    plugin_refresh_cancel = false;
+    block_size_setting = zzub::buffer_size;
 
     history_position = history.begin();
 
@@ -48,6 +59,9 @@ player::player() {
 
 
 player::~player(void) {
+    finish_async_saves(true, false);
+    finish_plugin_refresh(true);
+
     if (front.plugins[0] != 0) {
         front.plugins[0]->plugin->destroy();
         delete front.plugins[0]->callbacks;
@@ -105,16 +119,66 @@ bool player::initialize(zzub_master_event_filter* filter) {
 
 
 void player::load_plugin_library(const std::string &fullpath) {
-    int dpos=(int)fullpath.find_last_of('.');
-    string fileExtension = fullpath.substr(dpos);
-    if (fileExtension == ".so") {
+    load_plugin_libraries(std::vector<std::string>(1, fullpath));
+}
+
+
+/*	\brief Loads the plugin libraries in paths on a thread pool.
+
+    Unchanged libraries are restored from the plugin cache, the rest are loaded and
+    initialized in parallel. Their infos are registered afterwards in the order of paths,
+    so the plugin list is the same as with serial loading.
+   */
+void player::load_plugin_libraries(const std::vector<std::string>& paths) {
+    struct scanned_library {
+        std::string path;
+        struct stat statinfo;
+        plugin_cache::library* entry;
+        pluginlib* lib;
+    };
+
+    std::vector<scanned_library> libs;
+    for (size_t i = 0; i < paths.size(); i++) {
+        const std::string& fullpath = paths[i];
+        int dpos = (int)fullpath.find_last_of('.');
+        if (dpos < 0 || fullpath.substr(dpos) != ".so") continue;
+
+        scanned_library l;
+        if (stat(fullpath.c_str(), &l.statinfo)) continue;
+        l.path = fullpath;
+        l.entry = plugins_cache.find(fullpath, l.statinfo.st_mtime, l.statinfo.st_size);
+        l.lib = 0;
+        libs.push_back(l);
+    }
+
+    scanning_plugins = true;
+    run_parallel((int)libs.size(), [&](int i) {
+        scanned_library& l = libs[i];
+
+        // unchanged libraries register their infos from the cache and are loaded later
+        if (l.entry) {
+            l.lib = new pluginlib(l.path, *this, l.entry->infos);
+            if (l.lib->lazy) return;
+            delete l.lib;
+        }
+
         // machine loaders will be registered by lib through registerMachineLoader,
         // now and during loading of songs
-        pluginlib* l = new pluginlib(fullpath, *this);
-        if (l->collection != 0)
-            plugin_libraries.push_back(l);
-        else
-            delete l;
+        l.lib = new pluginlib(l.path, *this);
+        if (l.lib->collection == 0) {
+            delete l.lib;
+            l.lib = 0;
+        }
+    }, nullptr);
+    scanning_plugins = false;
+
+    for (size_t i = 0; i < libs.size(); i++) {
+        scanned_library& l = libs[i];
+        if (!l.lib) continue;
+        if (!l.lib->lazy)
+            plugins_cache.store(l.path, l.statinfo.st_mtime, l.statinfo.st_size, l.lib->loaders);
+        l.lib->publish_infos();
+        plugin_libraries.push_back(l.lib);
     }
 }
 
@@ -127,6 +191,7 @@ void player::initialize_plugin_directory(std::string folder) {
     int n;
 
     string searchPath=folder;
+    vector<string> paths;
 
     n = scandir(searchPath.c_str(), &namelist, 0, alphasort);
     if (n < 0)
@@ -138,7 +203,7 @@ void player::initialize_plugin_directory(std::string folder) {
             {
                 if (!S_ISDIR(statinfo.st_mode))
                 {
-                    load_plugin_library(fullFilePath);
+                    paths.push_back(fullFilePath);
                 }
             }
             free(namelist[n]);
@@ -146,6 +211,7 @@ void player::initialize_plugin_directory(std::string folder) {
         free(namelist);
     }
 
+    load_plugin_libraries(paths);
 }
 
 
@@ -156,11 +222,47 @@ void player::initialize_plugin_libraries() {
     plugin_libraries.push_back(new pluginlib("output", *this, &outputPluginCollection));
     // add recorder collection
     plugin_libraries.push_back(new pluginlib("recorder", *this, &recorderPluginCollection));
+#if defined(ZZUB_RTCHECK)
+    // add the plugin that shows the real time checker works
+    plugin_libraries.push_back(new pluginlib("rtcheck", *this, &rtcheckPluginCollection));
+#endif
 
     // initialize rest like usual
+    plugins_cache.load();
     for (size_t i = 0; i < plugin_folders.size(); i++) {
         initialize_plugin_directory(plugin_folders[i]);
     }
+    plugins_cache.save_async();
+
+    // the libraries restored from the cache are loaded in the background, so plugins that were
+    // installed, removed or updated since the cache was written show up in this session
+    std::vector<pluginlib*> lazy_libraries;
+    for (size_t i = 0; i < plugin_libraries.size(); i++)
+        if (plugin_libraries[i]->lazy) lazy_libraries.push_back(plugin_libraries[i]);
+    if (lazy_libraries.empty()) return;
+
+    plugin_refresh_thread = std::thread([this, lazy_libraries] {
+        for (size_t i = 0; i < lazy_libraries.size() && !plugin_refresh_cancel.load(); i++)
+            lazy_libraries[i]->load_lazy_dll();
+        plugin_refresh_done.store(true, std::memory_order_release);
+    });
+}
+
+
+/*	rief Publishes the infos of the libraries loaded by the background refresh.
+
+    Called from process_user_event_queue() when the refresh is done, and with cancel
+    set by the destructor, which stops the refresh after the library being loaded.
+   */
+void player::finish_plugin_refresh(bool cancel) {
+    if (!plugin_refresh_thread.joinable()) return;
+    if (cancel) plugin_refresh_cancel.store(true);
+    plugin_refresh_thread.join();
+    plugin_refresh_done.store(false);
+    if (cancel) return;
+
+    for (size_t i = 0; i < plugin_libraries.size(); i++)
+        if (plugin_libraries[i]->lazy && plugin_libraries[i]->dll_loaded) plugin_libraries[i]->publish_loaded_infos();
 }
 
 
@@ -200,6 +302,261 @@ void player::set_play_position(int pos) {
     // NOTE: also see note for player::set_state(). the same stuff goes on here too.
 }
 
+/*	\brief Selects serial or parallel processing of the plugin graph.
+
+    The audio thread holds swap_lock while it generates audio, so the worker pool
+    is never reconfigured in the middle of a cycle.
+   */
+void player::set_work_mode(work_mode mode, int thread_count) {
+    swap_lock.lock();
+    // the restarted workers claim new trace rings
+    if (front.tracer.enabled)
+        front.tracer.reserve(thread_count);
+    front.scheduler.configure(mode, thread_count);
+    swap_lock.unlock();
+}
+
+
+/*	\brief Sets the largest chunk the mixer processes at once, 0 follows the driver buffer size.
+
+    Plugins without plugin_flag_large_blocks get the chunk in pieces of buffer_size, and
+    feedback connections are delayed by a block. Following the driver takes effect when
+    the next device is created.
+   */
+void player::set_block_size(int size) {
+    block_size_setting = size;
+    apply_block_size(size != 0 ? size : work_buffersize);
+}
+
+int player::get_block_size() {
+    return front.block_size;
+}
+
+// reallocates the work buffers and feedback histories while the audio thread is locked out
+void player::apply_block_size(int size) {
+    size = std::max(1, std::min(size, zzub::max_block_size));
+    if (size == front.block_size) return;
+
+    swap_lock.lock();
+    front.set_block_size(size);
+    // plugins copied to the back buffer since the last swap are not in the front song yet
+    for (size_t i = 0; i < back.plugins.size(); i++) {
+        if (back.plugins[i] == 0 || back.plugins[i]->callbacks->feedback_buffer.empty()) continue;
+        back.plugins[i]->callbacks->enable_feedback_history();
+    }
+    swap_lock.unlock();
+}
+
+
+/*	\brief Starts or stops tracing the work on the audio and worker threads.
+
+    Enabling forgets the records and statistics of an earlier session. There is a ring
+    for the audio thread, each worker and a thread calling render_offline().
+   */
+void player::set_tracing(bool enable) {
+    if (enable)
+        front.tracer.enable(front.scheduler.get_thread_count() + 2);
+    else
+        front.tracer.disable();
+}
+
+
+/*	\brief Writes the records traced since the last save as Chrome trace json.
+
+    Plugin events are named after the plugins, the names are looked up when saving so
+    plugins deleted since show up by id. Returns the number of records or -1.
+   */
+int player::save_trace(const std::string& path) {
+    // the names are copied so the audio thread is not held up while the file is written
+    std::vector<std::string> names;
+    swap_lock.lock();
+    names.resize(front.plugins.size());
+    for (size_t i = 0; i < front.plugins.size(); i++)
+        if (front.plugins[i]) names[i] = front.plugins[i]->name;
+    swap_lock.unlock();
+
+    return front.tracer.save_chrome_trace(path, [&names](int id) {
+        if (id >= 0 && id < (int)names.size() && !names[id].empty())
+            return names[id];
+        return "plugin " + std::to_string(id);
+    });
+}
+
+
+/*	\brief Returns the median, 99th percentile and maximum of the traced process_stereo()
+    times of a plugin in seconds, and the number of traced calls.
+   */
+int player::get_plugin_work_time_stats(int plugin_id, float& p50, float& p99, float& max) {
+    front.tracer.drain();
+
+    std::lock_guard<std::mutex> lock(front.tracer.drain_lock);
+    std::map<int, trace_histogram>::const_iterator i = front.tracer.plugin_histograms.find(plugin_id);
+    if (i == front.tracer.plugin_histograms.end()) {
+        p50 = p99 = max = 0;
+        return 0;
+    }
+    p50 = i->second.percentile(0.5) / 1e9f;
+    p99 = i->second.percentile(0.99) / 1e9f;
+    max = i->second.max / 1e9f;
+    return (int)i->second.count;
+}
+
+
+/*	\brief Renders the song from row start up to row end into a wave file, as fast as possible.
+
+    The song is processed on the calling thread, and on the worker threads in parallel work
+    mode, while the audio driver gets silence. progress is invoked on every new row with the
+    row and the rendered fraction; returning false, or calling cancel_render() from another
+    thread, stops the render. Afterwards the player is stopped at its previous position.
+    Returns 0 when done, 1 when cancelled and -1 if the file could not be written.
+   */
+int player::render_offline(int start, int end, const std::string& path, wave_buffer_type format, std::function<bool(int, float)> progress) {
+    if (start < 0 || end <= start) return -1;
+
+    zzub::file_recorder recorder(path, format, front.master_info.samples_per_second, 2);
+    recorder.set_blocking(true);
+    if (!recorder.open()) return -1;
+
+    swap_lock.lock();
+    is_rendering_offline = true;
+    is_render_cancelled = false;
+
+    player_state prev_state = front.state;
+    int prev_position = front.song_position;
+    int prev_loop_enabled = front.song_loop_enabled;
+    int prev_loop_end = front.song_loop_end;
+
+    // play straight through, the end is checked here instead of by the sequencer
+    front.song_loop_enabled = true;
+    front.song_loop_end = std::numeric_limits<int>::max();
+    front.set_state(player_state_stopped);
+    front.set_play_position(start);
+    front.set_state(player_state_playing);
+
+    int prev_block_size = front.block_size;
+    bool has_feedback = false;
+    for (size_t i = 0; i < front.plugins.size(); i++)
+        if (front.plugins[i] != 0 && front.plugins[i]->keeps_feedback_history)
+            has_feedback = true;
+    if (!has_feedback)
+        front.set_block_size(zzub::max_block_size);
+
+    // output plugins write to a scratch buffer that is never used
+    std::vector<float> output_buffer(front.block_size);
+    for (int i = 0; i < audiodriver::MAX_CHANNELS; i++) {
+        front.outputBuffer[i] = &output_buffer.front();
+        front.inputBuffer[i] = 0;
+    }
+    swap_lock.unlock();
+
+    int result = 0;
+    int last_position = start;
+    for (;;) {
+        swap_lock.lock();
+        if (front.state != player_state_playing || (front.master_info.tick_position == 0 && front.song_position >= end)) {
+            swap_lock.unlock();
+            break;
+        }
+
+        int chunk_size = front.generate_audio(front.block_size);
+        metaplugin& masterplugin = front.get_plugin(0);
+        float* master[] = { masterplugin.work_buffer[0], masterplugin.work_buffer[1] };
+        recorder.write(master, chunk_size);
+        int position = front.song_position;
+        swap_lock.unlock();
+
+        if (position != last_position) {
+            last_position = position;
+            process_user_event_queue();
+            if (progress && !progress(position, float(position - start) / float(end - start)))
+                is_render_cancelled = true;
+        }
+
+        if (is_render_cancelled) {
+            result = 1;
+            break;
+        }
+    }
+
+    swap_lock.lock();
+    front.set_state(player_state_stopped);
+    front.song_loop_enabled = prev_loop_enabled;
+    front.song_loop_end = prev_loop_end;
+    front.set_play_position(prev_position);
+    front.set_block_size(prev_block_size);
+    is_rendering_offline = false;
+    swap_lock.unlock();
+
+    recorder.close(true);
+
+    if (prev_state != player_state_stopped) {
+        zzub_event_data event_data;
+        event_data.type = event_type_player_state_changed;
+        event_data.player_state_changed.player_state = player_state_stopped;
+        front.plugin_invoke_event(0, event_data, true);
+    }
+    return result;
+}
+
+void player::cancel_render() {
+    is_render_cancelled = true;
+}
+
+
+/*	\brief Saves the song to a ccm file on a background thread.
+
+    The song is walked and copied on the calling thread, except for the sample data, which is
+    retained until the save is done. FLAC encoding, compression and disk writes then run on a
+    new thread while the song can be edited and played. The returned id is passed back in a
+    save_complete event from process_user_event_queue().
+   */
+int player::save_ccm_async(const std::string& path) {
+    async_save* s = new async_save();
+    s->writer = new CcmWriter();
+    if (!s->writer->snapshot(this)) {
+        delete s->writer;
+        delete s;
+        return -1;
+    }
+
+    retain_samples();
+    s->id = ++last_async_save_id;
+    s->path = path;
+    s->done = false;
+    s->result = false;
+    s->thread = std::thread([s] {
+        s->result = s->writer->write(s->path, nullptr);
+        s->done = true;
+    });
+    async_saves.push_back(s);
+    return s->id;
+}
+
+/*	\brief Joins background saves that are done, or all of them if wait is set.
+   */
+void player::finish_async_saves(bool wait, bool send_events) {
+    for (size_t i = 0; i < async_saves.size(); ) {
+        async_save* s = async_saves[i];
+        if (!wait && !s->done) {
+            i++;
+            continue;
+        }
+
+        s->thread.join();
+        async_saves.erase(async_saves.begin() + i);
+        release_samples();
+
+        zzub_event_data event_data = { event_type_save_complete };
+        event_data.save_complete.id = s->id;
+        event_data.save_complete.result = s->result ? 0 : -1;
+        delete s->writer;
+        delete s;
+
+        // the handler may start a new save
+        if (send_events) front.plugin_invoke_event(0, event_data, true);
+    }
+}
+
 
 /*	\brief Clears all data associated with current song from the player.
    */
@@ -212,6 +569,8 @@ void player::clear() {
     front.midi_mappings.clear();
     front.keyjazz.clear();
     front.sequencer_tracks.clear();
+    front.plugin_sequencer_tracks.clear();
+    front.sequencer_cursors.clear();
     front.midi_plugin = -1;
     //front.user_event_queue_read = 0;
     //front.user_event_queue_write = 0;
@@ -309,14 +668,36 @@ void player::samplerate_changed() {
 }
 
 
+void player::buffersize_changed() {
+    if (block_size_setting == 0)
+        apply_block_size(work_buffersize);
+}
+
+
 void player::work_stereo(int sample_count) {
     using namespace std;
+    rtcheck_scope rt;
     work_buffer_position = 0;
     int remaining_samples = sample_count;
     while (remaining_samples > 0) {
         // handle serialized editing
-        poll_operations();
-        swap_lock.lock();
+        {
+            trace_scope scope(front.tracer, trace_kind_poll);
+            poll_operations();
+        }
+        {
+            // the user thread holds the lock while it renders or reconfigures the workers
+            rtcheck_allow allow;
+            trace_scope scope(front.tracer, trace_kind_swap_wait);
+            swap_lock.lock();
+        }
+        // render_offline() owns the song, the driver gets silence until it is done
+        if (is_rendering_offline) {
+            for (int i = 0; i < work_out_channel_count; i++)
+                memset(&work_out_buffer[i][work_buffer_position], 0, remaining_samples * sizeof(float));
+            swap_lock.unlock();
+            break;
+        }
         // handle MIDI input
         if (midiDriver)
             midiDriver->poll();
@@ -336,8 +717,8 @@ void player::work_stereo(int sample_count) {
         // the master plugins work_buffer has the final output
         // users can add Audio Output-plugins to send output to channels > 2
         metaplugin& masterplugin = front.get_plugin(0);
-        memcpy(&work_out_buffer[work_master_channel*2+0][work_buffer_position], &masterplugin.work_buffer[0].front(), chunk_size * sizeof(float));
-        memcpy(&work_out_buffer[work_master_channel*2+1][work_buffer_position], &masterplugin.work_buffer[1].front(), chunk_size * sizeof(float));
+        memcpy(&work_out_buffer[work_master_channel*2+0][work_buffer_position], masterplugin.work_buffer[0], chunk_size * sizeof(float));
+        memcpy(&work_out_buffer[work_master_channel*2+1][work_buffer_position], masterplugin.work_buffer[1], chunk_size * sizeof(float));
         work_buffer_position += chunk_size;
         remaining_samples -= chunk_size;
         swap_lock.unlock();
@@ -351,7 +732,10 @@ void player::work_stereo(int sample_count) {
             load = (m.cpu_load_time * double(front.master_info.samples_per_second)) / double(m.cpu_load_buffersize);
         else
             load = 0;
-        m.cpu_load += 0.1 * (load - m.cpu_load);
+        if (m.is_sleeping)
+            m.cpu_load = 0;
+        else
+            m.cpu_load += 0.1 * (load - m.cpu_load);
         m.cpu_load_time = 0;
         m.cpu_load_buffersize = 0;
     }
@@ -488,12 +872,31 @@ void player::end_plugin_operation(int plugin_id) {
 
   */
 void player::process_user_event_queue() {
-    while (front.user_event_queue_read != front.user_event_queue_write) {
-        event_message& message = front.user_event_queue[front.user_event_queue_read];
-        if (message.event != 0) message.event->invoke(message.data);
-        if (front.user_event_queue_read == front.user_event_queue.size() - 1)
-            front.user_event_queue_read = 0; else
-            front.user_event_queue_read++;
+    const int batch_size = 64;
+    event_message messages[batch_size];
+
+    finish_async_saves(false, true);
+
+    if (plugin_refresh_done.load(std::memory_order_acquire))
+        finish_plugin_refresh(false);
+
+    int count;
+    do {
+        count = front.user_events.pop_batch(messages, batch_size);
+        for (int i = 0; i < count; i++) {
+            if (messages[i].event != 0) messages[i].event->invoke(messages[i].data);
+        }
+    } while (count == batch_size);
+
+    // the trace rings only hold a fraction of a second, they are emptied on every call
+    if (front.tracer.enabled.load(std::memory_order_relaxed))
+        front.tracer.drain();
+
+    // events are dropped rather than blocking the audio thread when the queue is full
+    size_t dropped = front.user_events.get_dropped_count();
+    if (dropped != user_events_dropped) {
+        std::cout << "warning: user event queue overflow, " << (dropped - user_events_dropped) << " events dropped. need more calls to zzub_player_handle_events()!" << std::endl;
+        user_events_dropped = dropped;
     }
 }
 
@@ -515,7 +918,7 @@ void player::plugin_set_parameter(int plugin_id, int group, int track, int colum
     if (immediate) {
         zzub::pattern state;
         front.create_pattern(state, plugin_id, 1);
-        state.groups[group][track][column][0] = value;
+        state.value(group, track, column, 0) = value;
         front.transfer_plugin_parameter_row(plugin_id, group, state, front.plugins[plugin_id]->state_write, 0, 0, false);
         if (record)
             front.transfer_plugin_parameter_row(plugin_id, group, state, front.plugins[plugin_id]->state_automation, 0, 0, false);
@@ -753,13 +1156,39 @@ void player::plugin_set_pattern_value(int id, int pattern, int group, int track,
     op_pattern_edit* redo = new op_pattern_edit(id, pattern, group, track, column, row, value);
     merge_backbuffer_flags(redo->copy_flags);
     begin_plugin_operation(id);
-    int prevvalue = back.plugins[id]->patterns[pattern]->groups[group][track][column][row];
+    int prevvalue = back.plugins[id]->patterns[pattern]->value(group, track, column, row);
     op_pattern_edit* undo = new op_pattern_edit(id, pattern, group, track, column, row, prevvalue);
     prepare_operation_undo(undo);
     prepare_operation_redo(redo);
     end_plugin_operation(id);
 }
 
+// cells holds count tuples of group, track, column, row and value. only the cells that change
+// are stored, in one redo and one undo operation.
+void player::plugin_set_pattern_values(int id, int pattern, const int* cells, int count) {
+    zzub::pattern& p = *back.plugins[id]->patterns[pattern];
+    std::vector<op_pattern_edit_block::cell> redo_cells, undo_cells;
+    redo_cells.reserve(count);
+    undo_cells.reserve(count);
+    for (int i = 0; i < count; i++) {
+        op_pattern_edit_block::cell c = { cells[i * 5 + 0], cells[i * 5 + 1], cells[i * 5 + 2], cells[i * 5 + 3], cells[i * 5 + 4] };
+        int prevvalue = p.value(c.group, c.track, c.column, c.row);
+        if (prevvalue == c.value) continue;
+        redo_cells.push_back(c);
+        c.value = prevvalue;
+        undo_cells.push_back(c);
+    }
+    if (redo_cells.empty()) return;
+
+    op_pattern_edit_block* redo = new op_pattern_edit_block(id, pattern, redo_cells);
+    merge_backbuffer_flags(redo->copy_flags);
+    begin_plugin_operation(id);
+    op_pattern_edit_block* undo = new op_pattern_edit_block(id, pattern, undo_cells);
+    prepare_operation_undo(undo);
+    prepare_operation_redo(redo);
+    end_plugin_operation(id);
+}
+
 void player::plugin_insert_pattern_rows(int plugin_id, int pattern, int* column_indices, int num_indices, int start, int rows) {
     operation_copy_flags flags;
     flags.copy_plugins = true;
@@ -777,7 +1206,7 @@ void player::plugin_insert_pattern_rows(int plugin_id, int pattern, int* column_
         int column = column_indices[i * 3 + 2];
         int first_overflow_row = p.rows - rows;
         for (int j = 0; j < rows; j++) {
-            int v = p.groups[group][track][column][first_overflow_row + j];
+            int v = p.value(group, track, column, first_overflow_row + j);
             op_pattern_edit* undo_edit = new op_pattern_edit(plugin_id, pattern, group, track, column, first_overflow_row + j, v);
             prepare_operation_undo(undo_edit);
         }
@@ -807,7 +1236,7 @@ void player::plugin_remove_pattern_rows(int plugin_id, int pattern, int* column_
         int track = column_indices[i * 3 + 1];
         int column = column_indices[i * 3 + 2];
         for (int j = 0; j < rows; j++) {
-            int v = p.groups[group][track][column][start + j];
+            int v = p.value(group, track, column, start + j);
             op_pattern_edit* undo_edit = new op_pattern_edit(plugin_id, pattern, group, track, column, start + j, v);
             prepare_operation_undo(undo_edit);
         }
@@ -1473,35 +1902,43 @@ void player::wave_set_envelopes(int wave, const vector<zzub::envelope_entry>& en
 
 
 zzub_event_data_t *zzub_flatapi_player::pop_event() {
-    if (read_event_queue == write_event_queue)
+    zzub_event_data_t* result;
+    if (pop_events(&result, 1) == 0)
         return NULL;
-    zzub_event_data_t *result = &event_queue[read_event_queue];
-    read_event_queue++;
-    if (read_event_queue == event_queue.size())
-        read_event_queue = 0;
     return result;
 }
 
-void zzub_flatapi_player::push_event(zzub_event_data_t &data) {
-    event_queue[write_event_queue] = data;
-    write_event_queue++;
-    if (write_event_queue == event_queue.size())
-        write_event_queue = 0;
-    if (write_event_queue == read_event_queue) {
-        std::cout << "warning: event queue overflow. need more calls to zzub_player_get_next_event()!" << std::endl;
-        std::cout << "read event queue: " << event_queue.size() << std::endl;
-        for(int i=read_event_queue; (i%event_queue.size()) != write_event_queue; i++) {
-            std::cout  << "event " << i << " type: " << data.type << std::endl;
-        }
+int zzub_flatapi_player::pop_events(zzub_event_data_t** events, int max_count) {
+    if (max_count <= 0) return 0;
+    if ((int)event_batch.size() < max_count) {
+        event_batch.resize(max_count);
+        message_batch.resize(max_count);
+    }
+
+    int count = event_queue.pop_batch(&message_batch.front(), max_count);
+    for (int i = 0; i < count; i++) {
+        event_batch[i] = message_batch[i].data;
+        events[i] = &event_batch[i];
+    }
+
+    size_t dropped = event_queue.get_dropped_count();
+    if (dropped != events_dropped) {
+        std::cout << "warning: event queue overflow, " << (dropped - events_dropped) << " events dropped. need more calls to zzub_player_get_next_event()!" << std::endl;
+        events_dropped = dropped;
     }
+    return count;
+}
+
+void zzub_flatapi_player::push_event(zzub_event_data_t &data) {
+    zzub::event_message message = { -1, 0, data };
+    event_queue.push(message);
 }
 
-zzub_flatapi_player::zzub_flatapi_player() {
+zzub_flatapi_player::zzub_flatapi_player()
+{
     callback = 0;
     callbackTag = 0;
-    event_queue.resize(4096);
-    read_event_queue = 0;
-    write_event_queue = 0;
+    events_dropped = 0;
     //driver.initialize(this);
     _midiDriver.initialize(this);
 }
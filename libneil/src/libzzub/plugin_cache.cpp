@@ -0,0 +1,395 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include "libzzub/common.h"
+#include "libzzub/streams.h"
+#include "zzub/signature.h"
+
+#include <sys/stat.h>
+
+namespace zzub {
+
+using namespace std;
+
+namespace {
+
+const char cache_magic[] = "zzpc";
+const int cache_version = 1;
+
+// bounds checked reads from a cache file, a truncated or damaged file reads as invalid
+struct cache_reader {
+    const vector<char>& bytes;
+    size_t pos;
+    bool ok;
+
+    cache_reader(const vector<char>& b) : bytes(b), pos(0), ok(true) { }
+
+    template <typename T>
+    T read() {
+        T value = T();
+        if (!ok || bytes.size() - pos < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, &bytes[pos], sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    std::string read_string() {
+        size_t end = pos;
+        while (end < bytes.size() && bytes[end] != 0) end++;
+        if (!ok || end == bytes.size()) {
+            ok = false;
+            return "";
+        }
+        std::string s(&bytes[pos], end - pos);
+        pos = end + 1;
+        return s;
+    }
+
+    int read_count() {
+        int count = read<int>();
+        if (count < 0 || count > (int)(bytes.size() - pos)) ok = false;
+        return ok ? count : 0;
+    }
+};
+
+// parameter names and descriptions may be null
+void write_name(outstream& outf, const char* name) {
+    outf.write<char>(name != 0);
+    if (name) outf.write(name);
+}
+
+const char* read_name(cache_reader& r, cached_info& info) {
+    if (!r.read<char>()) return 0;
+    info.strings.push_back(r.read_string());
+    return info.strings.back().c_str();
+}
+
+void write_parameters(outstream& outf, const vector<const parameter*>& params) {
+    outf.write<int>((int)params.size());
+    for (size_t i = 0; i < params.size(); i++) {
+        const parameter* p = params[i];
+        outf.write<int>(p->type);
+        write_name(outf, p->name);
+        write_name(outf, p->description);
+        outf.write<int>(p->value_min);
+        outf.write<int>(p->value_max);
+        outf.write<int>(p->value_none);
+        outf.write<int>(p->flags);
+        outf.write<int>(p->value_default);
+    }
+}
+
+void read_parameters(cache_reader& r, cached_info& info, vector<const parameter*>& params) {
+    int count = r.read_count();
+    for (int i = 0; i < count && r.ok; i++) {
+        parameter* p = new parameter();
+        params.push_back(p);
+        p->type = (parameter_type)r.read<int>();
+        p->name = read_name(r, info);
+        p->description = read_name(r, info);
+        p->value_min = r.read<int>();
+        p->value_max = r.read<int>();
+        p->value_none = r.read<int>();
+        p->flags = r.read<int>();
+        p->value_default = r.read<int>();
+    }
+}
+
+void write_strings(outstream& outf, const vector<string>& strings) {
+    outf.write<int>((int)strings.size());
+    for (size_t i = 0; i < strings.size(); i++)
+        outf.write(strings[i].c_str());
+}
+
+void read_strings(cache_reader& r, vector<string>& strings) {
+    int count = r.read_count();
+    for (int i = 0; i < count && r.ok; i++)
+        strings.push_back(r.read_string());
+}
+
+bool same_parameters(const vector<const parameter*>& a, const vector<const parameter*>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i]->type != b[i]->type || a[i]->flags != b[i]->flags ||
+            a[i]->value_min != b[i]->value_min || a[i]->value_max != b[i]->value_max ||
+            a[i]->value_none != b[i]->value_none || a[i]->value_default != b[i]->value_default)
+            return false;
+    }
+    return true;
+}
+
+string default_cache_path() {
+    const char* path = getenv("ZZUB_PLUGIN_CACHE");
+    if (path) return path;
+    const char* home = getenv("HOME");
+    if (!home || !*home) return "";
+    return string(home) + "/.neil/plugins.cache";
+}
+
+}
+
+/*! \struct cached_info
+    \brief A plugin info restored from the plugin cache.
+*/
+
+const zzub::info* cached_info::resolve() const {
+    if (!loaded) {
+        lib->ensure_loaded();
+        if (!loaded)
+            std::cerr << "plugin cache: " << lib->fileName << " no longer has " << uri << std::endl;
+    }
+    return loaded;
+}
+
+bool cached_info::matches(const zzub::info& loaded) const {
+    return flags == loaded.flags &&
+        min_tracks == loaded.min_tracks && max_tracks == loaded.max_tracks &&
+        attributes.size() == loaded.attributes.size() &&
+        same_parameters(global_parameters, loaded.global_parameters) &&
+        same_parameters(track_parameters, loaded.track_parameters) &&
+        same_parameters(controller_parameters, loaded.controller_parameters);
+}
+
+zzub::plugin* cached_info::create_plugin() const {
+    const zzub::info* info = resolve();
+    return info ? info->create_plugin() : 0;
+}
+
+bool cached_info::store_info(zzub::archive* arc) const {
+    const zzub::info* info = resolve();
+    return info ? info->store_info(arc) : false;
+}
+
+const zzub::info* resolve_info(const zzub::info* info) {
+    const cached_info* cached = dynamic_cast<const cached_info*>(info);
+    if (!cached) return info;
+    if (!cached->has_plugin_lib && !cached->loaded) return info;
+    return cached->resolve();
+}
+
+/*! \struct plugin_cache
+    \brief Keeps the plugin infos of the plugin libraries between sessions.
+*/
+
+plugin_cache::plugin_cache() {
+    path = default_cache_path();
+    dirty = false;
+}
+
+plugin_cache::~plugin_cache() {
+    wait();
+}
+
+void plugin_cache::load() {
+    libraries.clear();
+    if (path.empty()) return;
+
+    file_instream inf;
+    if (!inf.open(path.c_str())) return;
+    vector<char> bytes(inf.size());
+    if (!bytes.empty()) inf.read(&bytes.front(), (int)bytes.size());
+    inf.close();
+
+    cache_reader r(bytes);
+    if (r.read_string() != cache_magic || r.read<int>() != cache_version || r.read_string() != ZZUB_SIGNATURE)
+        return;
+
+    int count = r.read_count();
+    for (int i = 0; i < count && r.ok; i++) {
+        string fileName = r.read_string();
+        library entry;
+        entry.mtime = r.read<long long>();
+        entry.size = r.read<long long>();
+        entry.used = false;
+        int size = r.read_count();
+        if (!r.ok) break;
+        entry.infos.assign(bytes.begin() + r.pos, bytes.begin() + r.pos + size);
+        r.pos += size;
+        libraries[fileName] = entry;
+    }
+
+    if (!r.ok) {
+        std::cerr << "plugin cache: " << path << " is damaged, plugins will be rescanned" << std::endl;
+        libraries.clear();
+    }
+}
+
+plugin_cache::library* plugin_cache::find(const std::string& fileName, long long mtime, long long size) {
+    map<string, library>::iterator i = libraries.find(fileName);
+    if (i == libraries.end() || i->second.mtime != mtime || i->second.size != size)
+        return 0;
+    i->second.used = true;
+    return &i->second;
+}
+
+bool plugin_cache::store(const std::string& fileName, long long mtime, long long size, const std::list<const zzub::info*>& infos) {
+    library entry;
+    entry.mtime = mtime;
+    entry.size = size;
+    entry.used = true;
+    write_infos(entry.infos, infos);
+
+    map<string, library>::iterator i = libraries.find(fileName);
+    if (i != libraries.end() && i->second.mtime == mtime && i->second.size == size && i->second.infos == entry.infos) {
+        i->second.used = true;
+        return false;
+    }
+
+    libraries[fileName] = entry;
+    dirty = true;
+    return true;
+}
+
+void plugin_cache::save_async() {
+    if (!dirty || path.empty()) return;
+    dirty = false;
+
+    // the entries are serialized here, the thread only touches its own copy
+    vector<char> bytes;
+    mem_outstream mem(bytes);
+    outstream& outf = mem;
+    outf.write(cache_magic);
+    outf.write<int>(cache_version);
+    outf.write(ZZUB_SIGNATURE);
+
+    int count = 0;
+    for (map<string, library>::iterator i = libraries.begin(); i != libraries.end(); ++i)
+        if (i->second.used) count++;
+    outf.write<int>(count);
+    for (map<string, library>::iterator i = libraries.begin(); i != libraries.end(); ++i) {
+        if (!i->second.used) continue;
+        outf.write(i->first.c_str());
+        outf.write<long long>(i->second.mtime);
+        outf.write<long long>(i->second.size);
+        outf.write<int>((int)i->second.infos.size());
+        if (!i->second.infos.empty())
+            outf.write((void*)&i->second.infos.front(), (int)i->second.infos.size());
+    }
+
+    wait();
+    string fileName = path;
+    save_thread = std::thread([fileName, bytes = std::move(bytes)] {
+        size_t slash = fileName.find_last_of('/');
+        if (slash != string::npos && slash > 0)
+            mkdir(fileName.substr(0, slash).c_str(), 0755);
+
+        // write to a temporary file first, so a crash never leaves a half written cache
+        string tempName = fileName + ".tmp";
+        file_outstream outf;
+        if (!outf.create(tempName.c_str())) {
+            std::cerr << "plugin cache: could not write " << tempName << std::endl;
+            return;
+        }
+        bool ok = outf.write((void*)bytes.data(), (int)bytes.size()) == 1;
+        outf.close();
+        if (!ok || rename(tempName.c_str(), fileName.c_str()) != 0) {
+            std::cerr << "plugin cache: could not write " << fileName << std::endl;
+            remove(tempName.c_str());
+        }
+    });
+}
+
+void plugin_cache::wait() {
+    if (save_thread.joinable())
+        save_thread.join();
+}
+
+void plugin_cache::write_infos(std::vector<char>& bytes, const std::list<const zzub::info*>& infos) {
+    bytes.clear();
+    mem_outstream mem(bytes);
+    outstream& outf = mem;
+    outf.write<int>((int)infos.size());
+    for (std::list<const zzub::info*>::const_iterator i = infos.begin(); i != infos.end(); ++i) {
+        const zzub::info* info = *i;
+        outf.write<int>(info->version);
+        outf.write<int>(info->flags);
+        outf.write<unsigned int>(info->min_tracks);
+        outf.write<unsigned int>(info->max_tracks);
+        outf.write(info->name.c_str());
+        outf.write(info->short_name.c_str());
+        outf.write(info->author.c_str());
+        outf.write(info->commands.c_str());
+        outf.write(info->uri.c_str());
+        outf.write<int>(info->tail_length);
+        outf.write<char>(info->plugin_lib != 0);
+
+        write_parameters(outf, info->global_parameters);
+        write_parameters(outf, info->track_parameters);
+        write_parameters(outf, info->controller_parameters);
+
+        outf.write<int>((int)info->attributes.size());
+        for (size_t j = 0; j < info->attributes.size(); j++) {
+            const attribute* a = info->attributes[j];
+            outf.write(a->name ? a->name : "");
+            outf.write<int>(a->value_min);
+            outf.write<int>(a->value_max);
+            outf.write<int>(a->value_default);
+        }
+
+        write_strings(outf, info->supported_import_extensions);
+        write_strings(outf, info->supported_stream_extensions);
+    }
+}
+
+bool plugin_cache::read_infos(const std::vector<char>& bytes, pluginlib* lib, std::vector<cached_info*>& infos) {
+    cache_reader r(bytes);
+    int count = r.read_count();
+    for (int i = 0; i < count && r.ok; i++) {
+        cached_info* info = new cached_info(lib);
+        infos.push_back(info);
+        info->version = r.read<int>();
+        info->flags = r.read<int>();
+        info->min_tracks = r.read<unsigned int>();
+        info->max_tracks = r.read<unsigned int>();
+        info->name = r.read_string();
+        info->short_name = r.read_string();
+        info->author = r.read_string();
+        info->commands = r.read_string();
+        info->uri = r.read_string();
+        info->tail_length = r.read<int>();
+        info->has_plugin_lib = r.read<char>() != 0;
+
+        read_parameters(r, *info, info->global_parameters);
+        read_parameters(r, *info, info->track_parameters);
+        read_parameters(r, *info, info->controller_parameters);
+
+        int attribute_count = r.read_count();
+        for (int j = 0; j < attribute_count && r.ok; j++) {
+            attribute& a = info->add_attribute();
+            info->strings.push_back(r.read_string());
+            a.name = info->strings.back().c_str();
+            a.value_min = r.read<int>();
+            a.value_max = r.read<int>();
+            a.value_default = r.read<int>();
+        }
+
+        read_strings(r, info->supported_import_extensions);
+        read_strings(r, info->supported_stream_extensions);
+    }
+
+    if (!r.ok) {
+        for (size_t i = 0; i < infos.size(); i++) delete infos[i];
+        infos.clear();
+    }
+    return r.ok;
+}
+
+}
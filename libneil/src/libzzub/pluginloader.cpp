@@ -24,6 +24,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "zzub/signature.h"
 #include "libzzub/player.h"
 
+#include <sys/stat.h>
+
 #ifdef POSIX
 #include <dlfcn.h>
 #endif
@@ -39,6 +41,9 @@ using namespace std;
 pluginlib::pluginlib(const std::string& _fileName, zzub::player &p, zzub::plugincollection *_collection) : player(p) {
     fileName = _fileName;
     hMachine = 0;
+    lazy = false;
+    resolving = false;
+    dll_loaded = false;
     if (_collection) { // internal
         collection = _collection;
         this->collection->initialize(this);
@@ -48,8 +53,76 @@ pluginlib::pluginlib(const std::string& _fileName, zzub::player &p, zzub::plugin
     }
 }
 
+pluginlib::pluginlib(const std::string& _fileName, zzub::player &p, const std::vector<char>& cache) : player(p) {
+    fileName = _fileName;
+    hMachine = 0;
+    collection = 0;
+    resolving = false;
+    dll_loaded = false;
+    lazy = plugin_cache::read_infos(cache, this, cached);
+    if (!player.scanning_plugins)
+        publish_infos();
+}
+
 pluginlib::~pluginlib() {
     unload();
+    for (size_t i = 0; i < cached.size(); i++)
+        delete cached[i];
+    cached.clear();
+}
+
+bool pluginlib::ensure_loaded() {
+    if (!lazy) return collection != 0;
+    load_lazy_dll();
+    publish_loaded_infos();
+    return collection != 0;
+}
+
+// loads the dll of a lazy library. runs on the user thread, or on the thread that loads the
+// lazy libraries in the background after startup (player::initialize_plugin_libraries).
+void pluginlib::load_lazy_dll() {
+    std::lock_guard<std::mutex> lock(load_lock);
+    if (dll_loaded) return;
+    resolving = true;
+    init_dll();
+    resolving = false;
+    dll_loaded = true;
+}
+
+// points the cached infos at the infos the library registered, and brings the plugin list and
+// the cache up to date. the collection may list other plugins than last time without the
+// library changing, e.g when lv2 or vst plugins were installed, removed or updated.
+void pluginlib::publish_loaded_infos() {
+    if (!lazy) return;
+    lazy = false;
+
+    for (std::list<const zzub::info*>::iterator i = loaders.begin(); i != loaders.end(); ++i) {
+        const zzub::info* info = *i;
+        std::vector<const zzub::info*>::iterator listed = player.plugin_infos.end();
+        for (size_t j = 0; j < cached.size(); j++) {
+            if (!cached[j]->loaded && cached[j]->uri == info->uri) {
+                cached[j]->loaded = info;
+                listed = find(player.plugin_infos.begin(), player.plugin_infos.end(), (const zzub::info*)cached[j]);
+                break;
+            }
+        }
+        if (listed != player.plugin_infos.end())
+            *listed = info;
+        else
+            player.plugin_infos.push_back(info);
+    }
+
+    // plugins the library no longer has. the cached infos stay alive for songs that refer to them
+    for (size_t j = 0; j < cached.size(); j++) {
+        if (cached[j]->loaded) continue;
+        player.plugin_infos.erase(remove(player.plugin_infos.begin(), player.plugin_infos.end(), (const zzub::info*)cached[j]), player.plugin_infos.end());
+    }
+
+    struct stat statinfo;
+    if (collection && !stat(fileName.c_str(), &statinfo)) {
+        if (player.plugins_cache.store(fileName, statinfo.st_mtime, statinfo.st_size, loaders))
+            player.plugins_cache.save_async();
+    }
 }
 
 void pluginlib::unload() {
@@ -118,9 +191,25 @@ void pluginlib::init_dll() {
     hMachine = 0;
 }
 
+void pluginlib::publish_infos() {
+    if (lazy) {
+        for (size_t i = 0; i < cached.size(); i++)
+            player.plugin_infos.push_back(cached[i]);
+    } else {
+        for (std::list<const zzub::info*>::iterator i = loaders.begin(); i != loaders.end(); ++i)
+            player.plugin_infos.push_back(*i);
+    }
+}
+
 void pluginlib::register_info(const zzub::info *_info) {
     // add a pluginloader for this info struct
     loaders.push_back(_info);
+
+    // libraries are scanned in parallel, the player publishes them in order afterwards.
+    // lazy libraries publish on the user thread once they are loaded.
+    if (resolving || player.scanning_plugins)
+        return;
+
     player.plugin_infos.push_back(_info);
 }
 
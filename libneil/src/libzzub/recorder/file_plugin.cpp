@@ -54,6 +54,18 @@ recorder_file_plugin_info::recorder_file_plugin_info()
             .set_value_min(0)
             .set_value_max(3);
 
+    add_attribute()
+            .set_name("Disk buffer (seconds)")
+            .set_value_default(2)
+            .set_value_min(1)
+            .set_value_max(30);
+
+    add_attribute()
+            .set_name("Sync to disk (0=never, 1=on close, 2=every second)")
+            .set_value_default(1)
+            .set_value_min(0)
+            .set_value_max(2);
+
 }
 
 
@@ -71,6 +83,7 @@ recorder_file_plugin::recorder_file_plugin()
     ticksWritten(0),
     updateRecording(false),
     recordingMulti(true),
+    fileRequested(false),
     format(wave_buffer_type_si16),
     waveFilePath(""),
     
@@ -95,6 +108,7 @@ recorder_file_plugin::destroy() {
 
 
     stop(); 
+    _host->remove_event_handler(_host->get_metaplugin(), this);
     delete this; 
 }
 
@@ -104,6 +118,7 @@ void
 recorder_file_plugin::init(zzub::archive *arc)
 {
     recorder.set_rate(_master_info->samples_per_second);
+    _host->set_event_handler(_host->get_metaplugin(), this);
 }
 
 
@@ -256,8 +271,8 @@ recorder_file_plugin::collect_inputs(
 ) {
 
 
-    memcpy(channel_buffers[0], pin[0], numsamples);
-    memcpy(channel_buffers[1], pin[1], numsamples);
+    memcpy(channel_buffers[0], pin[0], numsamples * sizeof(float));
+    memcpy(channel_buffers[1], pin[1], numsamples * sizeof(float));
     
     if(!recordingMulti) {
         return channel_buffers;
@@ -271,8 +286,8 @@ recorder_file_plugin::collect_inputs(
         auto& mplugin = input.plugin_proxy->_player->back.get_plugin(input.plugin_proxy->id);
 
         float* in[2] = {
-            &mplugin.work_buffer[0].front(),
-            &mplugin.work_buffer[1].front()
+            mplugin.work_buffer[0],
+            mplugin.work_buffer[1]
         };
 
         float* out[2] = {
@@ -331,11 +346,12 @@ recorder_file_plugin::process_stereo(
         updateRecording = false;
     }
     if (writeWave) {
-        if (!recorder.is_open()) {
-            prepare_recorder();
-            recorder.open();
+        // a new file is only asked for after the previous one was closed on the user thread
+        if (!fileRequested && !recorder.is_open()) {
+            post_request(request_open);
+            fileRequested = true;
         }
-        if (recorder.is_open()) {
+        if (fileRequested && recorder.is_open()) {
             if(lg.multitrack) {
                 auto& buffers = collect_inputs(pin, numsamples);
                 recorder.write(buffers.data(), numsamples);
@@ -343,14 +359,54 @@ recorder_file_plugin::process_stereo(
                 recorder.write(pin, numsamples);
             }
         }
-    } else if (recorder.is_open()) {
-        recorder.close();
+    } else if (fileRequested) {
+        post_request(request_close);
+        fileRequested = false;
     }
     return true;
 }
 
 
 
+void 
+recorder_file_plugin::post_request(
+    int request
+)
+{
+    metaplugin_proxy* proxy = _host->get_metaplugin();
+    zzub_event_data event_data = { zzub_event_type_custom };
+    event_data.custom.id = request;
+    event_data.custom.data = this;
+    proxy->_player->front.plugin_invoke_event(proxy->id, event_data, false);
+}
+
+
+
+bool 
+recorder_file_plugin::invoke(
+    zzub_event_data_t& data
+)
+{
+    if (data.type != zzub_event_type_custom || data.custom.data != this)
+        return false;
+
+    switch (data.custom.id) {
+        case request_open:
+            recorder.set_format(format);
+            recorder.set_buffer_depth((float)attributes[2]);
+            recorder.set_sync_policy((file_recorder_sync)attributes[3]);
+            prepare_recorder();
+            recorder.open();
+            return true;
+        case request_close:
+            recorder.close();
+            return true;
+    }
+    return false;
+}
+
+
+
 void 
 recorder_file_plugin::stop() {
     // if (autoWrite)
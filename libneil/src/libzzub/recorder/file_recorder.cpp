@@ -1,6 +1,10 @@
 
 #include "libzzub/recorder/file_recorder.h"
+#include <algorithm>
+#include <cstring>
 #include <sstream>
+#include <time.h>
+#include <unistd.h>
 
 namespace zzub {
 
@@ -49,24 +53,122 @@ polywav_channel_data::write(
 
 
 
+file_writer::file_writer(
+    SNDFILE* wave_file,
+    channel_data* channel_data_writer,
+    uint channels,
+    size_t depth
+)
+  : wave_file(wave_file),
+    channel_data_writer(channel_data_writer),
+    channels(channels),
+    write_frame(0),
+    read_frame(0),
+    closing(false),
+    sync_policy(file_recorder_sync_never),
+    sync_interval(0),
+    frames_since_sync(0)
+{
+    capacity = zzub::buffer_size;
+    while (capacity < depth) capacity <<= 1;
+    ring.resize(capacity * channels);
+    sem_init(&signal, 0, 0);
+}
+
+
+
+file_writer::~file_writer()
+{
+    sem_destroy(&signal);
+}
+
+
+
+void
+file_writer::drain()
+{
+    size_t r = read_frame.load(std::memory_order_relaxed);
+    size_t w = write_frame.load(std::memory_order_acquire);
+
+    while (r != w) {
+        size_t offset = r & (capacity - 1);
+        size_t frames = std::min(w - r, capacity - offset);
+        sf_writef_float(wave_file, &ring[offset * channels], frames);
+        r += frames;
+        read_frame.store(r, std::memory_order_release);
+
+        frames_since_sync += frames;
+        if (sync_policy == file_recorder_sync_periodic && frames_since_sync >= sync_interval) {
+            sf_write_sync(wave_file);
+            frames_since_sync = 0;
+        }
+    }
+}
+
+
+
+void
+file_writer::run()
+{
+    for (;;) {
+        // close() does not always post, see below
+        timespec timeout;
+        clock_gettime(CLOCK_REALTIME, &timeout);
+        timeout.tv_nsec += 100 * 1000000;
+        if (timeout.tv_nsec >= 1000000000) {
+            timeout.tv_sec++;
+            timeout.tv_nsec -= 1000000000;
+        }
+        sem_timedwait(&signal, &timeout);
+
+        // close() is called after the last write(), so everything is in the ring once closing is seen
+        bool done = closing.load(std::memory_order_acquire);
+        drain();
+        if (done)
+            break;
+    }
+
+    if (sync_policy != file_recorder_sync_never)
+        sf_write_sync(wave_file);
+
+    sf_close(wave_file);
+
+    // the channel data must exist until sf_close was called
+    delete channel_data_writer;
+}
+
+
+
+void*
+file_writer::thread_proc(
+    void* p
+)
+{
+    file_writer* writer = (file_writer*)p;
+    writer->run();
+    return 0;
+}
+
+
+
 bool 
 file_recorder::open() {
-    if (wave_file) 
+    if (writer) 
         return false;
 
+    // the previous file may still be flushed and closed, possibly under the same path
+    join_closed_writer();
+
     auto sfinfo = build_info();
     
-    wave_file = sf_open(path.c_str(), SFM_WRITE, &sfinfo);
+    SNDFILE* wave_file = sf_open(path.c_str(), SFM_WRITE, &sfinfo);
 
     if (!wave_file) {
         printf("file_recorder.open '%s' failed\n", path.c_str());
         return false;
     }
 
-    sf_samples = new float[zzub::buffer_size * channels];
-
-    // do not delete the channel_data_writer until sf_close_called
-    // the ixml string in bwf_channel_data needs to be exist until then
+    channel_data* channel_data_writer = nullptr;
     if(sfinfo.channels > 2) {
         // if(use_ibwf) {
         //      
@@ -76,7 +178,22 @@ file_recorder::open() {
         channel_data_writer->write(wave_file);
     }
 
+    size_t depth = (size_t)std::max(buffer_depth * sample_rate, (float)zzub::buffer_size);
+    file_writer* w = new file_writer(wave_file, channel_data_writer, channels, depth);
+    w->sync_policy = sync_policy;
+    w->sync_interval = (size_t)std::max(sync_interval * sample_rate, 1.0f);
 
+    if (pthread_create(&w->thread, 0, &file_writer::thread_proc, w) != 0) {
+        printf("file_recorder.open '%s' could not start the writer thread\n", path.c_str());
+        sf_close(wave_file);
+        delete channel_data_writer;
+        delete w;
+        return false;
+    }
+
+    overrun_count = 0;
+    overrun_frames = 0;
+    writer.store(w, std::memory_order_release);
     return true;
 }
 
@@ -132,49 +249,90 @@ file_recorder::write(
     int num_samples
 )
 {
-    if (!num_samples || !wave_file) 
+    file_writer* w = writer.load(std::memory_order_acquire);
+    if (!num_samples || !w) 
         return;
-        
 
-    float *p = sf_samples;
+    // a piece never exceeds the ring, or a blocking write would wait for space that never comes
+    for (int offset = 0; offset < num_samples; ) {
+        size_t count = std::min((size_t)(num_samples - offset), w->capacity);
+
+        while (w->get_free_frames() < count) {
+            if (!blocking) {
+                // the writer thread fell behind, drop the rest rather than wait for the disk
+                overrun_count.fetch_add(1, std::memory_order_relaxed);
+                overrun_frames.fetch_add(num_samples - offset, std::memory_order_relaxed);
+                return;
+            }
+            usleep(1000);
+        }
+
+        size_t pos = w->write_frame.load(std::memory_order_relaxed);
+        size_t mask = w->capacity - 1;
+        float* ring = &w->ring.front();
 
-    for (int i = 0; i < num_samples; i++) {
-        for(int c = 0; c < channels; c++) {
-            float samp = samples[c][i];
-            *p++ = std::clamp(samp, -1.0f, 1.0f);
+        for (size_t i = 0; i < count; i++) {
+            float* p = ring + ((pos + i) & mask) * channels;
+            for(uint c = 0; c < channels; c++) {
+                float samp = samples[c][offset + i];
+                *p++ = std::clamp(samp, -1.0f, 1.0f);
+            }
         }
-    }
 
-    sf_writef_float(wave_file, sf_samples, num_samples);
+        w->write_frame.store(pos + count, std::memory_order_release);
+        sem_post(&w->signal);
+        offset += (int)count;
+    }
 }
 
 
 
 void 
-file_recorder::close() {
-    if (wave_file) {
-        printf("file_recorder::close found a wave file\n");
-        sf_close(wave_file);
+file_recorder::close(
+    bool wait
+)
+{
+    file_writer* w = writer.exchange(nullptr, std::memory_order_acq_rel);
+    if (!w) {
+        // close(true) also waits for a file that was closed without waiting
+        if (wait)
+            join_closed_writer();
+        return;
+    }
 
-        if(channel_data_writer)
-            delete channel_data_writer;
+    size_t overruns = get_overrun_count();
+    if (overruns)
+        printf("file_recorder::close dropped %zu blocks (%zu frames) while recording '%s'\n", overruns, get_overrun_frames(), path.c_str());
 
-        if(sf_samples)
-            delete sf_samples;
+    w->closing.store(true, std::memory_order_release);
+    sem_post(&w->signal);
 
-        channel_data_writer = nullptr;
-        wave_file = nullptr;
-        sf_samples = nullptr;
-    }
+    join_closed_writer();
+    closed_writer = w;
+    if (wait)
+        join_closed_writer();
+}
+
+
+
+void
+file_recorder::join_closed_writer()
+{
+    if (!closed_writer)
+        return;
+
+    pthread_join(closed_writer->thread, 0);
+    delete closed_writer;
+    closed_writer = nullptr;
 }
 
 
 
 bool 
 file_recorder::is_open() const {
-    return wave_file != nullptr;
+    return writer.load(std::memory_order_acquire) != nullptr;
 }
 
 
 
-}
\ No newline at end of file
+}
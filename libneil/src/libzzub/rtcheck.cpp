@@ -0,0 +1,264 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+    The checker replaces the libc functions below for the whole process. The functions
+    check whether the calling thread is inside an rtcheck_scope and forward to libc, the
+    allocators to the __libc_ entry points and the rest to the next definition found by
+    dlsym(RTLD_NEXT). glibc only.
+
+    It is built as libzzub_rtcheck.so, which libzzub links against, and only takes effect
+    when it is preloaded with LD_PRELOAD=libzzub_rtcheck.so. Otherwise libc comes first in
+    the lookup scope and every call, even from inside libzzub, goes past the checker. this
+    is always the case when libzzub is opened with dlopen(), as the python bindings do.
+*/
+
+#if defined(ZZUB_RTCHECK)
+
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#include "libzzub/rtcheck.h"
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+// static tls, dynamic tls may allocate on the first access from a thread
+#define RTCHECK_TLS __thread __attribute__((tls_model("initial-exec")))
+
+namespace zzub {
+
+namespace {
+
+RTCHECK_TLS int rt_depth;
+RTCHECK_TLS int allow_depth;
+RTCHECK_TLS int reporting;
+RTCHECK_TLS const char* running_plugin;
+
+std::atomic<int> violations(0);
+bool abort_on_violation = false;
+bool interposed = false;					// our malloc is the one the process uses
+
+// call stacks that were reported already, so a violation in a loop is printed once
+enum { max_sites = 1024 };
+std::atomic<size_t> reported_sites[max_sites];
+
+bool first_report(size_t site) {
+    size_t start = site % max_sites;
+    for (size_t i = 0; i < max_sites; i++) {
+        std::atomic<size_t>& slot = reported_sites[(start + i) % max_sites];
+        size_t current = slot.load();
+        if (!current && slot.compare_exchange_strong(current, site)) return true;
+        if (current == site) return false;
+    }
+    return false;
+}
+
+void report(const char* call) {
+    reporting++;
+    violations.fetch_add(1);
+
+    // calls from operator new all share one return address, so the stack tells sites apart
+    void* frames[32];
+    int count = backtrace(frames, 32);
+    size_t site = 1;
+    for (int i = 1; i < count && i < 8; i++)
+        site = site * 31 + (size_t)frames[i];
+
+    if (abort_on_violation || first_report(site)) {
+        fprintf(stderr, "rtcheck: %s on a real time thread", call);
+        if (running_plugin) fprintf(stderr, " in plugin '%s'", running_plugin);
+        fprintf(stderr, "\n");
+        backtrace_symbols_fd(frames + 1, count - 1, STDERR_FILENO);
+        if (abort_on_violation) abort();
+    }
+    reporting--;
+}
+
+template <typename T>
+T next(T& fn, const char* name) {
+    if (!fn) fn = (T)dlsym(RTLD_NEXT, name);
+    return fn;
+}
+
+__attribute__((constructor)) void rtcheck_init() {
+    const char* mode = getenv("ZZUB_RTCHECK");
+    abort_on_violation = mode && strcmp(mode, "abort") == 0;
+
+    // backtrace() loads libgcc on its first call, get that done outside the audio thread
+    void* frame;
+    backtrace(&frame, 1);
+
+    Dl_info self, found;
+    void* global_malloc = dlsym(RTLD_DEFAULT, "malloc");
+    interposed = dladdr((void*)&rtcheck_init, &self) && global_malloc && dladdr(global_malloc, &found) && self.dli_fbase == found.dli_fbase;
+    if (!interposed)
+        fprintf(stderr, "rtcheck: libzzub_rtcheck.so is not preloaded, nothing is checked. run with LD_PRELOAD=libzzub_rtcheck.so\n");
+}
+
+}
+
+inline void rtcheck(const char* call) {
+    if (rt_depth > 0 && allow_depth == 0 && reporting == 0)
+        report(call);
+}
+
+rtcheck_scope::rtcheck_scope() {
+    rt_depth++;
+}
+
+rtcheck_scope::~rtcheck_scope() {
+    rt_depth--;
+}
+
+rtcheck_allow::rtcheck_allow() {
+    allow_depth++;
+}
+
+rtcheck_allow::~rtcheck_allow() {
+    allow_depth--;
+}
+
+rtcheck_plugin::rtcheck_plugin(const char* name) {
+    prev = running_plugin;
+    running_plugin = name;
+}
+
+rtcheck_plugin::~rtcheck_plugin() {
+    running_plugin = prev;
+}
+
+int rtcheck_violations() {
+    if (!interposed) return -2;
+    return violations.load();
+}
+
+}
+
+#define RTCHECK(call) zzub::rtcheck(call)
+
+extern "C" {
+
+void* malloc(size_t size) {
+    RTCHECK("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    RTCHECK("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    RTCHECK("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    if (ptr) RTCHECK("free");
+    __libc_free(ptr);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    RTCHECK("memalign");
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    RTCHECK("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    RTCHECK("posix_memalign");
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    static int (*fn)(pthread_mutex_t*);
+    RTCHECK("pthread_mutex_lock");
+    return zzub::next(fn, "pthread_mutex_lock")(mutex);
+}
+
+int sem_wait(sem_t* sem) {
+    static int (*fn)(sem_t*);
+    RTCHECK("sem_wait");
+    return zzub::next(fn, "sem_wait")(sem);
+}
+
+int nanosleep(const struct timespec* req, struct timespec* rem) {
+    static int (*fn)(const struct timespec*, struct timespec*);
+    RTCHECK("nanosleep");
+    return zzub::next(fn, "nanosleep")(req, rem);
+}
+
+int usleep(useconds_t usec) {
+    static int (*fn)(useconds_t);
+    RTCHECK("usleep");
+    return zzub::next(fn, "usleep")(usec);
+}
+
+ssize_t read(int fd, void* buf, size_t count) {
+    static ssize_t (*fn)(int, void*, size_t);
+    RTCHECK("read");
+    return zzub::next(fn, "read")(fd, buf, count);
+}
+
+ssize_t write(int fd, const void* buf, size_t count) {
+    static ssize_t (*fn)(int, const void*, size_t);
+    RTCHECK("write");
+    return zzub::next(fn, "write")(fd, buf, count);
+}
+
+FILE* fopen(const char* path, const char* mode) {
+    static FILE* (*fn)(const char*, const char*);
+    RTCHECK("fopen");
+    return zzub::next(fn, "fopen")(path, mode);
+}
+
+int puts(const char* s) {
+    static int (*fn)(const char*);
+    RTCHECK("puts");
+    return zzub::next(fn, "puts")(s);
+}
+
+int printf(const char* format, ...) {
+    RTCHECK("printf");
+    va_list args;
+    va_start(args, format);
+    int result = vprintf(format, args);
+    va_end(args);
+    return result;
+}
+
+}
+
+#endif
@@ -0,0 +1,49 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "libzzub/common.h"
+#include <cstring>
+
+namespace zzub {
+
+/*! \struct rtcheck_allocator_info
+    \brief Built-in plugin that breaks the real time rules on purpose
+*/
+
+struct rtcheck_allocator : plugin {
+    virtual bool process_stereo(float **pin, float **pout, int numsamples, int mode) {
+        if ((mode & zzub::process_mode_write) == 0)
+            return false;
+        // the allocation is what the plugin is for, volatile keeps it from being optimized out
+        float* volatile scratch = new float[numsamples];
+        memset(scratch, 0, numsamples * sizeof(float));
+        delete[] scratch;
+        memset(pout[0], 0, numsamples * sizeof(float));
+        memset(pout[1], 0, numsamples * sizeof(float));
+        return false;
+    }
+};
+
+zzub::plugin* rtcheck_allocator_info::create_plugin() const {
+    return new rtcheck_allocator();
+}
+
+void rtcheck_plugincollection::initialize(zzub::pluginfactory *factory) {
+    factory->register_info(&allocator_info);
+}
+
+}
@@ -20,6 +20,7 @@
 #include "libzzub/dummy.h"
 #include "libzzub/metaplugin.h"
 #include "libzzub/timer.h"
+#include "libzzub/kernels.h"
 #include <algorithm>
 #include <cctype>
 #include <ctime>
@@ -34,6 +35,10 @@
 
 #include "libzzub/sseoptimization.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using std::cerr;
 using std::deque;
 using std::endl;
@@ -51,6 +56,63 @@ int buzz_to_midi_note(int value)
     return 12 * (value >> 4) + (value & 0xf) - 1;
 }
 
+// writes state columns to a block of live parameter values
+inline void write_parameter_values(const zzub::parameter_transfer* begin, const zzub::parameter_transfer* end, const int* values, char* target)
+{
+    for (const zzub::parameter_transfer* pt = begin; pt != end; ++pt) {
+        int v = values[pt->source];
+        const char* value_ptr = (const char*)&v;
+#if defined(ZZUB_BIG_ENDIAN)
+        value_ptr += sizeof(int) - pt->size;
+#endif
+        switch (pt->size) {
+        case 1:
+            target[pt->dest] = value_ptr[0];
+            break;
+        case 2:
+            memcpy(target + pt->dest, value_ptr, 2);
+            break;
+        }
+    }
+}
+
+// copies the values that are not none from source to target
+inline void merge_parameter_values(const int* source, int* target, const int* none, int count)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    // most columns are empty on most rows, skip four at a time
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(source + i));
+        __m128i is_none = _mm_cmpeq_epi32(v, _mm_loadu_si128((const __m128i*)(none + i)));
+        if (_mm_movemask_epi8(is_none) == 0xffff) continue;
+        __m128i t = _mm_loadu_si128((const __m128i*)(target + i));
+        _mm_storeu_si128((__m128i*)(target + i), _mm_or_si128(_mm_and_si128(is_none, t), _mm_andnot_si128(is_none, v)));
+    }
+#endif
+    for (; i < count; i++) {
+        if (source[i] != none[i])
+            target[i] = source[i];
+    }
+}
+
+// returns the index of the first value from 'from' that is not none, or count
+inline int find_parameter_value(const int* values, const int* none, int from, int count)
+{
+    int i = from;
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        __m128i is_none = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(values + i)), _mm_loadu_si128((const __m128i*)(none + i)));
+        if (_mm_movemask_epi8(is_none) != 0xffff) break;
+    }
+#endif
+    for (; i < count; i++) {
+        if (values[i] != none[i])
+            return i;
+    }
+    return count;
+}
+
 }
 
 namespace zzub {
@@ -65,20 +127,15 @@ bool is_note_playing(int plugin_id, const std::vector<zzub::keyjazz_note>& keyja
 }
 
 
-inline bool scanPeakStereo(float* l, float* r, int numSamples, float& maxL, float& maxR, float falloff)
+// the meters decay once per block instead of once per sample, block_falloff is falloff^numSamples
+inline bool scanPeakStereo(float* l, float* r, int numSamples, float& maxL, float& maxR, float block_falloff)
 {
-    bool zero = true;
-    while (numSamples--) {
-        maxL *= falloff;
-        maxR *= falloff;
-        maxL = std::max(std::abs(*l), maxL);
-        maxR = std::max(std::abs(*r), maxR);
-        if (zero && ((*l > SIGNAL_TRESHOLD) || (*l < -SIGNAL_TRESHOLD) || (*r > SIGNAL_TRESHOLD) || (*r < -SIGNAL_TRESHOLD)))
-            zero = false;
-        l++;
-        r++;
-    }
-    return zero;
+    const zzub::mixing_kernels& k = zzub::kernels();
+    float peakL = k.peak(l, numSamples);
+    float peakR = k.peak(r, numSamples);
+    maxL = std::max(peakL, maxL * block_falloff);
+    maxR = std::max(peakR, maxR * block_falloff);
+    return peakL <= SIGNAL_TRESHOLD && peakR <= SIGNAL_TRESHOLD;
 }
 
 // http://en.wikipedia.org/wiki/Topological_sorting
@@ -127,8 +184,9 @@ song::song()
 
     midi_plugin = -1;
     enable_event_queue = true;
-    user_event_queue.resize(4096);
-    user_event_queue_read = user_event_queue_write = 0;
+    user_event_queue = 0;
+    defer_work_order = false;
+    work_buffer_slot_count = 0;
 }
 
 zzub::metaplugin& song::get_plugin(zzub::plugin_descriptor index)
@@ -223,40 +281,31 @@ int song::plugin_get_parameter(int plugin_id, int group, int track, int column)
 {
     // use state_write or state_last depending on what is freshest
     assert(plugins[plugin_id] != 0);
-    assert(group >= 0 && group < plugins[plugin_id]->state_write.groups.size());
-    assert(track >= 0 && track < plugins[plugin_id]->state_write.groups[group].size());
-    assert(column >= 0 && column < plugins[plugin_id]->state_write.groups[group][track].size());
 
-    int v = plugins[plugin_id]->state_write.groups[group][track][column][0];
+    int v = plugins[plugin_id]->state_write.value(group, track, column, 0);
     const zzub::parameter* param = plugin_get_parameter_info(plugin_id, group, track, column);
     if (v != param->value_none)
         return v;
 
-    return plugins[plugin_id]->state_last.groups[group][track][column][0];
+    return plugins[plugin_id]->state_last.value(group, track, column, 0);
 }
 
 
 int song::plugin_get_parameter_direct(int plugin_id, int group, int track, int column)
 {
     assert(plugins[plugin_id] != 0);
-    assert(group >= 0 && group < plugins[plugin_id]->state_write.groups.size());
-    assert(track >= 0 && track < plugins[plugin_id]->state_write.groups[group].size());
-    assert(column >= 0 && column < plugins[plugin_id]->state_write.groups[group][track].size());
 
-    return plugins[plugin_id]->state_write.groups[group][track][column][0];
+    return plugins[plugin_id]->state_write.value(group, track, column, 0);
 }
 
 
 void song::plugin_set_parameter_direct(int plugin_id, int group, int track, int column, int value, bool record)
 {
     assert(plugins[plugin_id] != 0);
-    assert(group >= 0 && group < plugins[plugin_id]->state_write.groups.size());
-    assert(track >= 0 && track < plugins[plugin_id]->state_write.groups[group].size());
-    assert(column >= 0 && column < plugins[plugin_id]->state_write.groups[group][track].size());
 
-    plugins[plugin_id]->state_write.groups[group][track][column][0] = value;
+    plugins[plugin_id]->state_write.value(group, track, column, 0) = value;
     if (record)
-        plugins[plugin_id]->state_automation.groups[group][track][column][0] = value;
+        plugins[plugin_id]->state_automation.value(group, track, column, 0) = value;
 }
 
 
@@ -503,6 +552,8 @@ struct feedback_detector : public base_visitor<feedback_detector> {
 
 void song::make_work_order()
 {
+    if (defer_work_order) return;
+
     work_order.clear();
 
     // use a temp graph
@@ -566,6 +617,8 @@ void song::make_work_order()
         }
     }
 
+    make_work_levels();
+
 
     /*
       cerr << "-------------------------------------------------------" << endl;
@@ -592,33 +645,206 @@ void song::make_work_order()
       cerr << endl;*/
 }
 
+// group the work order by depth. a plugin is placed one level after all the plugins it
+// reads from in the same chunk. for feedback connections the reader comes first in the
+// work order and uses the feedback history of the source, so the source is placed after
+// the reader to make sure the history is not written while it is being read. only plugins
+// read by feedback or cv connections keep a history, which the user thread allocates before
+// the work order is swapped in.
+void song::make_work_levels()
+{
+    work_levels.clear();
+    work_feedback_history.assign(plugins.size(), 0);
+
+    vector<int> depth(work_order.size(), 0);
+    int max_depth = -1;
+
+    for (size_t i = 0; i < work_order.size(); i++) {
+        plugin_descriptor plugin = work_order[i];
+        int plugin_index = plugins[get_plugin_id(plugin)]->work_order_index;
+        int d = 0;
+
+        // the input plugins are stored as out edges
+        zzub::out_edge_iterator out, out_end;
+        for (boost::tie(out, out_end) = out_edges(plugin, graph); out != out_end; ++out) {
+            int from_index = plugins[graph[target(*out, graph)].id]->work_order_index;
+            if (from_index < plugin_index)
+                d = std::max(d, depth[from_index] + 1);
+        }
+
+        bool keeps_feedback_history = false;
+        zzub::in_edge_iterator in, in_end;
+        for (boost::tie(in, in_end) = in_edges(plugin, graph); in != in_end; ++in) {
+            int to_index = plugins[graph[source(*in, graph)].id]->work_order_index;
+            if (to_index < plugin_index) {
+                d = std::max(d, depth[to_index] + 1);
+                keeps_feedback_history = true;
+            }
+            if (graph[*in].conn->type == connection_type_cv)
+                keeps_feedback_history = true;
+        }
+        work_feedback_history[get_plugin_id(plugin)] = keeps_feedback_history;
+
+        depth[i] = d;
+        max_depth = std::max(max_depth, d);
+    }
+
+    work_levels.resize(max_depth + 1);
+
+    for (size_t i = 0; i < work_order.size(); i++) {
+        const metaplugin& m = *plugins[get_plugin_id(work_order[i])];
+
+        // control plugins change the state of other plugins while they work
+        if (m.info->flags & (zzub::plugin_flag_not_thread_safe | zzub::plugin_flag_control_plugin))
+            work_levels[depth[i]].serial.push_back(work_order[i]);
+        else
+            work_levels[depth[i]].parallel.push_back(work_order[i]);
+    }
+
+    make_work_buffer_slots(depth);
+}
+
+// assigns the output buffers by liveness over the work levels, the scheduler finishes a level
+// before the next one starts in both work modes. an output is live from the level of its
+// plugin to the last level reading it through an audio connection, feedback connections read
+// the history instead. outputs that are not live at the same time share a slot. the master
+// output is read after the chunk and the recorder reads the inputs of the master, so these are
+// never handed on. freed slots are reused last in first out, while they are still in cache.
+void song::make_work_buffer_slots(const vector<int>& depth)
+{
+    int level_count = (int)work_levels.size();
+    vector<vector<int> > level_plugins(level_count);
+    vector<int> last_read(work_order.size());
+
+    for (size_t i = 0; i < work_order.size(); i++) {
+        plugin_descriptor plugin = work_order[i];
+        int last = depth[i];
+        if (get_plugin_id(plugin) == 0)
+            last = level_count;
+
+        zzub::in_edge_iterator in, in_end;
+        for (boost::tie(in, in_end) = in_edges(plugin, graph); in != in_end; ++in) {
+            if (graph[*in].conn->type != connection_type_audio) continue;
+            int to_id = graph[source(*in, graph)].id;
+            if (to_id == 0)
+                last = level_count;
+            else
+                last = std::max(last, depth[plugins[to_id]->work_order_index]);
+        }
+
+        level_plugins[depth[i]].push_back((int)i);
+        last_read[i] = last;
+    }
+
+    // slot 0 is the master's
+    work_buffer_slots.assign(plugins.size(), -1);
+    work_buffer_slot_count = 1;
+
+    vector<vector<int> > released(level_count + 1);
+    vector<int> free_slots;
+    for (int l = 0; l < level_count; l++) {
+        free_slots.insert(free_slots.end(), released[l].begin(), released[l].end());
+
+        for (size_t j = 0; j < level_plugins[l].size(); j++) {
+            int i = level_plugins[l][j];
+            int id = get_plugin_id(work_order[i]);
+            int slot;
+            if (id == 0) {
+                slot = 0;
+            } else if (!free_slots.empty()) {
+                slot = free_slots.back();
+                free_slots.pop_back();
+            } else
+                slot = work_buffer_slot_count++;
+
+            work_buffer_slots[id] = slot;
+            if (id != 0 && last_read[i] < level_count)
+                released[last_read[i] + 1].push_back(slot);
+        }
+    }
+}
+
+// rebuilds the per plugin track lists and sizes the cursors for the sequencer tracks in this
+// song. this runs on the user thread before the tracks are swapped into the mixer, so ticking
+// only looks at the tracks of each plugin and the audio thread does not allocate.
+void song::update_sequencer_index()
+{
+    for (size_t i = 0; i < plugin_sequencer_tracks.size(); i++)
+        plugin_sequencer_tracks[i].clear();
+
+    for (size_t i = 0; i < sequencer_tracks.size(); i++) {
+        int plugin_id = sequencer_tracks[i].plugin_id;
+        if ((size_t)plugin_id >= plugin_sequencer_tracks.size())
+            plugin_sequencer_tracks.resize(plugin_id + 1);
+        plugin_sequencer_tracks[plugin_id].push_back((int)i);
+    }
+
+    sequencer_cursors.resize(sequencer_tracks.size());
+}
+
+const vector<int>& song::get_plugin_sequencer_tracks(int plugin_id) const
+{
+    static const vector<int> no_tracks;
+    if (plugin_id < 0 || (size_t)plugin_id >= plugin_sequencer_tracks.size())
+        return no_tracks;
+    return plugin_sequencer_tracks[plugin_id];
+}
+
+void sequencer_cursor::seek(const sequencer_track& t, int position)
+{
+    // the first event after position, the cursor is on the one before it
+    vector<sequence_event>::const_iterator i = std::upper_bound(t.events.begin(), t.events.end(), position,
+        [](int time, const sequence_event& ev) { return time < ev.time; });
+    index = (int)(i - t.events.begin()) - 1;
+}
+
+void sequencer_cursor::update(const sequencer_track& t, int position)
+{
+    int count = (int)t.events.size();
+    if (index < count && (index == -1 || t.events[index].time <= position)) {
+        if (index + 1 >= count || t.events[index + 1].time > position)
+            return;
+        if (index + 2 >= count || t.events[index + 2].time > position) {
+            index++;
+            return;
+        }
+    }
+    seek(t, position);
+}
+
 // ---------------------------------------------------------------------------
 //
 // Pattern utility
 //
 // ---------------------------------------------------------------------------
 
-void song::reset_plugin_parameter_group(zzub::pattern::group& group, const std::vector<const zzub::parameter*>& parameters)
+void song::reset_plugin_parameter_group(zzub::pattern& p, int group, const std::vector<const zzub::parameter*>& parameters)
 {
-    for (size_t i = 0; i < group.size(); i++)
-        reset_plugin_parameter_track(group[i], parameters);
+    for (int i = 0; i < p.get_track_count(group); i++)
+        reset_plugin_parameter_track(p, group, i, parameters);
 }
 
-void song::reset_plugin_parameter_track(zzub::pattern::track& track, const std::vector<const zzub::parameter*>& parameters)
+void song::reset_plugin_parameter_track(zzub::pattern& p, int group, int track, const std::vector<const zzub::parameter*>& parameters)
 {
-    for (size_t j = 0; j < track.size(); j++)
-        for (size_t k = 0; k < track[j].size(); k++)
-            track[j][k] = parameters[j]->value_none;
+    int columns = p.get_column_count(group, track);
+    for (int k = 0; k < p.rows; k++) {
+        int* values = p.get_track_row(group, track, k);
+        for (int j = 0; j < columns; j++)
+            values[j] = parameters[j]->value_none;
+    }
 }
 
-void song::default_plugin_parameter_track(zzub::pattern::track& track, const std::vector<const zzub::parameter*>& parameters)
+void song::default_plugin_parameter_track(zzub::pattern& p, int group, int track, const std::vector<const zzub::parameter*>& parameters)
 {
-    for (size_t j = 0; j < track.size(); j++)
-        for (size_t k = 0; k < track[j].size(); k++)
+    int columns = p.get_column_count(group, track);
+    for (int k = 0; k < p.rows; k++) {
+        int* values = p.get_track_row(group, track, k);
+        for (int j = 0; j < columns; j++)
             if (parameters[j]->flags & zzub::parameter_flag_state)
-                track[j][k] = parameters[j]->value_default;
+                values[j] = parameters[j]->value_default;
             else
-                track[j][k] = parameters[j]->value_none;
+                values[j] = parameters[j]->value_none;
+    }
 }
 
 int song::get_plugin_parameter_track_row_bytesize(int plugin_id, int g, int t)
@@ -633,12 +859,13 @@ int song::get_plugin_parameter_track_row_bytesize(int plugin_id, int g, int t)
 
 void song::transfer_plugin_parameter_track_row(int plugin_id, int g, int t, const zzub::pattern& from_pattern, void* target, int row, bool copy_all)
 {
-    const zzub::pattern::group& group = from_pattern.groups[g];
+    const int* values = from_pattern.get_track_row(g, t, row);
+    int columns = from_pattern.get_column_count(g, t);
 
     char* param_ptr = (char*)target;
     int param_ofs = 0;
-    for (int i = 0; i < (int)group[t].size(); i++) {
-        int v = group[t][i][row];
+    for (int i = 0; i < columns; i++) {
+        int v = values[i];
         const zzub::parameter* param = plugin_get_parameter_info(plugin_id, g, t, i);
         assert(v == param->value_none || (v >= param->value_min && v <= param->value_max) || (param->type == parameter_type_note && v == note_value_off));
         int size = param->get_bytesize();
@@ -655,11 +882,12 @@ void song::transfer_plugin_parameter_track_row(int plugin_id, int g, int t, cons
 
 void song::transfer_plugin_parameter_track_row(int plugin_id, int g, int t, const void* source, zzub::pattern& to_pattern, int row, bool copy_all)
 {
-    zzub::pattern::group& group = to_pattern.groups[g];
+    int* values = to_pattern.get_track_row(g, t, row);
+    int columns = to_pattern.get_column_count(g, t);
 
     char* param_ptr = (char*)source;
     int param_ofs = 0;
-    for (int i = 0; i < (int)group[t].size(); i++) {
+    for (int i = 0; i < columns; i++) {
         int v = 0;
         const zzub::parameter* param = plugin_get_parameter_info(plugin_id, g, t, i);
         int size = param->get_bytesize();
@@ -670,19 +898,50 @@ void song::transfer_plugin_parameter_track_row(int plugin_id, int g, int t, cons
         memcpy(value_ptr, param_ptr + param_ofs, size);
         assert(v == param->value_none || (v >= param->value_min && v <= param->value_max) || (param->type == parameter_type_note && v == note_value_off));
         if (copy_all || v != param->value_none) {
-            group[t][i][row] = v;
+            values[i] = v;
         }
         param_ofs += size;
     }
 }
 
+void song::invoke_plugin_parameter_changes(int plugin_id)
+{
+    metaplugin& m = *plugins[plugin_id];
+    if (!enable_event_queue || m.event_handlers.empty())
+        return;
+
+    const parameter_transfer_plan& plan = m.transfer_plan;
+    if (!plan.matches(m.state_write)) {
+        for (int g = 0; g < 3; g++)
+            invoke_plugin_parameter_changes(plugin_id, g);
+        return;
+    }
+
+    const int* values = m.state_write.get_row(0);
+    const int* none = plan.none_row.data();
+    int count = (int)plan.transfers.size();
+
+    for (int i = find_parameter_value(values, none, 0, count); i < count; i = find_parameter_value(values, none, i + 1, count)) {
+        const parameter_transfer& pt = plan.transfers[i];
+        zzub_event_data event_data;
+        event_data.type = zzub_event_type_parameter_changed;
+        event_data.change_parameter.plugin = m.proxy;
+        event_data.change_parameter.group = pt.group;
+        event_data.change_parameter.track = pt.track;
+        event_data.change_parameter.param = pt.column;
+        event_data.change_parameter.value = values[i];
+        plugin_invoke_event(plugin_id, event_data, false);
+    }
+}
+
 void song::invoke_plugin_parameter_changes(int plugin_id, int g)
 {
-    const zzub::pattern::group& group = plugins[plugin_id]->state_write.groups[g];
-    for (int j = 0; j < (int)group.size(); j++) {
-        for (int i = 0; i < (int)group[j].size(); i++) {
+    const zzub::pattern& p = plugins[plugin_id]->state_write;
+    for (int j = 0; j < p.get_track_count(g); j++) {
+        const int* values = p.get_track_row(g, j, 0);
+        for (int i = 0; i < p.get_column_count(g, j); i++) {
             const zzub::parameter* param = plugin_get_parameter_info(plugin_id, g, j, i);
-            int v = group[j][i][0];
+            int v = values[i];
 
             if (v != param->value_none) {
                 zzub_event_data event_data;
@@ -698,29 +957,72 @@ void song::invoke_plugin_parameter_changes(int plugin_id, int g)
     }
 }
 
-void song::invoke_plugin_parameter_changes(int plugin_id)
-{
-    invoke_plugin_parameter_changes(plugin_id, 0);
-    invoke_plugin_parameter_changes(plugin_id, 1);
-    invoke_plugin_parameter_changes(plugin_id, 2);
-}
-
 void song::transfer_plugin_parameter_row(int plugin_id, int g, const zzub::pattern& from_pattern, zzub::pattern& target_pattern, int from_row, int target_row, bool copy_all)
 {
-    const zzub::pattern::group& source_group = from_pattern.groups[g];
-    zzub::pattern::group& target_group = target_pattern.groups[g];
-
     // make sure we dont write outside the buffer
-    int transfer_track_count = (int)std::min(target_group.size(), source_group.size());
+    int transfer_track_count = std::min(target_pattern.get_track_count(g), from_pattern.get_track_count(g));
     for (int j = 0; j < transfer_track_count; j++) {
-        int transfer_column_count = (int)std::min(target_group[j].size(), source_group[j].size());
+        int transfer_column_count = std::min(target_pattern.get_column_count(g, j), from_pattern.get_column_count(g, j));
+        const int* source_values = from_pattern.get_track_row(g, j, from_row);
+        int* target_values = target_pattern.get_track_row(g, j, target_row);
         for (int i = 0; i < transfer_column_count; i++) {
             const zzub::parameter* param = plugin_get_parameter_info(plugin_id, g, j, i);
-            int v = source_group[j][i][from_row];
+            int v = source_values[i];
             if (copy_all || v != param->value_none)
-                target_group[j][i][target_row] = v;
+                target_values[i] = v;
+        }
+    }
+}
+
+void song::make_parameter_transfer_plan(int plugin_id)
+{
+    metaplugin& m = *plugins[plugin_id];
+    const zzub::pattern& state = m.state_write;
+    parameter_transfer_plan& plan = m.transfer_plan;
+
+    plan.transfers.clear();
+    plan.connection_end.clear();
+    plan.none_row.clear();
+
+    for (int g = 0; g < 3 && g < state.get_group_count(); g++) {
+        // each connection has its own value block, tracks are laid out after each other in track_values
+        int dest = 0;
+        for (int t = 0; t < state.get_track_count(g); t++) {
+            if (g == 0) dest = 0;
+            for (int i = 0; i < state.get_column_count(g, t); i++) {
+                const zzub::parameter* param = plugin_get_parameter_info(plugin_id, g, t, i);
+                parameter_transfer pt;
+                pt.source = state.get_column_index(g, t, i);
+                pt.dest = dest;
+                pt.size = param->get_bytesize();
+                pt.value_none = param->value_none;
+                pt.group = g;
+                pt.track = t;
+                pt.column = i;
+                assert(pt.source == (int)plan.transfers.size());
+                plan.transfers.push_back(pt);
+                plan.none_row.push_back(pt.value_none);
+                dest += pt.size;
+            }
+            if (g == 0) plan.connection_end.push_back((int)plan.transfers.size());
         }
+        if (g == 1) plan.global_end = (int)plan.transfers.size();
+    }
+    plan.column_count = state.column_count;
+    plan.track_count = state.get_group_count() > 2 ? state.get_track_count(2) : 0;
+}
+
+// same as transfer_plugin_parameter_row() over the connection, global and track groups. rows
+// are merged in one pass when both patterns have the layout of the plugin state.
+void song::merge_plugin_parameter_row(int plugin_id, const zzub::pattern& from_pattern, zzub::pattern& target_pattern, int from_row, int target_row)
+{
+    const parameter_transfer_plan& plan = plugins[plugin_id]->transfer_plan;
+    if (!plan.matches(from_pattern) || !plan.matches(target_pattern)) {
+        for (int g = 0; g < 3; g++)
+            transfer_plugin_parameter_row(plugin_id, g, from_pattern, target_pattern, from_row, target_row, false);
+        return;
     }
+    merge_parameter_values(from_pattern.get_row(from_row), target_pattern.get_row(target_row), plan.none_row.data(), (int)plan.transfers.size());
 }
 
 void song::create_pattern(zzub::pattern& result, int plugin_id, int rows)
@@ -728,7 +1030,7 @@ void song::create_pattern(zzub::pattern& result, int plugin_id, int rows)
     metaplugin& m = *plugins[plugin_id];
 
     result.rows = rows;
-    result.groups.resize(3);
+    result.set_group_count(3);
 
     // add connection tracks
     zzub::out_edge_iterator out, out_end;
@@ -740,84 +1042,56 @@ void song::create_pattern(zzub::pattern& result, int plugin_id, int rows)
     }
 
     // add global tracks
-    result.groups[1].resize(1);
-    result.groups[1][0].resize(m.info->global_parameters.size());
-    for (size_t j = 0; j < m.info->global_parameters.size(); j++)
-        result.groups[1][0][j].resize(rows);
-    reset_plugin_parameter_group(result.groups[1], m.info->global_parameters);
+    result.add_track(1, (int)m.info->global_parameters.size(), 0);
+    reset_plugin_parameter_group(result, 1, m.info->global_parameters);
 
     // add tracks
-    result.groups[2].resize(m.tracks);
-    for (int i = 0; i < m.tracks; i++) {
-        result.groups[2][i].resize(m.info->track_parameters.size());
-        for (size_t j = 0; j < m.info->track_parameters.size(); j++)
-            result.groups[2][i][j].resize(rows);
-    }
-    reset_plugin_parameter_group(result.groups[2], m.info->track_parameters);
+    for (int i = 0; i < m.tracks; i++)
+        result.add_track(2, (int)m.info->track_parameters.size(), 0);
+    reset_plugin_parameter_group(result, 2, m.info->track_parameters);
 }
 
 void song::set_pattern_tracks(zzub::pattern& p, const std::vector<const zzub::parameter*>& parameters, int tracks, bool set_defaults)
 {
-    zzub::pattern::group& g = p.groups[2];
+    while (p.get_track_count(2) > tracks)
+        p.remove_track(2, p.get_track_count(2) - 1);
 
-    if ((int)g.size() > tracks) {
-        g.erase(g.begin() + tracks, g.end());
-    } else {
-        zzub::pattern::track t;
-        t.resize(parameters.size());
-        for (size_t j = 0; j < t.size(); j++) {
-            t[j].resize(p.rows);
-        }
-        if (set_defaults) {
-            for (size_t j = 0; j < parameters.size(); j++) {
-                int v;
-                if (parameters[j]->flags & zzub::parameter_flag_state)
-                    v = parameters[j]->value_default;
-                else
-                    v = parameters[j]->value_none;
-                for (size_t k = 0; k < t[j].size(); k++) {
-                    t[j][k] = v;
-                }
-            }
-            // default_plugin_parameter_track(t, parameters);
-        } else
-            reset_plugin_parameter_track(t, parameters);
-        int diff = int(tracks - g.size());
-        for (int j = 0; j < diff; j++) {
-            g.push_back(t);
+    if (p.get_track_count(2) < tracks) {
+        std::vector<int> fill(parameters.size());
+        for (size_t j = 0; j < parameters.size(); j++) {
+            if (set_defaults && (parameters[j]->flags & zzub::parameter_flag_state))
+                fill[j] = parameters[j]->value_default;
+            else
+                fill[j] = parameters[j]->value_none;
         }
+        while (p.get_track_count(2) < tracks)
+            p.add_track(2, (int)parameters.size(), fill.empty() ? 0 : &fill.front());
     }
 }
 
 void song::set_pattern_length(int plugin_id, zzub::pattern& p, int rows)
 {
-    for (int i = 0; i < (int)p.groups.size(); i++) {
-        for (int j = 0; j < (int)p.groups[i].size(); j++) {
-            for (int k = 0; k < (int)p.groups[i][j].size(); k++) {
-                int prevlength = (int)p.groups[i][j][k].size();
-                p.groups[i][j][k].resize(rows);
+    // new rows are filled with the none value of each column
+    std::vector<int> fill(p.column_count);
+    for (int i = 0; i < p.get_group_count(); i++) {
+        for (int j = 0; j < p.get_track_count(i); j++) {
+            for (int k = 0; k < p.get_column_count(i, j); k++) {
                 const zzub::parameter* param = plugin_get_parameter_info(plugin_id, i, j, k);
-                for (int l = prevlength; l < rows; l++) {
-                    p.groups[i][j][k][l] = param->value_none;
-                }
+                fill[p.get_column_index(i, j, k)] = param->value_none;
             }
         }
     }
-    p.rows = rows;
+    p.set_rows(rows, fill.empty() ? 0 : &fill.front());
 }
 
 
 void song::add_pattern_connection_track(zzub::pattern& pattern, const std::vector<const zzub::parameter*>& parameters)
 {
-    pattern.groups[0].push_back(zzub::pattern::track());
-
-    zzub::pattern::track& t = pattern.groups[0].back();
-    t.resize(parameters.size());
-
+    std::vector<int> fill(parameters.size());
     for (size_t j = 0; j < parameters.size(); j++)
-        t[j].resize(pattern.rows);
+        fill[j] = parameters[j]->value_none;
 
-    reset_plugin_parameter_track(t, parameters);
+    pattern.add_track(0, (int)parameters.size(), fill.empty() ? 0 : &fill.front());
 }
 
 bool song::plugin_invoke_event(int plugin_id, zzub_event_data data, bool immediate)
@@ -837,13 +1111,14 @@ bool song::plugin_invoke_event(int plugin_id, zzub_event_data data, bool immedia
     for (size_t i = 0; i < handlers.size(); i++) {
         
         if (!immediate) {
+            // events raised while preparing operations on the back buffer are not queued,
+            // nothing would ever drain them
+            if (user_event_queue == 0) continue;
             event_message em = { plugin_id, handlers[i], data };
-            user_event_queue[user_event_queue_write] = em;
-            if (user_event_queue_write == user_event_queue.size() - 1)
-                user_event_queue_write = 0;
+            if (data.type == zzub_event_type_parameter_changed)
+                user_event_queue->push_parameter_change(em);
             else
-                user_event_queue_write++;
-            assert(user_event_queue_write != user_event_queue_read);
+                user_event_queue->push(em);
         } else {
             handled = handlers[i]->invoke(data) || handled;
         }
@@ -857,27 +1132,36 @@ void song::process_plugin_events(int plugin_id)
     metaplugin& m = *plugins[plugin_id];
     assert(m.descriptor != graph_traits<plugin_map>::null_vertex());
 
+    // the plan is rebuilt by the operations that change the state layout, never on the audio
+    // thread. if it is out of date anyway, transfer each parameter by its info.
+    const parameter_transfer_plan& plan = m.transfer_plan;
+    if (!plan.matches(m.state_write) || (int)plan.connection_end.size() != (int)out_degree(m.descriptor, graph)) {
+        process_plugin_events_unplanned(plugin_id);
+        return;
+    }
+
+    const parameter_transfer* transfers = plan.transfers.data();
+    int* values = m.state_write.get_row(0);
+
     // transfer state_write to live
     zzub::out_edge_iterator out, out_end;
     boost::tie(out, out_end) = out_edges(m.descriptor, graph);
     int index = 0;
+    int begin = 0;
 
     for (; out != out_end; ++out, index++) {
         assert(source(*out, graph) < num_vertices(graph));
         assert(target(*out, graph) < num_vertices(graph));
 
         edge_props& c = graph[*out];
-        transfer_plugin_parameter_track_row(plugin_id, 0, index, m.state_write, c.conn->connection_values, 0, true);
+        int end = plan.connection_end[index];
+        write_parameter_values(transfers + begin, transfers + end, values, (char*)c.conn->connection_values);
+        begin = end;
         c.conn->process_events(*this, *out);
     }
 
-    transfer_plugin_parameter_track_row(plugin_id, 1, 0, m.state_write, m.plugin->global_values, 0, true);
-    char* track_ptr = (char*)m.plugin->track_values;
-    int track_size = get_plugin_parameter_track_row_bytesize(plugin_id, 2, 0);
-    for (int i = 0; i < m.tracks; i++) {
-        transfer_plugin_parameter_track_row(plugin_id, 2, i, m.state_write, track_ptr, 0, true);
-        track_ptr += track_size;
-    }
+    write_parameter_values(transfers + begin, transfers + plan.global_end, values, (char*)m.plugin->global_values);
+    write_parameter_values(transfers + plan.global_end, transfers + plan.transfers.size(), values, (char*)m.plugin->track_values);
 
     // send parameter change notifications
     invoke_plugin_parameter_changes(plugin_id);
@@ -885,20 +1169,50 @@ void song::process_plugin_events(int plugin_id)
     // process plugin
     m.plugin->process_events();
 
-    // transfer state_write to state_last
-    transfer_plugin_parameter_row(plugin_id, 0, m.state_write, m.state_last, 0, 0, false);
-    transfer_plugin_parameter_row(plugin_id, 1, m.state_write, m.state_last, 0, 0, false);
-    transfer_plugin_parameter_row(plugin_id, 2, m.state_write, m.state_last, 0, 0, false);
+    // transfer state_write to state_last and reset all connection, global and track states
+    int count = (int)plan.transfers.size();
+    merge_parameter_values(values, m.state_last.get_row(0), plan.none_row.data(), count);
+    std::copy(plan.none_row.begin(), plan.none_row.end(), values);
+}
+
+// process_plugin_events() for a plugin whose transfer plan does not match its state layout
+void song::process_plugin_events_unplanned(int plugin_id)
+{
+    metaplugin& m = *plugins[plugin_id];
+    zzub::pattern& state = m.state_write;
+
+    zzub::out_edge_iterator out, out_end;
+    boost::tie(out, out_end) = out_edges(m.descriptor, graph);
+    int index = 0;
 
-    // reset connection states
-    for (int i = 0; i < plugin_get_input_connection_count(plugin_id); i++) {
-        connection* conn = plugin_get_input_connection(plugin_id, i);
-        reset_plugin_parameter_track(m.state_write.groups[0][i], conn->connection_parameters);
+    for (; out != out_end; ++out, index++) {
+        edge_props& c = graph[*out];
+        if (index < state.get_track_count(0))
+            transfer_plugin_parameter_track_row(plugin_id, 0, index, state, c.conn->connection_values, 0, true);
+        c.conn->process_events(*this, *out);
     }
 
-    // reset global and track states
-    reset_plugin_parameter_group(m.state_write.groups[1], m.info->global_parameters);
-    reset_plugin_parameter_group(m.state_write.groups[2], m.info->track_parameters);
+    transfer_plugin_parameter_track_row(plugin_id, 1, 0, state, m.plugin->global_values, 0, true);
+    char* track_ptr = (char*)m.plugin->track_values;
+    int track_size = get_plugin_parameter_track_row_bytesize(plugin_id, 2, 0);
+    int tracks = std::min(m.tracks, state.get_track_count(2));
+    for (int i = 0; i < tracks; i++) {
+        transfer_plugin_parameter_track_row(plugin_id, 2, i, state, track_ptr, 0, true);
+        track_ptr += track_size;
+    }
+
+    invoke_plugin_parameter_changes(plugin_id);
+
+    m.plugin->process_events();
+
+    for (int g = 0; g < 3; g++) {
+        transfer_plugin_parameter_row(plugin_id, g, state, m.state_last, 0, 0, false);
+        for (int j = 0; j < state.get_track_count(g); j++) {
+            int* values = state.get_track_row(g, j, 0);
+            for (int i = 0; i < state.get_column_count(g, j); i++)
+                values[i] = plugin_get_parameter_info(plugin_id, g, j, i)->value_none;
+        }
+    }
 }
 
 
@@ -988,12 +1302,13 @@ void song::plugin_add_input(int to_id, int from_id, connection_type type)
     }
 
     add_pattern_connection_track(to_mpl.state_write, c.conn->connection_parameters);
-    default_plugin_parameter_track(to_mpl.state_write.groups[0].back(), c.conn->connection_parameters);
+    default_plugin_parameter_track(to_mpl.state_write, 0, to_mpl.state_write.get_track_count(0) - 1, c.conn->connection_parameters);
 
     add_pattern_connection_track(to_mpl.state_last, c.conn->connection_parameters);
 
     add_pattern_connection_track(to_mpl.state_automation, c.conn->connection_parameters);
 
+    make_parameter_transfer_plan(to_id);
     make_work_order();
 }
 
@@ -1013,29 +1328,20 @@ void song::plugin_delete_input(int to_id, int from_id, connection_type type)
     assert(track >= 0);
 
     for (size_t i = 0; i < to_mpl.patterns.size(); i++) {
-        zzub::pattern& p = *to_mpl.patterns[i];
-        zzub::pattern::group& g = p.groups[0];
-        g.erase(g.begin() + track);
+        to_mpl.patterns[i]->remove_track(0, track);
     }
 
     // remove connection tracks in state
-    zzub::pattern::group& writeg = to_mpl.state_write.groups[0];
-    assert(track < writeg.size());
-    writeg.erase(writeg.begin() + track);
-
-    zzub::pattern::group& lastg = to_mpl.state_last.groups[0];
-    assert(track < lastg.size());
-    lastg.erase(lastg.begin() + track);
-
-    zzub::pattern::group& autog = to_mpl.state_automation.groups[0];
-    assert(track < autog.size());
-    autog.erase(autog.begin() + track);
+    to_mpl.state_write.remove_track(0, track);
+    to_mpl.state_last.remove_track(0, track);
+    to_mpl.state_automation.remove_track(0, track);
 
     out_edge_iterator out, out_end;
     boost::tie(out, out_end) = out_edges(to_plugin, graph);
     connection_descriptor conndesc = *(out + track);
     remove_edge(conndesc, graph);
 
+    make_parameter_transfer_plan(to_id);
     make_work_order();
 }
 
@@ -1056,10 +1362,12 @@ mixer::mixer()
     song_position = 0;
     last_tick_state = player_state_stopped;
     last_tick_position = 0;
+    block_size = zzub::buffer_size;
+    user_event_queue = &user_events;
 
-    mix_buffer.resize(2);
-    mix_buffer[0].resize(zzub::buffer_size * 4);
-    mix_buffer[1].resize(zzub::buffer_size * 4);
+    mix_arena.reserve(1);
+    mix_buffer[0] = mix_arena.get_channel(0, 0);
+    mix_buffer[1] = mix_arena.get_channel(0, 1);
     memset(inputBuffer, 0, sizeof(inputBuffer));
 }
 
@@ -1077,6 +1385,7 @@ void mixer::set_play_position(int position)
     song_position = position;
     master_info.tick_position = 0;
     work_tick_fracs = 0;
+    sequencer_update_play_pattern_positions();
 }
 
 void mixer::process_sequencer_events(plugin_descriptor plugin)
@@ -1090,10 +1399,10 @@ void mixer::process_sequencer_events(plugin_descriptor plugin)
     bool has_started = last_tick_state == player_state_stopped;
     bool reset_sequencer = has_jumped || has_started;
 
-    for (size_t i = 0; i < sequencer_tracks.size(); i++) {
-        if (plugin_id != sequencer_tracks[i].plugin_id)
-            continue;
-        int index = sequencer_indices[i];
+    const vector<int>& tracks = get_plugin_sequencer_tracks(plugin_id);
+    for (size_t j = 0; j < tracks.size(); j++) {
+        int i = tracks[j];
+        int index = sequencer_cursors[i].index;
         if (index == -1) {
             assert(sequencer_tracks[i].events.size() == 0 || song_position < sequencer_tracks[i].events[0].time);
             continue;
@@ -1121,9 +1430,7 @@ void mixer::process_sequencer_events(plugin_descriptor plugin)
                             if (row == 0 || reset_sequencer)
                                 m.plugin->play_sequence_event(t.proxy, e, row);
                             m.sequencer_state = sequencer_event_type_none;
-                            transfer_plugin_parameter_row(get_plugin_id(plugin), 0, p, m.state_write, row, 0, false);
-                            transfer_plugin_parameter_row(get_plugin_id(plugin), 1, p, m.state_write, row, 0, false);
-                            transfer_plugin_parameter_row(get_plugin_id(plugin), 2, p, m.state_write, row, 0, false);
+                            merge_plugin_parameter_row(get_plugin_id(plugin), p, m.state_write, row, 0);
                             // cout << "Pattern row " << row << endl;
                         }
                     }
@@ -1155,7 +1462,7 @@ int mixer::determine_chunk_size(int sample_count, double& tick_fracs, int& next_
 {
     int chunk_size = master_info.samples_per_tick + (int)floor(tick_fracs) - master_info.tick_position;
 
-    int max_size = std::min((int)buffer_size, master_info.samples_per_tick); // eg mixing rate of 4000hz = 250 samples per tick
+    int max_size = std::min(block_size, master_info.samples_per_tick); // eg mixing rate of 4000hz = 250 samples per tick
     if (chunk_size > max_size || chunk_size < 0) {
         chunk_size = max_size;
         if (chunk_size > sample_count)
@@ -1175,6 +1482,11 @@ int mixer::determine_chunk_size(int sample_count, double& tick_fracs, int& next_
 void mixer::process_keyjazz_noteoff_events()
 {
     // check for delayed note offs
+    bool has_delayed_off = false;
+    for (size_t i = 0; i < keyjazz.size(); i++)
+        has_delayed_off |= keyjazz[i].delay_off;
+    if (!has_delayed_off) return;
+
     // plugin_update_keyjazz may modify keyjazz so we use a copy
     std::vector<keyjazz_note> keycopy = keyjazz;
     for (size_t i = 0; i < keycopy.size(); i++) {
@@ -1207,18 +1519,9 @@ void mixer::process_sequencer_events()
 
     if (state == player_state_playing) {
 
-        for (size_t i = 0; i < sequencer_indices.size(); i++) {
-            sequencer_track& seqtrack = sequencer_tracks[i];
-
-            int& song_index = sequencer_indices[i];
-
-            while (song_index >= 0 && (song_index >= (int)seqtrack.events.size() || seqtrack.events[song_index].time > song_position)) {
-                song_index--;
-            }
-
-            while (song_index < (int)seqtrack.events.size() - 1 && seqtrack.events[song_index + 1].time <= song_position) {
-                song_index++;
-            }
+        assert(sequencer_cursors.size() == sequencer_tracks.size());
+        for (size_t i = 0; i < sequencer_cursors.size(); i++) {
+            sequencer_cursors[i].update(sequencer_tracks[i], song_position);
         }
 
         // write parameters from patterns in the sequencer and tick
@@ -1239,14 +1542,14 @@ void mixer::process_sequencer_events()
 int mixer::generate_audio(int sample_count)
 {
 
+    trace_scope scope(tracer, trace_kind_chunk);
+
     // is state is muted, we abort so the user thread can modify song data freely
     if (state == player_state_muted) {
         int mute_buffer_size = sample_count > buffer_size ? buffer_size : sample_count;
         metaplugin& masterplugin = get_plugin(0);
-        assert(mute_buffer_size < masterplugin.work_buffer[0].size());
-        assert(mute_buffer_size < masterplugin.work_buffer[1].size());
-        memset(&masterplugin.work_buffer[0].front(), 0, mute_buffer_size * sizeof(float));
-        memset(&masterplugin.work_buffer[1].front(), 0, mute_buffer_size * sizeof(float));
+        memset(masterplugin.work_buffer[0], 0, mute_buffer_size * sizeof(float));
+        memset(masterplugin.work_buffer[1], 0, mute_buffer_size * sizeof(float));
         return mute_buffer_size;
     }
 
@@ -1268,6 +1571,8 @@ int mixer::generate_audio(int sample_count)
 
                 // process events (connections may alter state_write, plugins may alter song_position)
                 if (!workplugin.is_muted && !workplugin.is_bypassed) {
+                    rtcheck_plugin running(workplugin.name.c_str());
+                    trace_scope plugin_scope(tracer, trace_kind_process_events, plugin_id);
                     process_plugin_events(plugin_id);
                 }
             }
@@ -1290,10 +1595,7 @@ int mixer::generate_audio(int sample_count)
 
 
     // process plugins
-    for (auto plugin_desc : work_order) {
-        // process audio
-        work_plugin(plugin_desc, work_chunk_size);
-    }
+    scheduler.run(*this, work_levels, work_chunk_size);
 
     // process midi
     for (auto plugin_desc : work_order) {
@@ -1317,13 +1619,12 @@ bool mixer::get_currently_playing_pattern(int plugin_id, int& pattern_index, int
 {
     metaplugin& m = *plugins[plugin_id];
 
-    for (size_t i = 0; i < sequencer_tracks.size(); i++) {
-        const sequencer_track& seqtrack = sequencer_tracks[i];
-        if (plugin_id != seqtrack.plugin_id)
-            continue;
+    const vector<int>& tracks = get_plugin_sequencer_tracks(plugin_id);
+    for (size_t j = 0; j < tracks.size(); j++) {
+        const sequencer_track& seqtrack = sequencer_tracks[tracks[j]];
         if (sequence_type_pattern != seqtrack.type)
             continue;
-        int index = sequencer_indices[i];
+        int index = sequencer_cursors[tracks[j]].index;
         if (index == -1)
             continue;
         if (seqtrack.events.size() > 0 && (size_t)index < seqtrack.events.size()) {
@@ -1355,13 +1656,12 @@ bool mixer::get_currently_playing_pattern_row(int plugin_id, int pattern_index,
 {
     metaplugin& m = *plugins[plugin_id];
 
-    for (size_t i = 0; i < sequencer_tracks.size(); i++) {
-        const sequencer_track& seqtrack = sequencer_tracks[i];
-        if (plugin_id != seqtrack.plugin_id)
-            continue;
+    const vector<int>& tracks = get_plugin_sequencer_tracks(plugin_id);
+    for (size_t j = 0; j < tracks.size(); j++) {
+        const sequencer_track& seqtrack = sequencer_tracks[tracks[j]];
         if (sequence_type_pattern != seqtrack.type)
             continue;
-        int index = sequencer_indices[i];
+        int index = sequencer_cursors[tracks[j]].index;
         if (index == -1)
             continue;
         if (seqtrack.events.size() > 0 && (size_t)index < seqtrack.events.size()) {
@@ -1380,21 +1680,180 @@ bool mixer::get_currently_playing_pattern_row(int plugin_id, int pattern_index,
     return false;
 }
 
+// called after a new set of sequencer tracks was swapped in. the cursors were sized by
+// update_sequencer_index() on the user thread, here they only need to find their event.
 void mixer::sequencer_update_play_pattern_positions()
 {
-    sequencer_indices.resize(sequencer_tracks.size());
+    assert(sequencer_cursors.size() == sequencer_tracks.size());
+    for (size_t i = 0; i < sequencer_cursors.size(); i++) {
+        sequencer_cursors[i].seek(sequencer_tracks[i], song_position);
+    }
+}
+
+// points the plugins at the slots of the work order that was just swapped in, and turns their
+// feedback histories on or off. runs in write_swap_song(), maybe on the audio thread, the user
+// thread reserved the slots and allocated the histories before.
+void mixer::assign_work_buffers()
+{
+    for (size_t i = 0; i < plugins.size(); i++) {
+        if (plugins[i] == 0) continue;
+        plugins[i]->keeps_feedback_history = i < work_feedback_history.size() && work_feedback_history[i];
+        if (i >= work_buffer_slots.size() || work_buffer_slots[i] == -1) continue;
+        plugins[i]->work_buffer[0] = work_buffers.get_channel(work_buffer_slots[i], 0);
+        plugins[i]->work_buffer[1] = work_buffers.get_channel(work_buffer_slots[i], 1);
+    }
+}
+
+// reallocates the buffers holding a block for blocks of size samples. the player holds
+// swap_lock, and passes the histories of plugins that are not swapped in yet on its own.
+void mixer::set_block_size(int size)
+{
+    block_size = size;
+
+    work_buffers.set_block_size(size);
+    assign_work_buffers();
+
+    mix_arena.set_block_size(size);
+    mix_buffer[0] = mix_arena.get_channel(0, 0);
+    mix_buffer[1] = mix_arena.get_channel(0, 1);
+    scheduler.set_block_size(size);
+
+    for (size_t i = 0; i < plugins.size(); i++) {
+        if (plugins[i] == 0 || plugins[i]->callbacks->feedback_buffer.empty()) continue;
+        plugins[i]->callbacks->enable_feedback_history();
+    }
+}
+
+// bytes of audio buffers the current song touches in a cycle: the plugin outputs, the
+// scratch buffers of the audio and worker threads and the feedback histories
+size_t mixer::get_buffer_working_set()
+{
+    size_t size = work_buffer_slot_count * work_buffers.get_slot_size();
+    size += mix_arena.get_size() + scheduler.get_scratch_size();
+    for (size_t i = 0; i < plugins.size(); i++) {
+        if (plugins[i] == 0 || !plugins[i]->keeps_feedback_history) continue;
+        const vector<vector<float> >& history = plugins[i]->callbacks->feedback_buffer;
+        for (size_t c = 0; c < history.size(); c++)
+            size += history[c].size() * sizeof(float);
+    }
+    return size;
 }
 
 void mixer::work_plugin(plugin_descriptor plugin, int sample_count)
+{
+    work_plugin(plugin, sample_count, mix_buffer);
+}
+
+// effects sleep when their input has been silent for longer than the tail length they declare.
+// a sleeping plugin is not processed and its output is silent, so the plugins it feeds go to
+// sleep after their own tails, and idle branches of the graph are skipped entirely.
+bool mixer::plugin_is_sleeping(plugin_descriptor plugin, const metaplugin& mp)
+{
+    int tail_length = mp.info->tail_length;
+    if (tail_length == zzub::tail_length_infinite || (mp.info->flags & zzub_plugin_flag_has_audio_input) == 0)
+        return false;
+    if (mp.info->flags & (zzub_plugin_flag_is_root | zzub_plugin_flag_control_plugin))
+        return false;
+
+    if (tail_length == zzub::tail_length_auto)
+        tail_length = 1000;
+    long long tail_samples = (long long)tail_length * master_info.samples_per_second / 1000;
+    if (mp.silent_samples < tail_samples)
+        return false;
+
+    zzub::out_edge_iterator out, out_end;
+    for (boost::tie(out, out_end) = out_edges(plugin, graph); out != out_end; ++out) {
+        if (graph[*out].conn->has_signals(*this, *out))
+            return false;
+    }
+    return true;
+}
+
+// scratch_buffer holds the input for process_stereo(), each worker thread has its own.
+// process_stereo() gets the mixed input in both buffers, but generators only write, so
+// their input is neither cleared nor copied.
+void mixer::work_plugin(plugin_descriptor plugin, int sample_count, float** scratch_buffer)
 {
     double start_time = timer.frame();
 
-    // process connections
     int plugin_id = get_plugin_id(plugin);
     metaplugin& mp = *plugins[plugin_id];
-    memset(&mp.work_buffer[0].front(), 0, sample_count * sizeof(float));
-    memset(&mp.work_buffer[1].front(), 0, sample_count * sizeof(float));
+    rtcheck_plugin running(mp.name.c_str());
+    float samplerate = float(master_info.samples_per_second);
+    float block_falloff = std::pow(10.0f, (-48.0f * sample_count / (samplerate * 20.0f))); // vu meter falloff (-48dB/s)
+
+    mp.is_sleeping = plugin_is_sleeping(plugin, mp);
+    if (mp.is_sleeping) {
+        mp.last_work_audio_result = false;
+        if (mp.keeps_feedback_history)
+            mp.callbacks->write_feedback(0, sample_count);
+        mp.last_work_max_left *= block_falloff;
+        mp.last_work_max_right *= block_falloff;
+    } else {
+        bool input_silent = work_plugin_audio(plugin, mp, sample_count, scratch_buffer);
+        bool output_silent = true;
+
+        if (mp.last_work_audio_result) {
+            output_silent = scanPeakStereo(mp.work_buffer[0], mp.work_buffer[1], sample_count, mp.last_work_max_left, mp.last_work_max_right, block_falloff);
+            if (output_silent) {
+                // the plugin claims it has generated non-silence, but our scan says otherwise
+                mp.writemode_errors++;
+            }
+        } else {
+            mp.last_work_max_left *= block_falloff;
+            mp.last_work_max_right *= block_falloff;
+        }
+
+        if (input_silent && (output_silent || mp.info->tail_length != zzub::tail_length_auto))
+            mp.silent_samples += sample_count;
+        else
+            mp.silent_samples = 0;
+    }
 
+    // write recorded parameters to patterns
+    if (is_recording_parameters) {
+        int pattern_index, pattern_row;
+        if (get_currently_playing_pattern(plugin_id, pattern_index, pattern_row)) {
+            zzub::pattern& p = *mp.patterns[pattern_index];
+            transfer_plugin_parameter_row(plugin_id, 0, mp.state_automation, p, 0, pattern_row, false);
+            transfer_plugin_parameter_row(plugin_id, 1, mp.state_automation, p, 0, pattern_row, false);
+            transfer_plugin_parameter_row(plugin_id, 2, mp.state_automation, p, 0, pattern_row, false);
+        }
+    }
+
+    // clear recorded parameters - state_automation is currently written to all the time,
+    // ignoring is_recording_parameters, so we need to clear it all the time as well
+    reset_plugin_parameter_group(mp.state_automation, 1, mp.info->global_parameters);
+    reset_plugin_parameter_group(mp.state_automation, 2, mp.info->track_parameters);
+
+    // update statistics, sleeping plugins count as idle
+    mp.last_work_time = mp.is_sleeping ? 0 : timer.frame() - start_time;
+    mp.last_work_buffersize = sample_count;
+    mp.last_work_frame = work_position;
+
+    // these are used to calculating cpu_load-per-plugin-per-buffer in op_player_get_plugins_load_snapshot::operate()
+    mp.cpu_load_time += mp.last_work_time;
+    mp.cpu_load_buffersize += sample_count;
+    mp.total_work_time += mp.last_work_time;
+}
+
+// mixes the inputs and runs process_stereo(), returns true if there was no input signal
+bool mixer::work_plugin_audio(plugin_descriptor plugin, metaplugin& mp, int sample_count, float** scratch_buffer)
+{
+    bool is_generator =
+        ((mp.info->flags & zzub_plugin_flag_has_audio_output) != 0) &&
+        ((mp.info->flags & zzub_plugin_flag_has_audio_input) == 0);
+
+    bool is_muted = mp.is_muted || mp.sequencer_state == sequencer_event_type_mute;
+    bool is_bypassed = mp.is_bypassed || mp.sequencer_state == sequencer_event_type_thru;
+    bool input_in_pieces = !is_muted && !is_bypassed && (mp.info->flags & zzub::plugin_flag_does_input_mixing) != 0 && !takes_whole_chunk(mp, sample_count);
+
+    if (!is_generator) {
+        memset(mp.work_buffer[0], 0, sample_count * sizeof(float));
+        memset(mp.work_buffer[1], 0, sample_count * sizeof(float));
+    }
+
+    // process connections
     bool result = false;
     zzub::out_edge_iterator out, out_end;
     boost::tie(out, out_end) = out_edges(plugin, graph);
@@ -1402,42 +1861,49 @@ void mixer::work_plugin(plugin_descriptor plugin, int sample_count)
         assert(source(*out, graph) < num_vertices(graph));
         assert(target(*out, graph) < num_vertices(graph));
 
-        metaplugin& plugin_from = get_plugin(target(*out, graph));
-
-        bool use_work_buffer = plugin_from.last_work_frame == mp.last_work_frame + mp.last_work_buffersize;
-
         edge_props& c = graph[*out];
-        result |= c.conn->work(*this, *out, work_chunk_size, use_work_buffer);
+        if (input_in_pieces && c.conn->type == connection_type_audio) {
+            // input() is called for each piece in process_stereo_pieces()
+            result |= c.conn->has_signals(*this, *out);
+            continue;
+        }
+        trace_scope scope(tracer, trace_kind_connection, get_plugin_id(plugin), get_plugin_id(target(*out, graph)));
+        result |= c.conn->work(*this, *out, work_chunk_size, work_position);
     }
 
     // process audio:
     int flags;
-    if (
-        ((mp.info->flags & zzub_plugin_flag_has_audio_output) != 0) && 
-        ((mp.info->flags & zzub_plugin_flag_has_audio_input) == 0)
-    ) {
+    if (is_generator) {
         flags = zzub::process_mode_write;
     } else {
 
         if (result) {
             bool does_input_mixing = (mp.info->flags & zzub::plugin_flag_does_input_mixing) != 0;
-            bool has_signals = buffer_has_signals(&mp.work_buffer[0].front(), sample_count) || buffer_has_signals(&mp.work_buffer[1].front(), sample_count);
+            const zzub::mixing_kernels& k = zzub::kernels();
+            bool has_signals = k.has_signals(mp.work_buffer[0], sample_count) || k.has_signals(mp.work_buffer[1], sample_count);
             flags = (does_input_mixing || has_signals) ? zzub::process_mode_read_write : zzub::process_mode_write;
         } else
             flags = zzub::process_mode_write;
     }
 
-    memcpy(&mix_buffer[0].front(), &mp.work_buffer[0].front(), sample_count * sizeof(float));
-    memcpy(&mix_buffer[1].front(), &mp.work_buffer[1].front(), sample_count * sizeof(float));
-    float* plin[] = { &mix_buffer[0].front(), &mix_buffer[1].front() };
-    float* plout[] = { &mp.work_buffer[0].front(), &mp.work_buffer[1].front() };
-    if (mp.is_muted || mp.sequencer_state == sequencer_event_type_mute) {
+    if (flags & zzub::process_mode_read) {
+        memcpy(scratch_buffer[0], mp.work_buffer[0], sample_count * sizeof(float));
+        memcpy(scratch_buffer[1], mp.work_buffer[1], sample_count * sizeof(float));
+    }
+    float* plin[] = { scratch_buffer[0], scratch_buffer[1] };
+    float* plout[] = { mp.work_buffer[0], mp.work_buffer[1] };
+    if (is_muted) {
         mp.last_work_audio_result = false;
-    } else if (mp.is_bypassed || mp.sequencer_state == sequencer_event_type_thru) {
-        mp.last_work_audio_result = result;
+    } else if (is_bypassed) {
+        // a bypassed generator has no input to pass through
+        mp.last_work_audio_result = result && !is_generator;
     } else {
         SETABRPUN(); // turn on flush-to-zero for SSE machines
-        mp.last_work_audio_result = mp.plugin->process_stereo(plin, plout, sample_count, flags);
+        trace_scope scope(tracer, trace_kind_process_stereo, get_plugin_id(plugin));
+        if (takes_whole_chunk(mp, sample_count))
+            mp.last_work_audio_result = mp.plugin->process_stereo(plin, plout, sample_count, flags);
+        else
+            mp.last_work_audio_result = process_stereo_pieces(plugin, mp, plin, plout, sample_count, flags, input_in_pieces);
         // (paniq) flush to zero should be turned off outside our DSP loop
         // because the player library might be running in a process where
         // precise computation is expected (i.e. realtime physics simulation).
@@ -1446,47 +1912,55 @@ void mixer::work_plugin(plugin_descriptor plugin, int sample_count)
         SETGRADUN();
     }
 
-    std::copy(mp.callbacks->feedback_buffer[0].begin() + sample_count, mp.callbacks->feedback_buffer[0].begin() + buffer_size, mp.callbacks->feedback_buffer[0].begin());
-    std::copy(mp.callbacks->feedback_buffer[1].begin() + sample_count, mp.callbacks->feedback_buffer[1].begin() + buffer_size, mp.callbacks->feedback_buffer[1].begin());
-    std::copy(mp.work_buffer[0].begin(), mp.work_buffer[0].begin() + sample_count, mp.callbacks->feedback_buffer[0].begin() + buffer_size - sample_count);
-    std::copy(mp.work_buffer[1].begin(), mp.work_buffer[1].begin() + sample_count, mp.callbacks->feedback_buffer[1].begin() + buffer_size - sample_count);
+    if (mp.keeps_feedback_history)
+        mp.callbacks->write_feedback(mp.last_work_audio_result ? plout : 0, sample_count);
 
-    float samplerate = float(master_info.samples_per_second);
-    float falloff = std::pow(10.0f, (-48.0f / (samplerate * 20.0f))); // vu meter falloff (-48dB/s)
-    if (mp.last_work_audio_result) {
-        if (scanPeakStereo(&mp.work_buffer[0].front(), &mp.work_buffer[1].front(), sample_count, mp.last_work_max_left, mp.last_work_max_right, falloff)) {
-            // the plugin claims it has generated non-silence, but our scan says otherwise
-            mp.writemode_errors++;
+    return flags == zzub::process_mode_write;
+}
+
+// plugins are written for at most buffer_size samples per call, larger blocks are opt in
+bool mixer::takes_whole_chunk(const metaplugin& mp, int sample_count)
+{
+    return sample_count <= (int)buffer_size || (mp.info->flags & zzub::plugin_flag_large_blocks) != 0;
+}
+
+// runs process_stereo() on pieces of buffer_size samples of a chunk that is larger than that.
+// input mixing plugins get the input() calls for a piece right before it is processed.
+bool mixer::process_stereo_pieces(plugin_descriptor plugin, metaplugin& mp, float** plin, float** plout, int sample_count, int flags, bool input_in_pieces)
+{
+    bool result = false;
+    unsigned int silent_pieces = 0;		// at most max_block_size / buffer_size pieces
+
+    for (int offset = 0, piece = 0; offset < sample_count; offset += buffer_size, piece++) {
+        int count = std::min((int)buffer_size, sample_count - offset);
+
+        if (input_in_pieces) {
+            zzub::out_edge_iterator out, out_end;
+            for (boost::tie(out, out_end) = out_edges(plugin, graph); out != out_end; ++out) {
+                edge_props& c = graph[*out];
+                if (c.conn->type != connection_type_audio) continue;
+                static_cast<audio_connection*>(c.conn)->work_range(*this, *out, offset, count, work_position);
+            }
         }
-    } else {
-        mp.last_work_max_left *= std::pow(falloff, sample_count);
-        mp.last_work_max_right *= std::pow(falloff, sample_count);
+
+        float* in[] = { plin[0] + offset, plin[1] + offset };
+        float* out[] = { plout[0] + offset, plout[1] + offset };
+        if (mp.plugin->process_stereo(in, out, count, flags))
+            result = true;
+        else
+            silent_pieces |= 1u << piece;
     }
 
-    // write recorded parameters to patterns
-    if (is_recording_parameters) {
-        int pattern_index, pattern_row;
-        if (get_currently_playing_pattern(plugin_id, pattern_index, pattern_row)) {
-            zzub::pattern& p = *mp.patterns[pattern_index];
-            transfer_plugin_parameter_row(plugin_id, 0, mp.state_automation, p, 0, pattern_row, false);
-            transfer_plugin_parameter_row(plugin_id, 1, mp.state_automation, p, 0, pattern_row, false);
-            transfer_plugin_parameter_row(plugin_id, 2, mp.state_automation, p, 0, pattern_row, false);
+    // a piece without output was not written, which only matters when another piece has output
+    if (result && silent_pieces) {
+        for (int offset = 0, piece = 0; offset < sample_count; offset += buffer_size, piece++) {
+            if ((silent_pieces & (1u << piece)) == 0) continue;
+            int count = std::min((int)buffer_size, sample_count - offset);
+            memset(plout[0] + offset, 0, count * sizeof(float));
+            memset(plout[1] + offset, 0, count * sizeof(float));
         }
     }
-
-    // clear recorded parameters - state_automation is currently written to all the time,
-    // ignoring is_recording_parameters, so we need to clear it all the time as well
-    reset_plugin_parameter_group(mp.state_automation.groups[1], mp.info->global_parameters);
-    reset_plugin_parameter_group(mp.state_automation.groups[2], mp.info->track_parameters);
-
-    // update statistics
-    mp.last_work_time = timer.frame() - start_time;
-    mp.last_work_buffersize = sample_count;
-    mp.last_work_frame = work_position;
-
-    // these are used to calculating cpu_load-per-plugin-per-buffer in op_player_get_plugins_load_snapshot::operate()
-    mp.cpu_load_time += mp.last_work_time;
-    mp.cpu_load_buffersize += sample_count;
+    return result;
 }
 
 bool mixer::plugin_update_keyjazz(int plugin_id, int note, int prev_note, int velocity, int& note_group, int& note_track, int& note_column, int& velocity_column)
@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 
 #include "libzzub/tools.h"
+#include "libzzub/kernels.h"
 
 char backslashToSlash(char c) { if (c=='\\') return '/'; return c; }
 
@@ -137,21 +138,11 @@ void AddS2SPanMC(float** output, float** input, int numSamples, float inAmp, flo
     if (inPan>1) {
         panL=2-inPan;	// when inPan>1, fade out left
     }
-    float *pI0 = input[0];
-    float *pI1 = input[1];
-    float *pO0 = output[0];
-    float *pO1 = output[1];
-    do
-    {
-        *pO0++ += *pI0++ * panL * inAmp;
-        *pO1++ += *pI1++ * panR * inAmp;
-    } while (--numSamples);
+    zzub::kernels().add_pan(output[0], output[1], input[0], input[1], numSamples, panL * inAmp, panR * inAmp);
 }
 
 void Amp(float *pout, int numsamples, float amp) {
-    for (int i=0; i<numsamples; i++) {
-        pout[i]*=amp;
-    }
+    zzub::kernels().amp(pout, numsamples, amp);
 }
 
 float linear_to_dB(float val) { 
@@ -180,11 +171,7 @@ void handleError(std::string errorTitle) {
 
 void CopyStereoToMono(float *pout, float *pin, int numsamples, float amp)
 {
-    do
-    {
-        *pout++ = (pin[0] + pin[1]) * amp;
-        pin += 2;
-    } while(--numsamples);
+    zzub::kernels().copy_stereo_to_mono(pout, pin, numsamples, amp);
 }
 
 
@@ -208,22 +195,12 @@ void AddStereoToMono(float *pout, float *pin, int numsamples, float amp, int ch)
 
 void CopyM2S(float *pout, float *pin, int numsamples, float amp)
 {
-    do
-    {
-        double s = *pin++ * amp;
-        pout[0] = (float)s;
-        pout[1] = (float)s;
-        pout += 2;
-    } while(--numsamples);
-
+    zzub::kernels().copy_mono_to_stereo(pout, pin, numsamples, amp);
 }
 
 void Add(float *pout, float *pin, int numsamples, float amp)
 {
-    do
-    {
-        *pout++ += *pin++ * amp;
-    } while(--numsamples);
+    zzub::kernels().add(pout, pin, numsamples, amp);
 }
 
 size_t sizeFromWaveFormat(int waveFormat) {
@@ -0,0 +1,249 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "libzzub/trace.h"
+
+namespace zzub {
+
+using namespace std;
+
+namespace {
+
+// the records kept between drains and saves, older records are lost when tracing runs unsaved
+const size_t max_records = 1 << 20;
+
+std::atomic<unsigned int> next_serial(1);
+
+// the ring a thread claimed from the tracer it last wrote to, given back when the thread exits
+struct ring_claim {
+    unsigned int serial;
+    int index;
+    std::shared_ptr<trace_ring> ring;
+
+    ring_claim() : serial(0), index(-1) { }
+    ~ring_claim() { release(); }
+
+    void release() {
+        if (ring) ring->claimed.store(false, std::memory_order_release);
+        ring.reset();
+        serial = 0;
+        index = -1;
+    }
+};
+
+thread_local ring_claim claim;
+
+const char* kind_names[] = {
+    "poll", "swap_wait", "chunk", "process_events", "process_stereo", "connection"
+};
+
+int bucket_of(unsigned long long ns) {
+    if (ns < 4) return (int)ns;
+    int octave = 63 - __builtin_clzll(ns);
+    int bucket = octave * 4 + (int)((ns >> (octave - 2)) & 3);
+    return std::min(bucket, (int)trace_histogram::bucket_count - 1);
+}
+
+unsigned long long bucket_end(int bucket) {
+    if (bucket < 4) return bucket + 1;
+    int octave = bucket / 4;
+    return (unsigned long long)(4 + bucket % 4 + 1) << (octave - 2);
+}
+
+void write_json_string(FILE* f, const string& s) {
+    fputc('"', f);
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+}
+
+/*! \struct trace_histogram
+    \brief Distribution of the durations of one kind of traced work.
+*/
+
+void trace_histogram::clear() {
+    memset(counts, 0, sizeof(counts));
+    count = 0;
+    max = 0;
+}
+
+void trace_histogram::add(unsigned long long ns) {
+    counts[bucket_of(ns)]++;
+    count++;
+    if (ns > max) max = ns;
+}
+
+unsigned long long trace_histogram::percentile(double p) const {
+    if (count == 0) return 0;
+    unsigned long long target = (unsigned long long)(p * (count - 1)) + 1;
+    unsigned long long seen = 0;
+    for (int i = 0; i < bucket_count; i++) {
+        seen += counts[i];
+        if (seen >= target) return std::min(bucket_end(i), max);
+    }
+    return max;
+}
+
+/*! \struct tracer
+    \brief Collects timestamped records of the work done on the audio and worker threads.
+*/
+
+tracer::tracer() : enabled(false), ring_count(0), ringless(0) {
+    serial = next_serial.fetch_add(1);
+    dropped = 0;
+}
+
+void tracer::enable(int thread_count) {
+    std::lock_guard<std::mutex> lock(drain_lock);
+    reserve(thread_count);
+
+    // leftovers from an earlier session are discarded
+    for (int i = 0; i < ring_count.load(); i++) {
+        rings[i]->tail.store(rings[i]->head.load(std::memory_order_acquire), std::memory_order_release);
+        rings[i]->dropped.store(0);
+    }
+    records.clear();
+    plugin_histograms.clear();
+    dropped = 0;
+    ringless.store(0);
+    enabled.store(true);
+}
+
+void tracer::disable() {
+    enabled.store(false);
+}
+
+void tracer::reserve(int thread_count) {
+    // threads of an earlier worker pool that are still running keep their rings
+    int count = ring_count.load();
+    int claimed = 0;
+    for (int i = 0; i < count; i++)
+        if (rings[i]->claimed.load(std::memory_order_acquire)) claimed++;
+
+    int wanted = std::min(claimed + thread_count, (int)max_rings);
+    for (int i = count; i < wanted; i++) {
+        rings[i] = std::make_shared<trace_ring>();
+        ring_count.store(i + 1, std::memory_order_release);
+    }
+}
+
+trace_ring* tracer::claim_ring() {
+    if (claim.serial == serial) return claim.ring.get();
+
+    // a thread that moves to another player gives up the ring of the previous one
+    claim.release();
+    int count = ring_count.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        bool expected = false;
+        if (rings[i]->claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            claim.serial = serial;
+            claim.index = i;
+            claim.ring = rings[i];
+            return rings[i].get();
+        }
+    }
+    return 0;
+}
+
+void tracer::write(int kind, int id, int arg, unsigned long long begin, unsigned long long end) {
+    trace_ring* ring = claim_ring();
+    if (!ring) {
+        ringless.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    trace_record r = { begin, end, kind, id, arg, claim.index };
+    ring->push(r);
+}
+
+void tracer::drain() {
+    std::lock_guard<std::mutex> lock(drain_lock);
+    int count = ring_count.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        trace_ring& ring = *rings[i];
+        unsigned int h = ring.head.load(std::memory_order_acquire);
+        unsigned int t = ring.tail.load(std::memory_order_relaxed);
+        for (; t != h; t++) {
+            const trace_record& r = ring.records[t & (trace_ring::capacity - 1)];
+            if (r.kind == trace_kind_process_stereo)
+                plugin_histograms[r.id].add(r.end - r.begin);
+            if (records.size() < max_records)
+                records.push_back(r);
+            else
+                dropped++;
+        }
+        ring.tail.store(t, std::memory_order_release);
+        dropped += ring.dropped.exchange(0);
+    }
+    dropped += ringless.exchange(0);
+}
+
+int tracer::save_chrome_trace(const std::string& path, const std::function<std::string(int)>& plugin_name) {
+    drain();
+
+    std::lock_guard<std::mutex> lock(drain_lock);
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) return -1;
+
+    unsigned long long origin = ~0ULL;
+    int thread_count = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        origin = std::min(origin, records[i].begin);
+        thread_count = std::max(thread_count, records[i].thread + 1);
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (int i = 0; i < thread_count; i++)
+        fprintf(f, "{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"zzub %d\"}},\n", i, i);
+
+    for (size_t i = 0; i < records.size(); i++) {
+        const trace_record& r = records[i];
+        const char* kind = kind_names[r.kind];
+        fprintf(f, "{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"cat\":\"%s\",\"name\":",
+            r.thread, (r.begin - origin) / 1000.0, (r.end - r.begin) / 1000.0, kind);
+        if (r.id != -1 && plugin_name)
+            write_json_string(f, plugin_name(r.id));
+        else
+            write_json_string(f, kind);
+        if (r.arg != -1) {
+            fprintf(f, ",\"args\":{\"from\":");
+            write_json_string(f, plugin_name ? plugin_name(r.arg) : std::to_string(r.arg));
+            fprintf(f, "}");
+        }
+        fprintf(f, "},\n");
+    }
+    fprintf(f, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"zzub\",\"dropped\":%llu}}\n]}\n", dropped);
+
+    int written = (int)records.size();
+    bool ok = ferror(f) == 0;
+    if (fclose(f) != 0) ok = false;
+    records.clear();
+    dropped = 0;
+    return ok ? written : -1;
+}
+
+}
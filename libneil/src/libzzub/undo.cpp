@@ -111,10 +111,84 @@ undo_manager::undo_manager() {
     swap_mode = false;
     is_flushing = false;
     ignore_undo = false;
+    sample_retainers = 0;
+    song_build_depth = 0;
+    song_build_ignore_undo = false;
 }
 
 undo_manager::~undo_manager() {
     clear_history();
+    for (size_t i = 0; i < retired_samples.size(); i++)
+        delete[] retired_samples[i];
+}
+
+// keeps the sample data of the current song alive until the matching release_samples(),
+// even if the levels are edited or deleted meanwhile. user thread only.
+void undo_manager::retain_samples() {
+    sample_retainers++;
+}
+
+void undo_manager::release_samples() {
+    assert(sample_retainers > 0);
+    if (--sample_retainers > 0) return;
+    for (size_t i = 0; i < retired_samples.size(); i++)
+        delete[] retired_samples[i];
+    retired_samples.clear();
+}
+
+// starts building a song from many operations in one go, e.g while loading a song. the
+// backbuffer gets a copy of everything up front, so the operations skip merging copy flags,
+// no undo operations are kept, the work order is made once and flushes are deferred until
+// the matching end_song_build() swaps the new song in. calls may nest. user thread only.
+void undo_manager::begin_song_build() {
+    if (song_build_depth++ > 0) return;
+
+    flush_operations(0, 0, 0);
+
+    operation_copy_flags flags;
+    flags.copy_graph = true;
+    flags.copy_work_order = true;
+    flags.copy_midi_mappings = true;
+    flags.copy_sequencer_tracks = true;
+    flags.copy_wavetable = true;
+    flags.copy_song_variables = true;
+    flags.copy_plugins = true;
+    for (int i = 0; i < (int)front.plugins.size(); i++) {
+        if (front.plugins[i] == 0) continue;
+        operation_copy_plugin_flags& pflags = flags.get_plugin_flags(i);
+        pflags.copy_plugin = true;
+        pflags.copy_patterns = true;
+    }
+    for (int i = 0; i < (int)front.wavetable.waves.size(); i++)
+        flags.get_wave_flags(i).copy_wave = true;
+    merge_backbuffer_flags(flags);
+
+    back.defer_work_order = true;
+    song_build_ignore_undo = ignore_undo;
+    ignore_undo = true;
+}
+
+void undo_manager::end_song_build() {
+    assert(song_build_depth > 0);
+    if (song_build_depth > 1) {
+        song_build_depth--;
+        return;
+    }
+
+    back.defer_work_order = false;
+    back.make_work_order();
+    ignore_undo = song_build_ignore_undo;
+
+    // the backbuffer holds copies of everything, so it is swapped in even without operations
+    song_build_depth = 0;
+    if (backbuffer_operations.empty())
+        wait_swap_song_pointers();
+
+    // the operations are not in the history, so they are freed after they finished
+    ops built = backbuffer_operations;
+    flush_operations(0, 0, 0);
+    for (size_t i = 0; i < built.size(); i++)
+        delete built[i];
 }
 
 void undo_manager::free_operations(undoableoperation& op) {
@@ -212,13 +286,34 @@ bool undo_manager::execute_operation_undo(undoableoperation& undoableop) {
     return result;
 }
 
+// the audio thread only hands out slots that exist and reads the feedback histories of the
+// plugins, so the arena is grown and the histories are allocated with swap_lock held, while
+// the audio thread is not rendering from them.
+static void prepare_work_buffers(zzub::mixer& front, zzub::song& back) {
+    front.work_buffers.reserve(back.work_buffer_slot_count);
+    for (size_t i = 0; i < back.plugins.size() && i < back.work_feedback_history.size(); i++) {
+        if (back.plugins[i] != 0 && back.work_feedback_history[i])
+            back.plugins[i]->callbacks->enable_feedback_history();
+    }
+}
+
 void undo_manager::wait_swap_song_pointers() {
+    if (backbuffer_flags.copy_sequencer_tracks)
+        back.update_sequencer_index();
+
     if (swap_mode) {
+        if (backbuffer_flags.copy_work_order) {
+            swap_lock.lock();
+            prepare_work_buffers(front, back);
+            swap_lock.unlock();
+        }
         swap_operations_commit = true;
         swap_operations_signal.wait();
         clear_swap_song(back, backbuffer_flags);
     } else {
         swap_lock.lock();
+        if (backbuffer_flags.copy_work_order)
+            prepare_work_buffers(front, back);
         write_swap_song(back, backbuffer_flags);
         for (size_t i = 0; i < backbuffer_operations.size(); i++) {
             backbuffer_operations[i]->operate(front);
@@ -325,6 +420,11 @@ bool undo_manager::prepare_operation_redo(operation* singleop) {
 }
 
 void undo_manager::prepare_operation_undo(operation* singleop) {
+    if (song_build_depth > 0) {
+        delete singleop;
+        return;
+    }
+
     // make sure this operation is added to the undo-buffer
     // we assume undo operations are added in reverse order, so we put each element IN FRONT
     // we _could_ have looped backwards, but right now we have two mechanisms for this, better not get in the way
@@ -334,6 +434,9 @@ void undo_manager::prepare_operation_undo(operation* singleop) {
 
 // this is now flush_operations
 void undo_manager::flush_operations(zzub_event_data_t* do_event, zzub_event_data_t* redo_event, zzub_event_data_t* undo_event) {
+    // the song being built is swapped in once by end_song_build()
+    if (song_build_depth > 0) return;
+
     assert(!is_flushing);
     is_flushing = true;
     if (backbuffer_operations.size() > 0) {
@@ -380,6 +483,12 @@ void undo_manager::flush_operations(zzub_event_data_t* do_event, zzub_event_data
 
 void undo_manager::merge_backbuffer_flags(operation_copy_flags flags) {
 
+    // everything but the sample data was copied by begin_song_build()
+    if (song_build_depth > 0) {
+        merge_wavelevel_flags(flags);
+        return;
+    }
+
     if (!backbuffer_flags.copy_graph && flags.copy_graph)
         back.graph = front.graph;
 
@@ -407,8 +516,14 @@ void undo_manager::merge_backbuffer_flags(operation_copy_flags flags) {
     if (!backbuffer_flags.copy_wavetable && flags.copy_wavetable)
         back.wavetable = front.wavetable;
 
-    if (!backbuffer_flags.copy_work_order && flags.copy_work_order)
+    if (!backbuffer_flags.copy_work_order && flags.copy_work_order) {
         back.work_order = front.work_order;
+        back.cv_work_order = front.cv_work_order;
+        back.work_levels = front.work_levels;
+        back.work_buffer_slots = front.work_buffer_slots;
+        back.work_buffer_slot_count = front.work_buffer_slot_count;
+        back.work_feedback_history = front.work_feedback_history;
+    }
 
     // if player_flags_copy_plugins_deep is set we generate flags to copy all the plugins
     if (!backbuffer_flags.copy_plugins_deep && flags.copy_plugins_deep) {
@@ -465,6 +580,26 @@ void undo_manager::merge_backbuffer_flags(operation_copy_flags flags) {
         }
     }
 
+    merge_wavelevel_flags(flags);
+
+    for (size_t i = 0; i < flags.pattern_flags.size(); i++) {
+        const operation_copy_pattern_flags& pflags = flags.pattern_flags[i];
+        operation_copy_pattern_flags& bflags = backbuffer_flags.get_pattern_flags(pflags.plugin_id, pflags.index);
+
+        // check if this pattern was already copied via the plugin before we do anything
+        operation_copy_plugin_flags& pluginflags = backbuffer_flags.get_plugin_flags(pflags.plugin_id);
+        if (pluginflags.copy_patterns) continue;
+
+        metaplugin& tp = *back.plugins[pflags.plugin_id];
+        if (!bflags.copy_pattern && pflags.copy_pattern) {
+            tp.patterns[pflags.index] = new pattern(*tp.patterns[pflags.index]);
+        }
+    }
+
+    backbuffer_flags.merge(flags);
+}
+
+void undo_manager::merge_wavelevel_flags(const operation_copy_flags& flags) {
     for (size_t i = 0; i < flags.wavelevel_flags.size(); i++) {
         const operation_copy_wavelevel_flags& wflags = flags.wavelevel_flags[i];
         operation_copy_wavelevel_flags& bflags = backbuffer_flags.get_wavelevel_flags(wflags.wave, wflags.level);
@@ -483,32 +618,28 @@ void undo_manager::merge_backbuffer_flags(operation_copy_flags flags) {
                 int sample_bytes = bytes_per_sample * channels * numsamples + extended_bytes;
                 void* newsamples = new char[sample_bytes];
                 memcpy(newsamples, sw.levels[wflags.level].legacy_sample_ptr, sample_bytes);
-                sw.levels[wflags.level].legacy_sample_ptr = (short*)newsamples;
-                sw.levels[wflags.level].samples = (short*)(((char*)newsamples) + extended_bytes);
+                wave_level_ex& l = sw.levels[wflags.level];
+                bool peaks_match = l.peaks && l.peaks->matches(sw, l);
+                l.legacy_sample_ptr = (short*)newsamples;
+                l.samples = (short*)(((char*)newsamples) + extended_bytes);
+                // the copy has the same samples, so the digest summary stays valid
+                if (peaks_match) {
+                    l.peaks = std::make_shared<wave_peaks>(*l.peaks);
+                    l.peaks->samples = l.samples;
+                }
             }
+            bflags.copy_samples = true;
         }
     }
-
-    for (size_t i = 0; i < flags.pattern_flags.size(); i++) {
-        const operation_copy_pattern_flags& pflags = flags.pattern_flags[i];
-        operation_copy_pattern_flags& bflags = backbuffer_flags.get_pattern_flags(pflags.plugin_id, pflags.index);
-
-        // check if this pattern was already copied via the plugin before we do anything
-        operation_copy_plugin_flags& pluginflags = backbuffer_flags.get_plugin_flags(pflags.plugin_id);
-        if (pluginflags.copy_patterns) continue;
-
-        metaplugin& tp = *back.plugins[pflags.plugin_id];
-        if (!bflags.copy_pattern && pflags.copy_pattern) {
-            tp.patterns[pflags.index] = new pattern(*tp.patterns[pflags.index]);
-        }
-    }
-
-    backbuffer_flags.merge(flags);
 }
 
+// publishes the backbuffer to the running song. this may run on the audio thread (see
+// poll_operations()) so everything here is an O(1) swap of container internals: the audio
+// thread never copies or allocates during a commit. the previous front data ends up in
+// the backbuffer and is released on the user thread when the backbuffer is reset().
 void undo_manager::write_swap_song(zzub::song& song, const operation_copy_flags& flags) {
     if (flags.copy_graph)
-        front.graph = song.graph;
+        front.graph.swap(song.graph);
 
     //	if (flags.copy_keyjazz)
     //		front.keyjazz.swap(song.keyjazz);
@@ -521,6 +652,8 @@ void undo_manager::write_swap_song(zzub::song& song, const operation_copy_flags&
 
     if (flags.copy_sequencer_tracks) {
         front.sequencer_tracks.swap(song.sequencer_tracks);
+        front.plugin_sequencer_tracks.swap(song.plugin_sequencer_tracks);
+        front.sequencer_cursors.swap(song.sequencer_cursors);
         // the sequencer was modified - update internal sequencer states
         front.sequencer_update_play_pattern_positions();
     }
@@ -537,8 +670,18 @@ void undo_manager::write_swap_song(zzub::song& song, const operation_copy_flags&
         front.wavetable.waves.swap(song.wavetable.waves);
     }
 
-    if (flags.copy_work_order)
+    if (flags.copy_work_order) {
         front.work_order.swap(song.work_order);
+        front.cv_work_order.swap(song.cv_work_order);
+        front.work_levels.swap(song.work_levels);
+        front.work_buffer_slots.swap(song.work_buffer_slots);
+        std::swap(front.work_buffer_slot_count, song.work_buffer_slot_count);
+        front.work_feedback_history.swap(song.work_feedback_history);
+    }
+
+    // copied plugins may carry slots from before a block size change
+    if (flags.copy_work_order || flags.copy_plugins)
+        front.assign_work_buffers();
 }
 
 void undo_manager::clear_swap_song(zzub::song& song, const operation_copy_flags& flags) {
@@ -571,8 +714,13 @@ void undo_manager::clear_swap_song(zzub::song& song, const operation_copy_flags&
 
         const operation_copy_wavelevel_flags& wflags = flags.wavelevel_flags[i];
         if (wflags.copy_samples)
-            if ((size_t)wflags.level < song.wavetable.waves[wflags.wave]->levels.size())
-                delete[] song.wavetable.waves[wflags.wave]->levels[wflags.level].legacy_sample_ptr;
+            if ((size_t)wflags.level < song.wavetable.waves[wflags.wave]->levels.size()) {
+                short* samples = song.wavetable.waves[wflags.wave]->levels[wflags.level].legacy_sample_ptr;
+                if (sample_retainers > 0)
+                    retired_samples.push_back(samples);
+                else
+                    delete[] samples;
+            }
     }
 
     for (size_t i = 0; i < flags.wave_flags.size(); i++) {
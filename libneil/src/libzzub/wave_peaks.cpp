@@ -0,0 +1,245 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libzzub/common.h"
+#include "libzzub/wave_peaks.h"
+
+namespace zzub {
+
+namespace {
+
+// reads single samples of a wave level as floats
+struct sample_reader {
+    const unsigned char* samples;
+    int bps;
+    int channels;
+    wave_buffer_type format;
+    float scaler;
+
+    sample_reader(const wave_info_ex& w, const wave_level_ex& l) {
+        samples = (const unsigned char*)l.samples;
+        bps = l.get_bytes_per_sample();
+        channels = w.get_stereo() ? 2 : 1;
+        format = (wave_buffer_type)l.format;
+        scaler = 1.0f / (1 << (bps * 8 - 1));
+    }
+
+    float operator()(int s, int channel) const {
+        int offset = (s * channels + channel) * bps;
+        int isample = 0;
+        switch (bps) {
+        case 1:
+            isample = *(const char*)&samples[offset];
+            break;
+        case 2:
+            isample = *(const short*)&samples[offset];
+            break;
+        case 3:
+            isample = *(const int*)&samples[offset] & 0x00ffffff;
+            if (isample & 0x00800000)
+                isample = isample | 0xFF000000;
+            break;
+        case 4:
+            switch (format) {
+            case wave_buffer_type_si32:
+                isample = *(const int*)&samples[offset];
+                break;
+            case wave_buffer_type_f32:
+                isample = (int)((*(const float*)&samples[offset]) / scaler);
+                break;
+            default:
+                break;
+            }
+            break;
+        }
+        return (float)isample * scaler;
+    }
+};
+
+inline void merge(wave_peaks::entry& e, const wave_peaks::entry& other) {
+    e.min = std::min(e.min, other.min);
+    e.max = std::max(e.max, other.max);
+    e.power += other.power;
+}
+
+// adds the samples in [start, end) to the running min, max and power. whole blocks are read
+// from the highest level that fits, only the unaligned ends are read from the samples.
+void accumulate(const wave_peaks& p, const sample_reader& read, int channel, int start, int end, float& minsample, float& maxsample, double& power) {
+    const int block_size = wave_peaks::block_size;
+    int pos = start;
+
+    int head_end = std::min(end, (start + block_size - 1) / block_size * block_size);
+    for (; pos < head_end; pos++) {
+        float sample = read(pos, channel);
+        minsample = std::min(minsample, sample);
+        maxsample = std::max(maxsample, sample);
+        power += sample * sample;
+    }
+
+    while (end - pos >= block_size) {
+        int k = 0;
+        while (k + 1 < (int)p.levels.size() && pos % (block_size << (k + 1)) == 0 && pos + (block_size << (k + 1)) <= end)
+            k++;
+        const wave_peaks::entry& e = p.levels[k][(pos / (block_size << k)) * p.channels + channel];
+        minsample = std::min(minsample, e.min);
+        maxsample = std::max(maxsample, e.max);
+        power += e.power;
+        pos += block_size << k;
+    }
+
+    for (; pos < end; pos++) {
+        float sample = read(pos, channel);
+        minsample = std::min(minsample, sample);
+        maxsample = std::max(maxsample, sample);
+        power += sample * sample;
+    }
+}
+
+void set_source(wave_peaks& p, const wave_info_ex& w, const wave_level_ex& l) {
+    p.samples = l.samples;
+    p.sample_count = l.sample_count;
+    p.format = l.format;
+    p.channels = w.get_stereo() ? 2 : 1;
+}
+
+}
+
+wave_peaks::wave_peaks() {
+    samples = 0;
+    sample_count = 0;
+    format = wave_buffer_type_si16;
+    channels = 1;
+    valid_samples = 0;
+}
+
+bool wave_peaks::matches(const wave_info_ex& w, const wave_level_ex& l) const {
+    return samples == l.samples && sample_count == l.sample_count && format == l.format && channels == (w.get_stereo() ? 2 : 1);
+}
+
+void wave_peaks::update(const wave_info_ex& w, const wave_level_ex& l) {
+    sample_reader read(w, l);
+    int blocks = (sample_count + block_size - 1) / block_size;
+
+    if (levels.empty()) levels.resize(1);
+    levels[0].resize(blocks * channels);
+
+    for (int b = valid_samples / block_size; b < blocks; b++) {
+        int first = b * block_size;
+        int last = std::min(first + block_size, sample_count);
+        for (int c = 0; c < channels; c++) {
+            float sample = read(first, c);
+            entry e = { sample, sample, sample * sample };
+            for (int s = first + 1; s < last; s++) {
+                sample = read(s, c);
+                e.min = std::min(e.min, sample);
+                e.max = std::max(e.max, sample);
+                e.power += sample * sample;
+            }
+            levels[0][b * channels + c] = e;
+        }
+    }
+
+    merge_levels(valid_samples);
+    valid_samples = sample_count;
+}
+
+void wave_peaks::merge_levels(int first_sample) {
+    for (size_t k = 1; ; k++) {
+        int below = (int)levels[k - 1].size() / channels;
+        if (below <= 1) {
+            levels.resize(k);
+            break;
+        }
+
+        int count = (below + 1) / 2;
+        if (levels.size() <= k) levels.resize(k + 1);
+        levels[k].resize(count * channels);
+
+        for (int j = first_sample / (block_size << k); j < count; j++) {
+            for (int c = 0; c < channels; c++) {
+                entry e = levels[k - 1][(2 * j) * channels + c];
+                if (2 * j + 1 < below)
+                    merge(e, levels[k - 1][(2 * j + 1) * channels + c]);
+                levels[k][j * channels + c] = e;
+            }
+        }
+    }
+}
+
+const wave_peaks& get_wave_peaks(wave_info_ex& w, wave_level_ex& l) {
+    if (!l.peaks || !l.peaks->matches(w, l)) {
+        l.peaks = std::make_shared<wave_peaks>();
+        set_source(*l.peaks, w, l);
+    }
+    if (l.peaks->valid_samples < l.sample_count)
+        l.peaks->update(w, l);
+    return *l.peaks;
+}
+
+void invalidate_wave_peaks(wave_info_ex& w, wave_level_ex& l, const std::shared_ptr<wave_peaks>& old_peaks, int pos) {
+    if (!old_peaks || old_peaks->format != l.format || old_peaks->channels != (w.get_stereo() ? 2 : 1)) {
+        l.peaks.reset();
+        return;
+    }
+
+    // the old summary may still be used by the level in the other song buffer
+    std::shared_ptr<wave_peaks> p = std::make_shared<wave_peaks>(*old_peaks);
+    set_source(*p, w, l);
+    p->valid_samples = std::min(std::min(old_peaks->valid_samples, pos), l.sample_count) / wave_peaks::block_size * wave_peaks::block_size;
+    l.peaks = p;
+}
+
+void get_wave_digest(wave_info_ex& w, wave_level_ex& l, int channel, int start, int end, float* mindigest, float* maxdigest, float* ampdigest, int digestsize) {
+    sample_reader read(w, l);
+    int samplerange = end - start;
+    assert(samplerange > 0);
+    float sps = (float)samplerange / (float)digestsize; // samples per sample
+    float blockstart = (float)start;
+
+    if (sps > 1) {
+        const wave_peaks& p = get_wave_peaks(w, l);
+        for (int i = 0; i < digestsize; ++i) {
+            float blockend = std::min(blockstart + sps, (float)end);
+            float minsample = 1.0f;
+            float maxsample = -1.0f;
+            double power = 0.0;
+            int first = std::max((int)blockstart, 0);
+            int last = std::min((int)blockend, l.sample_count);
+            if (first < last)
+                accumulate(p, read, channel, first, last, minsample, maxsample, power);
+            if (mindigest)
+                mindigest[i] = minsample;
+            if (maxdigest)
+                maxdigest[i] = maxsample;
+            if (ampdigest)
+                ampdigest[i] = sqrtf((float)power / (blockend - blockstart));
+            blockstart = blockend;
+        }
+    } else {
+        for (int i = 0; i < digestsize; ++i) {
+            int s = (int)(blockstart + i * sps /* + 0.5f */);
+            float sample = read(s, channel);
+            if (mindigest)
+                mindigest[i] = sample;
+            if (maxdigest)
+                maxdigest[i] = sample;
+            if (ampdigest)
+                ampdigest[i] = std::abs(sample);
+        }
+    }
+}
+
+}
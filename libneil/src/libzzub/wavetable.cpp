@@ -139,6 +139,7 @@ bool wave_info_ex::reallocate_level(size_t level, size_t samples) {
     }
 
     l->sample_count = (int)samples;
+    levels[level].peaks.reset();
     l->legacy_sample_count = samplesIn16Bit;
     l->legacy_sample_ptr = pSamples;
     l->samples = pSamples + (get_extended() ? 4 : 0);
@@ -217,6 +218,7 @@ bool wave_info_ex::allocate_level(size_t level, size_t numSamples, zzub::wave_bu
 
     l->legacy_sample_ptr = (short*)new char[waveBufferSize];
     l->samples = l->legacy_sample_ptr + (allocExtended?4:0);
+    levels[level].peaks.reset();
     l->sample_count = numSamples;
     l->loop_start = 0;
     l->loop_end = numSamples;
@@ -0,0 +1,260 @@
+/*
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libzzub/common.h"
+#include "libzzub/work_scheduler.h"
+
+#include <sched.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#define cpu_relax() _mm_pause()
+#else
+#define cpu_relax() sched_yield()
+#endif
+
+namespace zzub {
+
+namespace {
+
+inline unsigned long long make_cursor(int level, int index) {
+    return ((unsigned long long)(unsigned int)level << 32) | (unsigned int)index;
+}
+
+inline int cursor_level(unsigned long long cursor) {
+    return (int)(cursor >> 32);
+}
+
+inline int cursor_index(unsigned long long cursor) {
+    return (int)(cursor & 0xffffffffULL);
+}
+
+const int no_level = 0x7fffffff;
+
+}
+
+
+work_scheduler::work_scheduler()
+    : mode(work_mode_serial)
+    , block_size(zzub::buffer_size)
+    , quit(false)
+    , cycle_mixer(0)
+    , cycle_levels(0)
+    , cycle_sample_count(0)
+    , cursor(make_cursor(no_level, 0))
+    , pending(0)
+    , cycle_done(true)
+    , running(0)
+{
+    sem_init(&start_signal, 0, 0);
+}
+
+work_scheduler::~work_scheduler() {
+    stop_workers();
+    sem_destroy(&start_signal);
+}
+
+void work_scheduler::configure(work_mode mode, int thread_count) {
+    if (thread_count < 0) thread_count = 0;
+    if (thread_count > max_threads) thread_count = max_threads;
+    if (mode == work_mode_serial) thread_count = 0;
+
+    this->mode = mode;
+
+    if (thread_count == (int)workers.size()) return;
+
+    stop_workers();
+    start_workers(thread_count);
+}
+
+void work_scheduler::start_workers(int thread_count) {
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count < 1) cpu_count = 1;
+
+    quit.store(false);
+
+    for (int i = 0; i < thread_count; i++) {
+        worker_thread* w = new worker_thread();
+        w->owner = this;
+        w->index = i;
+        w->mix_arena.set_block_size(block_size);
+        w->mix_arena.reserve(1);
+        w->mix_buffer[0] = w->mix_arena.get_channel(0, 0);
+        w->mix_buffer[1] = w->mix_arena.get_channel(0, 1);
+
+        if (pthread_create(&w->thread, 0, &work_scheduler::thread_proc, w) != 0) {
+            std::cerr << "work_scheduler: cannot create worker thread " << i << std::endl;
+            delete w;
+            break;
+        }
+
+        // the audio thread keeps running wherever the driver put it, workers are spread over the other cores
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET((i + 1) % cpu_count, &cpus);
+        pthread_setaffinity_np(w->thread, sizeof(cpus), &cpus);
+
+        sched_param param;
+        param.sched_priority = worker_priority;
+        pthread_setschedparam(w->thread, SCHED_FIFO, &param);
+
+        workers.push_back(w);
+    }
+}
+
+void work_scheduler::stop_workers() {
+    if (workers.empty()) return;
+
+    quit.store(true);
+    for (size_t i = 0; i < workers.size(); i++)
+        sem_post(&start_signal);
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        pthread_join(workers[i]->thread, 0);
+        delete workers[i];
+    }
+    workers.clear();
+}
+
+void* work_scheduler::thread_proc(void* param) {
+    worker_thread* w = (worker_thread*)param;
+    w->owner->worker(*w);
+    return 0;
+}
+
+void work_scheduler::worker(worker_thread& w) {
+    for (;;) {
+        sem_wait(&start_signal);
+        if (quit.load(std::memory_order_acquire)) break;
+
+        // register before looking at the cycle. a worker that wakes up late sees
+        // cycle_done and goes back to sleep without touching the cycle state.
+        running.fetch_add(1, std::memory_order_seq_cst);
+        if (!cycle_done.load(std::memory_order_seq_cst)) {
+            rtcheck_scope rt;
+            int last_level = -1;
+            for (;;) {
+                int level = cursor_level(cursor.load(std::memory_order_acquire));
+                if (level != no_level && level != last_level) {
+                    last_level = level;
+                    work_level_plugins(level, w.mix_buffer);
+                } else if (cycle_done.load(std::memory_order_acquire)) {
+                    break;
+                } else {
+                    cpu_relax();
+                }
+            }
+        }
+
+        running.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+// claims and processes plugins of the given level until the level is exhausted or
+// the audio thread has moved on to another level
+void work_scheduler::work_level_plugins(int level, float** mix_buffer) {
+    const std::vector<plugin_descriptor>& plugins = (*cycle_levels)[level].parallel;
+    int count = (int)plugins.size();
+
+    unsigned long long current = cursor.load(std::memory_order_acquire);
+    for (;;) {
+        if (cursor_level(current) != level || cursor_index(current) >= count)
+            return;
+        if (!cursor.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            continue;
+
+        cycle_mixer->work_plugin(plugins[cursor_index(current)], cycle_sample_count, mix_buffer);
+        pending.fetch_sub(1, std::memory_order_release);
+        current = cursor.load(std::memory_order_acquire);
+    }
+}
+
+// like configure(), not while the audio thread is inside run()
+void work_scheduler::set_block_size(int size) {
+    block_size = size;
+    for (size_t i = 0; i < workers.size(); i++) {
+        worker_thread& w = *workers[i];
+        w.mix_arena.set_block_size(size);
+        w.mix_buffer[0] = w.mix_arena.get_channel(0, 0);
+        w.mix_buffer[1] = w.mix_arena.get_channel(0, 1);
+    }
+}
+
+size_t work_scheduler::get_scratch_size() const {
+    size_t size = 0;
+    for (size_t i = 0; i < workers.size(); i++)
+        size += workers[i]->mix_arena.get_size();
+    return size;
+}
+
+void work_scheduler::run(mixer& m, const std::vector<work_level>& levels, int sample_count) {
+    if (mode == work_mode_serial || workers.empty() || levels.empty()) {
+        for (size_t l = 0; l < levels.size(); l++) {
+            for (auto plugin_desc : levels[l].parallel)
+                m.work_plugin(plugin_desc, sample_count);
+            for (auto plugin_desc : levels[l].serial)
+                m.work_plugin(plugin_desc, sample_count);
+        }
+        return;
+    }
+
+    // levels with a single plugin run inline, the pool is only woken at the first
+    // level that has plugins to share. a graph without such a level never touches it.
+    bool engaged = false;
+
+    for (size_t l = 0; l < levels.size(); l++) {
+        const work_level& level = levels[l];
+
+        if (level.parallel.size() == 1) {
+            m.work_plugin(level.parallel[0], sample_count);
+        } else if (level.parallel.size() > 1) {
+            if (!engaged) {
+                cycle_mixer = &m;
+                cycle_levels = &levels;
+                cycle_sample_count = sample_count;
+                cycle_done.store(false, std::memory_order_seq_cst);
+                for (size_t i = 0; i < workers.size(); i++)
+                    sem_post(&start_signal);
+                engaged = true;
+            }
+
+            pending.store((int)level.parallel.size(), std::memory_order_relaxed);
+            cursor.store(make_cursor((int)l, 0), std::memory_order_release);
+
+            work_level_plugins((int)l, m.mix_buffer);
+
+            // wait for plugins claimed by the workers
+            while (pending.load(std::memory_order_acquire) > 0)
+                cpu_relax();
+        }
+
+        for (auto plugin_desc : level.serial) {
+            m.work_plugin(plugin_desc, sample_count);
+        }
+    }
+
+    if (!engaged) return;
+
+    cursor.store(make_cursor(no_level, 0), std::memory_order_relaxed);
+    cycle_done.store(true, std::memory_order_seq_cst);
+
+    // workers that joined the cycle must have left it before the song can be modified
+    // by poll_operations(). workers that have not woken up yet are not waited for.
+    while (running.load(std::memory_order_seq_cst) > 0)
+        cpu_relax();
+}
+
+}
@@ -96,6 +96,7 @@ struct LunarVerbInfo : zzub::info {
     this->short_name = "Verb";
     this->author = "SoMono";
     this->uri = "@trac.zeitherrschaft.org/aldrin/lunar/effect/reverb;1";
+    this->tail_length = zzub::tail_length_auto;
     para_roomsize = &add_global_parameter()
       .set_word()
       .set_name("Room Size")
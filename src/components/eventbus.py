@@ -65,6 +65,7 @@ EVENTS = [
     'zzub_disconnect', # ( from_plugin,to_plugin,type,... )
     'zzub_double_click', # ( ... )
     'zzub_edit_pattern', # ( plugin,index,group,track,column,row,value,... )
+    'zzub_edit_pattern_block', # ( plugin,index,row,rows,... )
     'zzub_envelope_changed', # ( ... )
     'zzub_load_progress', # ( ... )
     'zzub_midi_control', # ( status,data1,data2,... )
@@ -84,6 +85,7 @@ EVENTS = [
     'zzub_pre_delete_plugin', # ( plugin,... )
     'zzub_pre_disconnect', # ( from_plugin,to_plugin,type,... )
     'zzub_pre_set_tracks', # ( plugin,... )
+    'zzub_save_complete', # ( id,result,... )
     'zzub_sequencer_add_track', # ( plugin,... )
     'zzub_sequencer_changed', # ( plugin,track,time,... )
     'zzub_sequencer_remove_track', # ( plugin,... ) ## FIXME has been renamed in zzub as sequence.destroy
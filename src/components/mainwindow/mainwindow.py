@@ -590,15 +590,17 @@ class NeilFrame(Gtk.Window):
             progBar.show()
             dlg.get_content_area().pack_start(progBar, True, True, 0)
             dlg.show()
-            done = False
-            def progress_callback():
-                progBar.pulse()
-                return not done
+            def progress_callback(player_, done, total, tag):
+                progBar.set_fraction(float(done) / total)
+                ui.refresh_gui()
             progBar.pulse()
             ui.refresh_gui()
-            GLib.timeout_add(50, progress_callback)
-            player.load_ccm(filename)
-            done = True
+            callback = zzub.zzub_ccm_progress_callback_t(progress_callback)
+            player.set_ccm_progress_callback(callback, None)
+            try:
+                player.load_ccm(filename)
+            finally:
+                player.set_ccm_progress_callback(None, None)
             # The following loads sequencer step size.
             try:
                 seq = views.get_sequencer()
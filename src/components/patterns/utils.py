@@ -1,7 +1,9 @@
 from neil.utils import note2str, switch2str, byte2str, word2str
 from enum import IntEnum
+from ctypes import c_int, sizeof
 
 import config
+import zzub
 
 
 
@@ -32,6 +34,74 @@ class PatternSelection:
     # mode = SEL_COLUMN
     mode = SelectionMode.Column
 
+
+class PatternData:
+    """
+    Local copy of the values in a pattern.
+
+    The values are fetched in one call to zzub_plugin_get_pattern_values instead of one
+    call per cell, into a buffer that is reused between reads. view() exposes the buffer
+    through the buffer protocol, so numpy.asarray(data.view()) gives a rows x columns
+    array without copying.
+    """
+    def __init__(self):
+        self.plugin = None
+        self.pattern = -1
+        self.rows = 0
+        self.columns = 0
+        self.buffer = (c_int * 0)()
+        self.offsets = {}
+
+    def read(self, plugin, pattern):
+        """
+        Reads the whole pattern.
+        """
+        self.plugin = plugin
+        self.pattern = pattern
+        self.rows = plugin.get_pattern_length(pattern)
+        self.columns = plugin.get_pattern_column_count()
+        self.offsets = {}
+        size = self.rows * self.columns
+        if len(self.buffer) != size:
+            self.buffer = (c_int * size)()
+        if size:
+            zzub.zzub_plugin_get_pattern_values(plugin, pattern, 0, self.rows, 0, self.columns, self.buffer, size)
+
+    def read_rows(self, row, rows=1):
+        """
+        Reads a range of rows again, after they were edited.
+        """
+        if self.plugin is None or row < 0 or row + rows > self.rows:
+            return
+        start = row * self.columns
+        values = (c_int * (rows * self.columns)).from_buffer(self.buffer, start * sizeof(c_int))
+        zzub.zzub_plugin_get_pattern_values(self.plugin, self.pattern, row, rows, 0, self.columns, values, len(values))
+
+    def column_offset(self, group, track):
+        key = (group, track)
+        if key not in self.offsets:
+            self.offsets[key] = self.plugin.pattern_to_linear(group, track, 0)[1]
+        return self.offsets[key]
+
+    def value(self, group, track, column, row):
+        return self.buffer[row * self.columns + self.column_offset(group, track) + column]
+
+    def column(self, group, track, column):
+        """
+        Returns all rows of a single column.
+        """
+        index = self.column_offset(group, track) + column
+        return self.buffer[index::self.columns] if self.columns else []
+
+    def view(self):
+        """
+        Returns a read-only rows x columns memoryview of the buffer.
+        """
+        view = memoryview(self.buffer).cast('B')
+        if not self.rows or not self.columns:
+            return view.toreadonly()
+        return view.cast('i', (self.rows, self.columns)).toreadonly()
+
 # builds content to display each cell in the pattern
 # t2c seems to be shorthand for type_to_characters
 t2c = [
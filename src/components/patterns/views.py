@@ -18,7 +18,7 @@ from neil.utils import (
 from .utils import (
     key_to_note, get_str_from_param, get_length_from_param, 
     get_subindexcount_from_param, get_subindexoffsets_from_param,
-    PatternSelection, DialogMode, SelectionMode
+    PatternSelection, PatternData, DialogMode, SelectionMode
 )
 
 
@@ -510,6 +510,7 @@ class PatternView(Gtk.DrawingArea):
         # self.clickpos = None
         self.track_width = [0, 0, 0]
         self.plugin = None  # pyright: ignore[reportAttributeAccessIssue]
+        self.pattern_data = PatternData()
         self.plugin_info = common.get_plugin_infos()
         self.factors = None
         self.play_notes = True
@@ -621,6 +622,7 @@ class PatternView(Gtk.DrawingArea):
         eventbus.attach(['active_patterns_changed', 'active_plugins_changed'], self.on_active_patterns_changed)
         eventbus.attach('pattern_changed', self.on_pattern_changed)
         eventbus.attach('edit_pattern', self.on_edit_pattern)
+        eventbus.attach('edit_pattern_block', self.on_edit_pattern_block)
         eventbus.attach('pattern_insert_rows', self.on_pattern_insert_rows)
         eventbus.attach('pattern_remove_rows', self.on_pattern_remove_rows)
         eventbus.attach('parameter_changed', self.on_zzub_parameter_changed)
@@ -645,6 +647,7 @@ class PatternView(Gtk.DrawingArea):
             self.on_active_patterns_changed, 
             self.on_active_patterns_changed,
             self.on_edit_pattern,
+            self.on_edit_pattern_block,
             self.on_pattern_insert_rows,
             self.on_pattern_remove_rows,
             self.on_zzub_parameter_changed,
@@ -682,6 +685,15 @@ class PatternView(Gtk.DrawingArea):
         self.update_line(row)
         self.redraw()
 
+    def on_edit_pattern_block(self, plugin, index, row, rows):
+        if plugin != self.plugin:
+            return
+        if index != self.pattern:
+            return
+        for r in range(row, min(row + rows, self.row_count)):
+            self.update_line(r)
+        self.redraw()
+
     def on_pattern_changed(self, plugin, index):
         if plugin != self.plugin:
             return
@@ -1564,6 +1576,7 @@ class PatternView(Gtk.DrawingArea):
             gen = self.unpack_clipboard_data(data.strip())
             mode = next(gen)
             assert isinstance(mode, int) and (mode >= 0) and (mode <= int(SelectionMode.All))
+            cells = []
             for r, g, t, i, v in gen:  # pyright: ignore[reportGeneralTypeIssues]
                 r = self.row + r
                 assert (g >= 0) and (g <= 2)
@@ -1592,7 +1605,10 @@ class PatternView(Gtk.DrawingArea):
                     elif ty == 2:  # byte
                         v = v & 0xFF  # mask out first 8 bytes
                         v = min(max(v, p.get_value_min()), p.get_value_max())  # make sure it is properly clamped
-                self.plugin.set_pattern_value(self.pattern, g, t, i, r, v)  # finally set it
+                cells += [g, t, i, r, v]
+            # set all values at once, so zzub sends a single event for the pasted block
+            if cells:
+                self.plugin.set_pattern_values(self.pattern, cells, len(cells) // 5)
             #Non Buzz-like behaviour (naughty naughty!) ;)  :
             #self.set_row(r+1)
             self.update_statusbar()
@@ -2489,6 +2505,8 @@ class PatternView(Gtk.DrawingArea):
         if self.plugin is None or self.lines is None:
             return
         
+        data = self.pattern_data
+        data.read_rows(row)
         for g in range(3):
             if not self.lines[g]:
                 continue
@@ -2496,7 +2514,7 @@ class PatternView(Gtk.DrawingArea):
             tc = self.group_track_count[g]
             for t in range(tc):
                 s = ' '.join([get_str_from_param(self.plugin.get_parameter(g, t, i),
-                                                    self.plugin.get_pattern_value(self.pattern, g, t, i, row))
+                                                    data.value(g, t, i, row))
                                                 for i in range(self.parameter_count[g])])
                 # values = [self.plugin.get_pattern_value(self.pattern, g, t, i, row) != self.plugin.get_parameter(g, t, i).get_value_none()
                 #                                         for i in range(self.parameter_count[g])]
@@ -2513,10 +2531,9 @@ class PatternView(Gtk.DrawingArea):
         col_vals = [None] * count
         for i in range(count):
             param = self.plugin.get_parameter(group, 0, i)
-            cols[i] = [get_str_from_param(param, self.plugin.get_pattern_value(self.pattern, group, track, i, row))
-                    for row in range(self.row_count)]
-            col_vals[i] = [self.plugin.get_pattern_value(self.pattern, group, track, i, row) != param.get_value_none()
-                    for row in range(self.row_count)]
+            values = self.pattern_data.column(group, track, i)
+            cols[i] = [get_str_from_param(param, v) for v in values]
+            col_vals[i] = [v != param.get_value_none() for v in values]
         for row in range(self.row_count):
             try:
                 self.lines[group][track][row] = ' '.join([cols[i][row] for i in range(count)])
@@ -2528,6 +2545,7 @@ class PatternView(Gtk.DrawingArea):
         Initializes a buffer to handle the current pattern data.
         """
         self.lines = [None] * 3
+        self.pattern_data.read(self.plugin, self.pattern)
         for group in range(3):
             if self.parameter_count[group] > 0:
                 tc = self.group_track_count[group]
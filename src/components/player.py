@@ -167,6 +167,7 @@ class NeilPlayer(Player, metaclass=PropertyEventHandler, methods=DOCUMENT_UI):
         zzub_event_type_delete_pattern = dict(args='delete_pattern'),
         zzub_event_type_pre_delete_pattern = dict(args='delete_pattern'),
         zzub_event_type_edit_pattern = dict(args='edit_pattern'),
+        zzub_event_type_edit_pattern_block = dict(args='edit_pattern_block'),
         zzub_event_type_pattern_changed = dict(args='pattern_changed'),
         zzub_event_type_pattern_insert_rows = dict(args='pattern_insert_rows'),
         zzub_event_type_pattern_remove_rows = dict(args='pattern_remove_rows'),
@@ -187,6 +188,7 @@ class NeilPlayer(Player, metaclass=PropertyEventHandler, methods=DOCUMENT_UI):
         zzub_event_type_wave_allocated = dict(args='allocate_wavelevel'),
         zzub_event_type_player_state_changed = dict(args='player_state_changed'),
         zzub_event_type_osc_message = dict(args='osc_message'),
+        zzub_event_type_save_complete = dict(args='save_complete'),
         zzub_event_type_vu = dict(args='vu'),
         zzub_event_type_custom = dict(args='custom'),
         zzub_event_type_all = dict(args='all'),
@@ -494,6 +496,12 @@ class NeilPlayer(Player, metaclass=PropertyEventHandler, methods=DOCUMENT_UI):
         return res
 
 
+    def save_ccm_async(self, fileName):
+        self.flush(None, None)
+        self.history_flush_last()
+        return zzub.Player.save_ccm_async(self, fileName)
+
+
     def clear(self):
         self.delete_stream_player()
         self.delete_stream_recorder()
@@ -1,6 +1,17 @@
 
 #__seq_keys =
 
+def get_events(track, start=0, end=0x7fffffff):
+    """
+    Returns the (position, value) events of a sequence track with start <= position < end,
+    fetched with a single call instead of one call per event.
+    """
+    count = track.get_event_count()
+    if not count:
+        return []
+    count, positions, values = track.get_events(start, end, count)
+    return list(zip(positions[:count], values[:count]))
+
 class Seq:
     keys =  '0123456789abcdefghijklmnopqrstuvwxyz'
     map = {
@@ -21,7 +21,7 @@ from neil import components
 import zzub
 
 from .add_track import AddSequencerTrackDialog
-from .utils import Seq
+from .utils import Seq, get_events
 
 
 def get_random_color(seed):
@@ -260,7 +260,7 @@ class SequencerView(Gtk.DrawingArea):
                                 max(self.selection_start[1], self.selection_end[1]))
         for track in range(start[0], end[0] + 1):
             t = player.get_sequence(track)
-            events = dict(t.get_event_list())
+            events = dict(get_events(t, start[1], end[1] + 1))
             for row in range(start[1], end[1] + 1):
                 if row in events:
                     yield track, row, events[row]
@@ -359,14 +359,13 @@ class SequencerView(Gtk.DrawingArea):
             patternsize = 0
             eventlist = []
             m = t.get_plugin()
-            for time, value in t.get_event_list():
-                if (time >= start[1]) and (time < (end[1] + self.step)):
-                    if value >= 0x10:
-                        value -= 0x10
-                        # copy contents between patterns
-                        eventlist.append((time, m.get_pattern(value)))
-                        patternsize = max(patternsize, time - start[1] +
-                                          m.get_pattern(value).get_row_count())
+            for time, value in get_events(t, start[1], end[1] + self.step):
+                if value >= 0x10:
+                    value -= 0x10
+                    # copy contents between patterns
+                    eventlist.append((time, m.get_pattern(value)))
+                    patternsize = max(patternsize, time - start[1] +
+                                      m.get_pattern(value).get_row_count())
             if patternsize:
                 name = get_new_pattern_name(m)
                 p = m.create_pattern(patternsize)
@@ -1044,7 +1043,7 @@ class SequencerView(Gtk.DrawingArea):
             track = tracklist[track_index]
             m = track.get_plugin()
             track_length = 0
-            for pos, value in track.get_event_list():
+            for pos, value in get_events(track):
                 if value >= 0x10:
                     pat = m.get_pattern(value - 0x10)
                     length = pat.get_row_count()
@@ -1207,7 +1206,7 @@ class SequencerView(Gtk.DrawingArea):
             plugin = track.get_plugin()
             plugin_info = self.plugin_info.get(plugin)
             # Draw the pattern boxes
-            event_list = list(track.get_event_list())
+            event_list = get_events(track)
 
             for (position, value), index in zip(event_list, range(len(event_list))):
                 pattern = None
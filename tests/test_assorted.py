@@ -1,6 +1,86 @@
 import os, sys
 import time
+import ctypes
+import tempfile
 from unittest import TestCase, main
+import zzub
+from test_rtcheck import SONGS, plugin_paths
+
+class TestSongMarkers(TestCase):
+    samplerate = 44100
+
+    def create_player(self):
+        player = zzub.zzub_player_create()
+        self.assertEqual(zzub.zzub_player_initialize(player, self.samplerate), 0)
+        return player
+
+    def testSaveLoadMarkers(self):
+        """Check that the song and loop markers survive saving and loading a ccm.
+        """
+        player = self.create_player()
+        zzub.zzub_player_set_song_start(player, 16)
+        zzub.zzub_player_set_song_end(player, 96)
+        zzub.zzub_player_set_loop_start(player, 32)
+        zzub.zzub_player_set_loop_end(player, 64)
+        fd, path = tempfile.mkstemp(suffix='.ccm')
+        os.close(fd)
+        try:
+            self.assertEqual(zzub.zzub_player_save_ccm(player, path.encode('utf8')), 0)
+            zzub.zzub_player_destroy(player)
+
+            player = self.create_player()
+            self.assertEqual(zzub.zzub_player_load_ccm(player, path.encode('utf8')), 0)
+            self.assertEqual(zzub.zzub_player_get_song_start(player), 16)
+            self.assertEqual(zzub.zzub_player_get_song_end(player), 96)
+            self.assertEqual(zzub.zzub_player_get_loop_start(player), 32)
+            self.assertEqual(zzub.zzub_player_get_loop_end(player), 64)
+        finally:
+            os.remove(path)
+            zzub.zzub_player_destroy(player)
+
+class TestTrackCountDuringPlayback(TestCase):
+    samplerate = 44100
+    buffersize = 256
+
+    def setUp(self):
+        self.player = zzub.zzub_player_create()
+        for path in plugin_paths():
+            zzub.zzub_player_add_plugin_path(self.player, (path + os.sep).encode('utf8'))
+        self.assertEqual(zzub.zzub_player_initialize(self.player, self.samplerate), 0)
+
+    def tearDown(self):
+        zzub.zzub_player_destroy(self.player)
+
+    def play(self, seconds):
+        samples = ctypes.c_int()
+        for i in range(seconds * self.samplerate // self.buffersize):
+            samples.value = self.buffersize
+            zzub.zzub_player_work_stereo(self.player, ctypes.byref(samples))
+
+    def testChangeTrackCount(self):
+        """Check that changing the track count while the song plays keeps playing the
+        patterns that were laid out for the old track count.
+        """
+        self.assertEqual(zzub.zzub_player_load_ccm(self.player, SONGS[0].encode('utf8')), 0)
+        zzub.zzub_player_set_loop_enabled(self.player, 1)
+        zzub.zzub_player_set_state(self.player, zzub.zzub_player_state_playing)
+        self.play(1)
+        changed = 0
+        for i in range(zzub.zzub_player_get_plugin_count(self.player)):
+            plugin = zzub.zzub_player_get_plugin(self.player, i)
+            loader = zzub.zzub_plugin_get_pluginloader(plugin)
+            tracks = zzub.zzub_plugin_get_track_count(plugin)
+            for count in (zzub.zzub_pluginloader_get_tracks_max(loader), zzub.zzub_pluginloader_get_tracks_min(loader), tracks):
+                if count == zzub.zzub_plugin_get_track_count(plugin):
+                    continue
+                zzub.zzub_plugin_set_track_count(plugin, count)
+                zzub.zzub_player_history_commit(self.player, b'track count')
+                self.assertEqual(zzub.zzub_plugin_get_track_count(plugin), count)
+                self.play(1)
+                changed += 1
+        if not changed:
+            self.skipTest('no plugin in %s has a variable track count' % SONGS[0])
+        self.assertEqual(zzub.zzub_player_get_state(self.player), zzub.zzub_player_state_playing)
 
 if __name__ == '__main__':
     main()
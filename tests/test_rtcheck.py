@@ -0,0 +1,96 @@
+import os, sys
+import ctypes
+import unittest
+import zzub
+
+######################################
+# Plays songs with libzzub built with scons RTCHECK=1 and checks that the audio
+# thread does not allocate, lock or block. Violations are printed on stderr with
+# a backtrace and the plugin that was running. The checker only sees anything
+# when it is preloaded:
+#
+#   LD_PRELOAD=libzzub_rtcheck.so python3 -m unittest tests/test_rtcheck.py
+######################################
+
+TEST_DIR = os.path.dirname(os.path.abspath(__file__))
+SONGS = [
+    os.path.join(TEST_DIR, '..', 'libneil', 'test', 'chiptune.ccm'),
+]
+
+def plugin_paths():
+    paths = os.environ.get('NEIL_PLUGIN_PATH', None)
+    if paths:
+        return paths.split(os.pathsep)
+    paths = os.environ.get('ZZUB_LIBRARY_PATH', '')
+    paths = [path for path in paths.split(os.pathsep) if path]
+    paths.extend(['/usr/local/lib64', '/usr/local/lib', '/usr/lib64', '/usr/lib'])
+    return [os.path.join(path, 'zzub') for path in paths if os.path.exists(os.path.join(path, 'zzub'))]
+
+class TestRealTimeSafety(unittest.TestCase):
+    samplerate = 44100
+    buffersize = 256
+    seconds = 20
+
+    def setUp(self):
+        self.player = zzub.zzub_player_create()
+        violations = zzub.zzub_player_get_rt_violations(self.player)
+        if violations == -1:
+            zzub.zzub_player_destroy(self.player)
+            self.skipTest('libzzub was built without RTCHECK')
+        if violations == -2:
+            zzub.zzub_player_destroy(self.player)
+            self.fail('libzzub_rtcheck.so is not preloaded, run the test with LD_PRELOAD=libzzub_rtcheck.so')
+        for path in plugin_paths():
+            zzub.zzub_player_add_plugin_path(self.player, (path + os.sep).encode('utf8'))
+        self.assertEqual(zzub.zzub_player_initialize(self.player, self.samplerate), 0)
+        rates = (ctypes.c_int * 1)(self.samplerate)
+        self.driver = zzub.zzub_audiodriver_create_silent(self.player, b'rtcheck', 2, 0, rates, 1)
+        zzub.zzub_audiodriver_set_samplerate(self.driver, self.samplerate)
+        zzub.zzub_audiodriver_set_buffersize(self.driver, self.buffersize)
+        zzub.zzub_audiodriver_create_device(self.driver, -1, 0)
+        zzub.zzub_audiodriver_enable(self.driver, 1)
+
+    def tearDown(self):
+        zzub.zzub_audiodriver_enable(self.driver, 0)
+        zzub.zzub_audiodriver_destroy(self.driver)
+        zzub.zzub_player_destroy(self.player)
+
+    def play(self, seconds):
+        samples = ctypes.c_int()
+        for i in range(seconds * self.samplerate // self.buffersize):
+            samples.value = self.buffersize
+            zzub.zzub_player_work_stereo(self.player, ctypes.byref(samples))
+
+    def testSongs(self):
+        """Check that playing the test songs causes no violations on the audio thread.
+        """
+        for song in SONGS:
+            self.assertEqual(zzub.zzub_player_load_ccm(self.player, song.encode('utf8')), 0)
+            zzub.zzub_player_set_loop_enabled(self.player, 1)
+            zzub.zzub_player_set_state(self.player, zzub.zzub_player_state_playing)
+            # the first buffers initialize the plugins, they may allocate
+            self.play(1)
+            before = zzub.zzub_player_get_rt_violations(self.player)
+            self.play(self.seconds)
+            violations = zzub.zzub_player_get_rt_violations(self.player) - before
+            self.assertEqual(violations, 0, '%d violations playing %s' % (violations, song))
+            zzub.zzub_player_set_state(self.player, zzub.zzub_player_state_stopped)
+
+    def testAllocatorIsReported(self):
+        """Check that the checker fires: the built-in allocator plugin allocates in every
+        process_stereo().
+        """
+        loader = zzub.zzub_player_get_pluginloader_by_name(self.player, b'@zzub.org/rtcheck/allocator')
+        self.assertTrue(loader)
+        zzub.zzub_player_begin_song_build(self.player)
+        plugin = zzub.zzub_player_create_plugin(self.player, None, 0, b'allocator', loader, 0)
+        master = zzub.zzub_player_get_plugin_by_id(self.player, 0)
+        zzub.zzub_plugin_add_input(master, plugin, zzub.zzub_connection_type_audio)
+        zzub.zzub_player_end_song_build(self.player)
+        before = zzub.zzub_player_get_rt_violations(self.player)
+        self.play(1)
+        violations = zzub.zzub_player_get_rt_violations(self.player) - before
+        self.assertGreater(violations, 0)
+
+if __name__ == '__main__':
+    unittest.main()